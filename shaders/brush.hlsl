@@ -13,5 +13,6 @@ Output ps_main(Varyings v)
     o.color.rgb = Lighting(v.normal, v.view) * baseColor.rgb * Brush.color.rgb;
     o.color.a   = baseColor.a * Brush.color.a;
     o.id        = v.id;
+    o.selection = v.selected;
     return o;
 }
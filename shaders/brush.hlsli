@@ -1,14 +1,30 @@
 #include "common.hlsli"
 USE_CBUFFER(BrushState, Brush, 1);
 
+// Brush buffer, for BrushFace lookups. Kept clear of the material texture slots.
+ByteAddressBuffer s_faces : register(t8);
+
 struct Input
 {
     float3 position : POSITION;
-    float3 normal   : NORMAL0;
-    float3 uv       : TEXCOORD0;
+    float2 uv       : TEXCOORD0;
     uint   face     : BLENDINDICES0;
+    float  alpha    : COLOR0;
 };
 
+// Set in a face's id while it is selected, see BrushFaceSelected
+static const uint FaceSelected = 0x80000000;
+
+BrushFace LoadFace(uint index)
+{
+    uint4 raw = s_faces.Load4(Brush.faceOffset + index * 16);
+
+    BrushFace face;
+    face.normal = asfloat(raw.xyz);
+    face.id     = raw.w;
+    return face;
+}
+
 struct Varyings
 {
     float4 position : SV_POSITION;
@@ -16,23 +32,28 @@ struct Varyings
     float3 uv       : TEXCOORD0;
     float3 view     : TEXCOORD1;
     uint   id       : BLENDINDICES0;
+    uint   selected : BLENDINDICES1;
 };
 
 Varyings vs_main(Input i)
 {
     Varyings v = (Varyings)0;
 
+    BrushFace face = LoadFace(i.face);
+
     v.position = mul(Camera.viewProj, float4(i.position, 1.0));
-    v.normal   = i.normal;
+    v.normal   = face.normal;
     v.view     = mul(Camera.view, float4(i.position, 1.0)).xyz;
-    v.uv       = i.uv;
-    v.id       = Brush.id == 0 ? i.face : Brush.id;
+    v.uv       = float3(i.uv, i.alpha);
+    v.id       = Brush.id == 0 ? face.id & ~FaceSelected : Brush.id;
+    v.selected = Brush.selected | ((face.id & FaceSelected) ? 1 : 0);
 
     return v;
 }
 
 struct Output
 {
-    float4 color : SV_TARGET0;
-    uint   id    : SV_TARGET1;
+    float4 color     : SV_TARGET0;
+    uint   id        : SV_TARGET1;
+    float  selection : SV_TARGET2; // Mask for the selection outline pass
 };
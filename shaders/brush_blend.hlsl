@@ -25,5 +25,6 @@ Output ps_main(Varyings v)
     o.color.rgb = Lighting(v.normal, v.view) * baseColor.rgb * Brush.color.rgb;
     o.color.a   = alpha;
     o.id        = v.id;
+    o.selection = v.selected;
     return o;
 }
@@ -22,5 +22,22 @@ struct BrushState
 {
     float4 color;
     uint id;
+    uint faceOffset; // Byte offset of this mesh's BrushFace array
+    uint selected;   // Written to the selection mask
+    float padding;
+};
+
+struct SelectionState
+{
+    float4 tint;    // Multiplied over selected pixels
+    float4 outline; // Blended over the edges of the selection
+    float  width;   // Outline width in pixels
     float3 padding;
 };
+
+// Per-face brush attributes, shared by every vertex of a face
+struct BrushFace
+{
+    float3 normal;
+    uint id;
+};
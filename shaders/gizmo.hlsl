@@ -0,0 +1,35 @@
+#include "common.hlsli"
+
+struct Input
+{
+    float3 position : POSITION;
+    float4 color    : COLOR0;
+};
+
+struct Varyings
+{
+    float4 position : SV_POSITION;
+    float4 color    : COLOR0;
+};
+
+struct Output
+{
+    float4 color : SV_TARGET0;
+    uint   id    : SV_TARGET1;
+};
+
+Varyings vs_main(Input i)
+{
+    Varyings v;
+    v.position = mul(Camera.viewProj, float4(i.position, 1.0));
+    v.color    = i.color;
+    return v;
+}
+
+Output ps_main(Varyings v)
+{
+    Output o = (Output)0;
+    o.color = v.color;
+    o.id = 0;
+    return o;
+}
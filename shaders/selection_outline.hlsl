@@ -0,0 +1,67 @@
+#include "common.hlsli"
+
+USE_CBUFFER(SelectionState, Selection, 1);
+
+// Mask written by the brush passes, 1 where a selected brush or face is visible
+Texture2D<float> s_selection : register(t0);
+
+struct Varyings
+{
+    float4 position : SV_POSITION;
+};
+
+// One triangle covering the whole view, no vertex buffer
+Varyings vs_main(uint id : SV_VERTEXID)
+{
+    float2 uv = float2((id << 1) & 2, id & 2);
+
+    Varyings v;
+    v.position = float4(uv * float2(2, -2) + float2(-1, 1), 0, 1);
+    return v;
+}
+
+// Dual source blended: result = add + dst * multiply
+struct Output
+{
+    float4 add      : SV_TARGET0;
+    float4 multiply : SV_TARGET1;
+};
+
+float LoadMask(int2 pixel, int2 size)
+{
+    return s_selection.Load(int3(clamp(pixel, int2(0, 0), size - 1), 0));
+}
+
+Output ps_main(Varyings v)
+{
+    int2 size;
+    s_selection.GetDimensions(size.x, size.y);
+
+    int2  pixel  = int2(v.position.xy);
+    float center = LoadMask(pixel, size);
+
+    // Any neighbour on the other side of the selection boundary makes this an edge
+    int   width = int(Selection.width);
+    float edge  = 0;
+    [unroll] for (int y = -1; y <= 1; y++)
+    {
+        [unroll] for (int x = -1; x <= 1; x++)
+            edge = max(edge, abs(LoadMask(pixel + int2(x, y) * width, size) - center));
+    }
+
+    if (edge < 0.5 && center < 0.5)
+        discard;
+
+    Output o;
+    if (edge >= 0.5)
+    {
+        o.add      = float4(Selection.outline.rgb * Selection.outline.a, 0);
+        o.multiply = (1 - Selection.outline.a).xxxx;
+    }
+    else
+    {
+        o.add      = float4(0, 0, 0, 0);
+        o.multiply = float4(Selection.tint.rgb, 1);
+    }
+    return o;
+}
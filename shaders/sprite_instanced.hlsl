@@ -1,17 +1,22 @@
 #include "common.hlsli"
 
-USE_CBUFFER(ObjectState, Object, 1);
-
 struct Input
 {
     float3 position : POSITION;
     float2 uv       : TEXCOORD0;
+
+    // Per-instance
+    float4 origin   : TEXCOORD1; // xyz = origin, w = size
+    float4 color    : COLOR0;
+    uint   id       : BLENDINDICES0;
 };
 
 struct Varyings
 {
     float4 position : SV_POSITION;
     float2 uv       : TEXCOORD0;
+    float4 color    : COLOR0;
+    nointerpolation uint id : BLENDINDICES0;
 };
 
 struct Output
@@ -25,17 +30,18 @@ SamplerState s_sampler : register(s0);
 
 Varyings vs_main(Input i)
 {
-    float4x4 modelViewProj = mul(Camera.viewProj, Object.model);
     float3x3 invViewAxes = transpose((float3x3)Camera.view);
 
     Varyings v = (Varyings)0;
 
     float3 camRight = float3(invViewAxes[0][0], invViewAxes[1][0], invViewAxes[2][0]);
     float3 camUp    = float3(invViewAxes[0][1], invViewAxes[1][1], invViewAxes[2][1]);
-	float3 pos      = (camRight * i.position.x) + (camUp * i.position.y);
+    float3 pos      = i.origin.xyz + ((camRight * i.position.x) + (camUp * i.position.y)) * i.origin.w;
 
-    v.position = mul(modelViewProj, float4(pos, 1));
+    v.position = mul(Camera.viewProj, float4(pos, 1));
     v.uv       = i.uv;
+    v.color    = i.color;
+    v.id       = i.id;
 
     return v;
 }
@@ -50,8 +56,8 @@ Output ps_main(Varyings v)
     if (color.a < 0.05)
         discard;
 
-    o.color = color * Object.color;
-    o.id = Object.id;
-    
+    o.color = color * v.color;
+    o.id = v.id;
+
     return o;
 }
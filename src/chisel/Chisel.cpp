@@ -7,6 +7,9 @@
 
 #include "console/Console.h"
 #include "gui/ConsoleWindow.h"
+#if CHISEL_PROFILE
+#include "gui/ProfilerWindow.h"
+#endif
 #include "gui/AssetPicker.h"
 #include "gui/Layout.h"
 #include "gui/Inspector.h"
@@ -18,6 +21,7 @@
 #include "common/Parse.h"
 #include "formats/Formats.h"
 #include "tools/Tool.h"
+#include "input/Mouse.h"
 
 #include <cstring>
 #include <vector>
@@ -32,11 +36,21 @@ namespace chisel
         
         tool = Tool::Default;
 
+        // Drags end wherever the button is let go, even with no viewport drawing the tool
+        Engine.OnEndFrame += [this](render::RenderContext&)
+        {
+            if (!Mouse.GetButton(MouseButton::Left))
+                EndDrag();
+        };
+
         // Add chisel systems...
         Renderer = &Engine.systems.AddSystem<MapRender>();
         Engine.systems.AddSystem<Keybinds>();
         Engine.systems.AddSystem<Layout>();
         console = &Engine.systems.AddSystem<GUI::ConsoleWindow>();
+#if CHISEL_PROFILE
+        profiler = &Engine.systems.AddSystem<GUI::ProfilerWindow>();
+#endif
         Engine.systems.AddSystem<MainToolbar>();
         Engine.systems.AddSystem<SelectionModeToolbar>();
         Engine.systems.AddSystem<EditingToolbar>();
@@ -53,6 +67,31 @@ namespace chisel
         delete fgd;
     }
 
+    void Chisel::SetTool(Tool* newTool)
+    {
+        if (newTool != tool)
+            EndDrag();
+        tool = newTool;
+    }
+
+    void Chisel::Drag(const char* name)
+    {
+        if (m_dragging)
+            return;
+
+        map.Actions().Begin(name);
+        m_dragging = true;
+    }
+
+    void Chisel::EndDrag()
+    {
+        if (!m_dragging)
+            return;
+
+        map.Actions().Commit();
+        m_dragging = false;
+    }
+
     void Chisel::Save(std::string_view path)
     {
         if (path.ends_with("vmf"))
@@ -67,6 +106,7 @@ namespace chisel
 
     void Chisel::CloseMap()
     {
+        EndDrag();
         Selection.Clear();
         map.Clear();
     }
@@ -95,7 +135,7 @@ namespace chisel
             if (cls.type == FGD::SolidClass || cls.type == FGD::BaseClass)
                 continue;
 
-            PointEntity* ent = map.AddPointEntity(name.c_str());
+            PointEntity* ent = map.AddPointEntity(cls.key);
             ent->origin = origin * 128.f;
             if (++origin.x > 8)
             {
@@ -122,9 +162,3 @@ namespace chisel::commands
             Console.Error("Failed to load map '{}'", cmd.argv[0]);
     });
 }
-
-int main(int argc, char* argv[])
-{
-    using namespace chisel;
-    Chisel.Run();
-}
@@ -29,6 +29,13 @@ namespace chisel
 
         std::unique_ptr<BrushGPUAllocator> brushAllocator;
 
+        // Switch tools, committing any drag the old one left open
+        void SetTool(Tool* tool);
+
+        // Call every frame edits come from a mouse drag. All of them are one undo step,
+        // committed at the end of the first frame the left button is up, or when the tool changes.
+        void Drag(const char* name);
+
         /*
         uint GetSelectionID(VMF::MapEntity& ent, VMF::Solid& solid)
         {
@@ -56,6 +63,7 @@ namespace chisel
 
     // GUI //
         GUI::Window* console;
+        GUI::Window* profiler = nullptr;
         GUI::Window* mainAssetPicker;
 
     // Chisel Engine Loop //
@@ -63,5 +71,10 @@ namespace chisel
         void Run();
 
         ~Chisel();
+
+    private:
+        void EndDrag();
+
+        bool m_dragging = false;
     } Chisel;
 }
@@ -1,12 +1,14 @@
 
 #include "Engine.h"
 #include "common/Time.h"
+#include "common/Profiler.h"
 #include "chisel/Gizmos.h"
 #include "chisel/Handles.h"
 #include "chisel/Selection.h"
 #include "gui/Common.h"
 #include "assets/Assets.h"
 #include "core/Primitives.h"
+#include "console/ConVar.h"
 
 #include <bit>
 
@@ -16,6 +18,8 @@ namespace chisel
     static render::RenderContext& rctx = Engine.rctx;
     static render::RenderContext& r = Engine.rctx;
 
+    static ConVar<int> engine_idle_wait("engine_idle_wait", 250, "Max time in ms to sleep waiting for input when nothing is changing. 0 never sleeps.");
+
     void Engine::Init()
     {
         // Create window
@@ -29,22 +33,40 @@ namespace chisel
         Gizmos.Init();
         Handles.Init();
 
-        // Load editor shaders
-        cs_ObjectID = render::ComputeShader(r.device.ptr(), "objectid");
-        cs_ObjectID.buffers.push_back(r.CreateCSInputBuffer<uint2>());
-        cs_ObjectID.buffers.push_back(r.CreateCSOutputBuffer<uint>());
-        cs_ObjectID.buffers[1].AddStagingBuffer(r.device.ptr());
+        // Setup object picking
+        picking.Init(r);
+
+        // Setup GPU timing
+        PROFILE_INIT();
     }
 
     void Engine::Loop()
     {
         systems.Start();
+        Wake();
 
         Time::Seconds lastTime    = Time::GetTime();
         Time::Seconds accumulator = 0;
 
         while (!window->ShouldClose())
         {
+            // Nothing is changing, sleep until there is input.
+            // Time out now and then so background work and ImGui timers still advance.
+            if (m_wakeFrames > 0)
+            {
+                m_wakeFrames--;
+            }
+            else if (engine_idle_wait > 0)
+            {
+                if (window->WaitEvents(uint(int(engine_idle_wait))))
+                    Wake(); // Give ImGui a few frames to settle after input
+
+                // Don't count the time spent asleep as frame time
+                lastTime = Time::GetTime();
+            }
+
+            PROFILE_BEGIN_FRAME();
+
             auto currentTime = Time::GetTime();
             auto deltaTime   = currentTime - lastTime;
             lastTime = currentTime;
@@ -59,6 +81,7 @@ namespace chisel
             while (accumulator >= Time.fixed.deltaTime)
             {
                 // Perform fixed updates
+                PROFILE_ZONE("Tick");
                 systems.Tick();
 
                 accumulator     -= Time.fixed.deltaTime;
@@ -69,29 +92,54 @@ namespace chisel
             // Amount to lerp between physics steps
             [[maybe_unused]] double alpha = accumulator / Time.fixed.deltaTime;
 
-            // Clear buffered input
-            Input.Update();
+            {
+                PROFILE_ZONE("Input");
+
+                // Clear buffered input
+                Input.Update();
 
-            // Process input
-            window->PreUpdate();
+                // Process input
+                window->PreUpdate();
+            }
 
             // Setup to render
             rctx.BeginFrame();
 
             // Perform system updates
-            systems.Update();
+            {
+                PROFILE_ZONE("Update");
+                systems.Update();
+            }
+
+            // Draw what the systems queued up
+            {
+                PROFILE_ZONE("OnRender");
+                OnRender(rctx);
+            }
 
             // Finish rendering
-            rctx.EndFrame();
-            OnEndFrame(rctx);
-            
-            // Present to non-main windows
-            GUI::Present();
+            {
+                PROFILE_ZONE("RenderContext::EndFrame");
+                PROFILE_GPU_ZONE("ImGui");
+                rctx.EndFrame();
+            }
+            {
+                PROFILE_ZONE("OnEndFrame");
+                OnEndFrame(rctx);
+            }
+
+            {
+                PROFILE_ZONE("Present");
 
-            // Present to main window
-            window->Update();
+                // Present to non-main windows
+                GUI::Present();
+
+                // Present to main window
+                window->Update();
+            }
 
             Time.frameCount++;
+            PROFILE_END_FRAME();
         }
     }
 
@@ -102,35 +150,4 @@ namespace chisel
         delete window;
         Window::Shutdown();
     }
-
-    void Engine::PickObject(uint2 mouse, const Rc<render::RenderTarget>& rt_ObjectID, void callback(void*))
-    {
-        auto bufferIn = cs_ObjectID.buffers[0];
-
-        // Update input buffer
-        r.UpdateDynamicBuffer(bufferIn.buffer.ptr(), mouse);
-
-        // When rendering completes...
-        OnEndFrame.Once([rt_ObjectID, callback](render::RenderContext& r)
-        {
-            // Unbind render targets
-            r.ctx->OMSetRenderTargets(0, nullptr, nullptr);
-
-            extern class Engine Engine;
-            auto bufferIn = Engine.cs_ObjectID.buffers[0];
-            auto bufferOut = Engine.cs_ObjectID.buffers[1];
-
-            // Bind the render target, input coords, output value
-            ID3D11ShaderResourceView* srvs[] = { rt_ObjectID->srvLinear.ptr(), bufferIn.srv.ptr() };
-            r.ctx->CSSetShaderResources(0, 2, srvs);
-            r.ctx->CSSetUnorderedAccessViews(0, 1, &bufferOut.uav, nullptr);
-
-            // Run the compute shader
-            r.ctx->CSSetShader(Engine.cs_ObjectID.cs.ptr(), nullptr, 0);
-            r.ctx->Dispatch(1, 1, 1);
-
-            // Download the output value
-            bufferOut.Download(callback);
-        });
-    }
 }
@@ -10,7 +10,9 @@
 #include "core/Transform.h"
 #include "render/Render.h"
 #include "core/Mesh.h"
+#include "chisel/Picking.h"
 
+#include <algorithm>
 #include <charconv>
 #include <type_traits>
 
@@ -24,14 +26,13 @@ namespace chisel
         SystemGroup systems;
         render::RenderContext rctx;
 
+        Event<render::RenderContext&> OnRender;   // After every system has updated, before ImGui
         Event<render::RenderContext&> OnEndFrame;
 
     public:
     // Viewport //
-        render::ComputeShader cs_ObjectID;
-
-        // Read object ID from given selection buffer render target and update selection
-        void PickObject(uint2 mouse, const Rc<render::RenderTarget>& rt_ObjectID, void callback(void*));
+        // Asynchronous object ID readback from viewport ID targets
+        Picking picking;
 
     // Main Engine Loop //
 
@@ -39,7 +40,12 @@ namespace chisel
         void Loop();
         void Shutdown();
 
+        // Keep the loop running for a few more frames instead of waiting for input.
+        // Call this while something on screen is changing.
+        void Wake(uint frames = 3) { m_wakeFrames = std::max(m_wakeFrames, frames); }
+
     private:
+        uint m_wakeFrames = 0;
 
     } Engine;
 }
\ No newline at end of file
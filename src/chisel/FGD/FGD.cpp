@@ -5,6 +5,7 @@
 
 #include "console/Console.h"
 #include "common/Filesystem.h"
+#include "common/Profiler.h"
 #include "common/String.h"
 #include "assets/Assets.h"
 #include "render/Render.h"
@@ -210,6 +211,7 @@ namespace chisel
             auto name = Expect(Tokens.Name);
             cls.name = name;
             cls.hash = name.text.hash;
+            cls.key = cls.name;
             cls.description = ParseDescription();
 
             printdbg("@{} = {} : {}", type, cls.name, cls.description);
@@ -247,6 +249,7 @@ namespace chisel
             FGD::Var var;
             var.name = name;
             var.hash = name.text.hash;
+            var.key = var.name;
             Expect('(');
             auto typeName = str::toLower(Expect(Tokens.Name).text);
             var.type = FGD::VarType(HashedString(typeName).hash);
@@ -306,6 +309,7 @@ namespace chisel
             FGD::InputOutput& io = (input ? cls.inputs : cls.outputs).try_emplace(name).first->second;
             io.name = name;
             io.hash = name.text.hash;
+            io.key = io.name;
             Expect('(');
             io.type = Expect(Tokens.Name);
             Expect(')');
@@ -364,9 +368,24 @@ namespace chisel
 
     FGD::FGD(const char* path) : path(path)
     {
+        PROFILE_ZONE("FGD::Parse");
+
+        static uint32 loads = 0;
+        generation = ++loads;
+
         auto str = ReadFGDFile(path);
         Lexer lexer(str, false);
         FGDParser parser(*this, lexer.tokens);
         parser.Parse();
+
+        classLookup.reserve(classes.size());
+        for (auto& [name, cls] : classes)
+            classLookup.emplace(cls.key, &cls);
+    }
+
+    const FGD::Class* FGD::Find(InternedString name) const
+    {
+        auto it = classLookup.find(name);
+        return it != classLookup.end() ? it->second : nullptr;
     }
 }
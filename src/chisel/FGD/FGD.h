@@ -5,6 +5,7 @@
 #include <map>
 #include <string>
 #include "common/Hash.h"
+#include "common/Intern.h"
 #include "math/Math.h"
 #include "render/Render.h"
 
@@ -114,6 +115,7 @@ namespace chisel
         {
             std::string name;
             Hash hash;
+            InternedString key; // name, to match entity classnames and KV keys by pointer
             std::string description;
         };
 
@@ -182,6 +184,13 @@ namespace chisel
         std::string path;
 
         std::map<std::string, Class> classes; // Alphabetical order
+        std::unordered_map<InternedString, Class*> classLookup;
+
+        // Unique per loaded FGD. Entities cache their resolved class until this changes.
+        uint32 generation = 0;
+
+        // Null for unknown classes. Never inserts.
+        const Class* Find(InternedString name) const;
         List<std::string> materialExclusion;
 
         int minSize = -16384;
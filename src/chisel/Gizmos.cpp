@@ -1,13 +1,13 @@
 #include "Gizmos.h"
-#include "glm/ext/matrix_transform.hpp"
 #include "chisel/Engine.h"
-#include "render/CBuffers.h"
-#include "core/Primitives.h"
-#include <vector>
-#include <glm/gtx/vector_angle.hpp>
+#include "console/Console.h"
+#include "common/Hash.h"
+#include "common/Profiler.h"
 #include "math/Winding.h"
 #include "map/Common.h"
-#include "chisel/MapRender.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace chisel
 {
@@ -17,31 +17,75 @@ namespace chisel
     {
         icnObsolete = Assets.Load<Texture>("textures/ui/obsolete.png");
         icnHandle   = Assets.Load<Texture>("textures/ui/handle.png");
-        sh_Color    = render::Shader(Engine.rctx.device.ptr(), Primitives::Vertex::Layout, "color");
-        sh_Sprite   = render::Shader(Engine.rctx.device.ptr(), Primitives::Vertex::Layout, "sprite");
+        sh_Gizmo    = render::Shader(r.device.ptr(), Vertex::Layout, "gizmo");
+    }
+
+    void Gizmos::List::Init(render::RenderContext& r)
+    {
+        for (auto& row : icons)
+        {
+            for (SpriteBatch& batch : row)
+                batch.Init(r);
+        }
+
+        D3D11_BUFFER_DESC desc
+        {
+            .ByteWidth      = RingSize * sizeof(Vertex),
+            .Usage          = D3D11_USAGE_DYNAMIC,
+            .BindFlags      = D3D11_BIND_VERTEX_BUFFER,
+            .CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
+        };
+        if (FAILED(r.device->CreateBuffer(&desc, nullptr, &ring)))
+            Console.Error("[D3D11] Failed to create gizmo vertex buffer");
+    }
+
+    void Gizmos::List::Clear()
+    {
+        // Batches are kept so their storage is reused next frame
+        for (Batch& batch : batches)
+            batch.vertices.clear();
+        used = 0;
+
+        for (auto& row : icons)
+        {
+            for (SpriteBatch& batch : row)
+                batch.Clear();
+        }
+    }
+
+    Gizmos::Vertex* Gizmos::Append(D3D11_PRIMITIVE_TOPOLOGY topology, ID3D11RasterizerState* raster, uint32_t count)
+    {
+        // Consecutive draws with the same state land in the same batch.
+        // Only the last one is joined, blended gizmos have to stay in the order they were drawn.
+        auto& batches = s_queue.batches;
+        auto& used    = s_queue.used;
+        auto SameState = [&](const Batch& batch) {
+            return batch.topology == topology && batch.raster == raster
+                && batch.depthTest == depthTest && batch.writeID == (id != 0);
+        };
+
+        if (used == 0 || !SameState(batches[used - 1]))
+        {
+            if (used == batches.size())
+                batches.emplace_back();
+
+            Batch& next    = batches[used++];
+            next.topology  = topology;
+            next.raster    = raster;
+            next.depthTest = depthTest;
+            next.writeID   = id != 0;
+        }
+
+        Batch& batch = batches[used - 1];
+
+        size_t start = batch.vertices.size();
+        batch.vertices.resize(start + count, Vertex { vec3(0.0f), color });
+        return &batch.vertices[start];
     }
 
     void Gizmos::DrawIcon(vec3 pos, Texture* icon, vec3 size)
     {
-        PreDraw();
-        r.SetShader(sh_Sprite);
-        r.ctx->PSSetShaderResources(0, 1, &icon->srvSRGB);
-
-        cbuffers::ObjectState data;
-        data.model = glm::scale(glm::translate(mat4x4(1.0f), pos), size);
-        data.color = color;
-        data.id = id;
-        r.UpdateDynamicBuffer(r.cbuffers.object.ptr(), data);
-        r.ctx->VSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-        r.ctx->PSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-        
-        uint stride = sizeof(Primitives::Vertex);
-        uint offset = 0;
-        r.ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        r.ctx->IASetVertexBuffers(0, 1, &Primitives.Quad, &stride, &offset);
-        r.ctx->Draw(6, 0);
-
-        PostDraw();
+        s_queue.icons[depthTest][id != 0].Add(icon, pos, size.x, color, id);
     }
 
     void Gizmos::DrawPoint(vec3 pos)
@@ -49,34 +93,11 @@ namespace chisel
         DrawIcon(pos, icnHandle.ptr(), vec3(16.f));
     }
 
-    // TODO: These should be batched.
     void Gizmos::DrawLine(vec3 start, vec3 end)
     {
-        PreDraw();
-        r.SetShader(sh_Color);
-
-        mat4x4 mtx = glm::translate(mat4x4(1), start);
-        mtx = glm::rotate(mtx, glm::orientedAngle(glm::vec3(1, 0, 0), glm::normalize(end - start), Vectors.Up), glm::vec3(0, 0, 1));
-        mtx = glm::scale(mtx, glm::vec3(glm::distance(start, end), 1.0f, 1.0f));
-
-        cbuffers::ObjectState data;
-        data.model = mtx;
-        data.color = color;
-        data.id = 0;
-        r.UpdateDynamicBuffer(r.cbuffers.object.ptr(), data);
-        r.ctx->VSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-        r.ctx->PSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-
-        uint stride = sizeof(Primitives::Vertex);
-        uint offset = 0;
-        r.ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
-        r.ctx->IASetVertexBuffers(0, 1, &Primitives.Line, &stride, &offset);
-        r.ctx->RSSetState(r.Raster.SmoothLines.ptr());
-        r.ctx->Draw(2, 0);
-
-        r.ctx->RSSetState(r.Raster.Default.ptr());
-        r.ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        PostDraw();
+        Vertex* vertices = Append(D3D11_PRIMITIVE_TOPOLOGY_LINELIST, r.Raster.SmoothLines.ptr(), 2);
+        vertices[0].pos = start;
+        vertices[1].pos = end;
     }
 
     void Gizmos::DrawPlane(const Plane& plane, bool backFace)
@@ -85,42 +106,13 @@ namespace chisel
         if (!PlaneWinding::CreateFromPlane(plane, winding))
             return;
 
-        PreDraw();
-
-        r.SetShader(sh_Color);
-
-        cbuffers::ObjectState data;
-        data.model = glm::identity<mat4x4>();
-        data.color = color;
-        data.id = 0;
-
-        Primitives::Vertex vertices[6];
+        Vertex* vertices = Append(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, r.Raster.Default.ptr(), 6);
         vertices[0].pos = winding.points[backFace ? 2 : 0];
-        vertices[0].uv = vec2(0.0f);
         vertices[1].pos = winding.points[1];
-        vertices[1].uv = vec2(0.0f);
         vertices[2].pos = winding.points[backFace ? 0 : 2];
-        vertices[2].uv = vec2(0.0f);
         vertices[3].pos = winding.points[backFace ? 3 : 0];
-        vertices[3].uv = vec2(0.0f);
         vertices[4].pos = winding.points[2];
-        vertices[4].uv = vec2(0.0f);
         vertices[5].pos = winding.points[backFace ? 0 : 3];
-        vertices[5].uv = vec2(0.0f);
-
-        ID3D11Buffer* buffer = r.scratchVertex.ptr();
-
-        r.UpdateDynamicBuffer(r.cbuffers.object.ptr(), data);
-        r.UpdateDynamicBuffer(buffer, vertices, sizeof(vertices));
-        r.ctx->VSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-        r.ctx->PSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-
-        uint stride = sizeof(Primitives::Vertex);
-        uint offset = 0;
-        r.ctx->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
-        r.ctx->Draw(6, 0);
-
-        PostDraw();
     }
 
     void Gizmos::DrawAABB(const AABB& aabb)
@@ -131,7 +123,6 @@ namespace chisel
 
     void Gizmos::DrawBox(std::span<vec3, 8> corners)
     {
-        PreDraw();
         static constexpr std::array<std::array<uint32_t, 4>, 8> CornerIndices =
         {{
             { 5,4,6,7 },
@@ -142,13 +133,10 @@ namespace chisel
             { 2,6,4,0 },
         }};
 
-        r.SetShader(Chisel.Renderer->Shaders.Brush);
+        // Same half-lambert as Lighting() in common.hlsli, baked into the vertex colors
+        static const vec3 LightDir = glm::normalize(vec3(1, 3, 2));
 
-        cbuffers::BrushState data;
-        data.color = color;
-        data.id = 0;
-
-        VertexSolid vertices[6 * 6];
+        Vertex* vertices = Append(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, r.Raster.DepthBiased.ptr(), 6 * 6);
         for (uint32_t i = 0; i < 6; i++)
         {
             vec3 v0 = corners[CornerIndices[i][0]];
@@ -157,31 +145,17 @@ namespace chisel
             vec3 v3 = corners[CornerIndices[i][3]];
 
             vec3 normal = Plane::NormalFromPoints(v0, v1, v2);
-
-            vertices[6 * i + 0] = { v0, normal };
-            vertices[6 * i + 1] = { v1, normal };
-            vertices[6 * i + 2] = { v2, normal };
-            vertices[6 * i + 3] = { v0, normal };
-            vertices[6 * i + 4] = { v2, normal };
-            vertices[6 * i + 5] = { v3, normal };
+            float NoL = 0.5f + 0.5f * glm::clamp(glm::dot(normal, LightDir), 0.0f, 1.0f);
+            vec4 shaded = vec4(vec3(vec4(color)) * NoL, color.a);
+
+            Vertex* face = &vertices[6 * i];
+            face[0] = { v0, shaded };
+            face[1] = { v1, shaded };
+            face[2] = { v2, shaded };
+            face[3] = { v0, shaded };
+            face[4] = { v2, shaded };
+            face[5] = { v3, shaded };
         }
-
-        ID3D11Buffer* buffer = r.scratchVertex.ptr();
-
-        r.ctx->RSSetState(r.Raster.DepthBiased.ptr());
-        r.UpdateDynamicBuffer(r.cbuffers.brush.ptr(), data);
-        r.UpdateDynamicBuffer(buffer, vertices, sizeof(vertices));
-        r.ctx->VSSetConstantBuffers1(1, 1, &r.cbuffers.brush, nullptr, nullptr);
-        r.ctx->PSSetConstantBuffers1(1, 1, &r.cbuffers.brush, nullptr, nullptr);
-        r.ctx->PSSetShaderResources(0, 1, &Chisel.Renderer->Textures.White->srvSRGB);
-
-        uint stride = sizeof(VertexSolid);
-        uint offset = 0;
-        r.ctx->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
-        r.ctx->Draw(6 * 6, 0);
-
-        r.ctx->RSSetState(r.Raster.Default.ptr());
-        PostDraw();
     }
 
     void Gizmos::DrawWireAABB(const AABB& aabb)
@@ -192,8 +166,6 @@ namespace chisel
 
     void Gizmos::DrawWireBox(std::span<vec3, 8> corners)
     {
-        // TODO: Use batched DrawLine instead of this nonsense
-        PreDraw();
         static constexpr std::array<uint, 24> CornerIndices =
         {{
             0, 1,
@@ -213,37 +185,9 @@ namespace chisel
             2, 6,
         }};
 
-        r.SetShader(sh_Color);
-
-        cbuffers::ObjectState data;
-        data.model = glm::identity<mat4x4>();
-        data.color = color;
-        data.id = 0;
-
-        Primitives::Vertex vertices[24];
+        Vertex* vertices = Append(D3D11_PRIMITIVE_TOPOLOGY_LINELIST, r.Raster.SmoothLines.ptr(), 24);
         for (uint32_t i = 0; i < 24; i++)
-        {
-            vertices[i] = { corners[CornerIndices[i]], vec2(0.0f) };
-        }
-
-        ID3D11Buffer* buffer = r.scratchVertex.ptr();
-
-        r.ctx->RSSetState(r.Raster.SmoothLines.ptr());
-        
-        r.UpdateDynamicBuffer(r.cbuffers.object.ptr(), data);
-        r.UpdateDynamicBuffer(buffer, vertices, sizeof(vertices));
-        r.ctx->VSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-        r.ctx->PSSetConstantBuffers1(1, 1, &r.cbuffers.object, nullptr, nullptr);
-
-        uint stride = sizeof(Primitives::Vertex);
-        uint offset = 0;
-        r.ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_LINELIST);
-        r.ctx->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
-        r.ctx->Draw(24, 0);
-
-        r.ctx->RSSetState(r.Raster.Default.ptr());
-        r.ctx->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        PostDraw();
+            vertices[i].pos = corners[CornerIndices[i]];
     }
 
     void Gizmos::Reset()
@@ -251,21 +195,134 @@ namespace chisel
         struct Gizmos g;
         *this = g;
     }
-    
-    void Gizmos::PreDraw()
+
+    static void SetGizmoState(render::RenderContext& r, bool depthTest, bool writeID)
     {
         r.ctx->OMSetDepthStencilState(depthTest ? r.Depth.Default.ptr() : r.Depth.Ignore.ptr(), 0);
 
-        if (id == 0)
-            r.SetBlendState(render::BlendFuncs::AlphaNoSelection);
-        else
+        if (writeID)
             r.SetBlendState(render::BlendFuncs::Alpha);
+        else
+            r.SetBlendState(render::BlendFuncs::AlphaNoSelection);
     }
 
-    void Gizmos::PostDraw()
+    void Gizmos::Discard()
     {
-        r.ctx->OMSetDepthStencilState(r.Depth.Default.ptr(), 0);
+        s_queue.Clear();
+    }
+
+    void Gizmos::Take(List& list)
+    {
+        // Swapping hands the queue's vertices over and gives it the list's emptied storage back
+        list.Clear();
+        std::swap(list.batches, s_queue.batches);
+        std::swap(list.used, s_queue.used);
+
+        for (uint i = 0; i < 2; i++)
+        {
+            for (uint j = 0; j < 2; j++)
+                list.icons[i][j].Swap(s_queue.icons[i][j]);
+        }
+    }
 
+    uint64 Gizmos::Hash(uint64 seed)
+    {
+        for (const Batch& batch : s_queue.batches)
+        {
+            if (batch.vertices.empty())
+                continue;
+
+            seed = HashValue(batch.topology, seed);
+            seed = HashValue(batch.raster, seed);
+            seed = HashValue(batch.depthTest, seed);
+            seed = HashValue(batch.writeID, seed);
+            seed = HashBytes(batch.vertices.data(), batch.vertices.size() * sizeof(Vertex), seed);
+        }
+
+        for (auto& row : s_queue.icons)
+        {
+            for (const SpriteBatch& batch : row)
+                seed = batch.Hash(seed);
+        }
+        return seed;
+    }
+
+    void Gizmos::Draw(render::RenderContext& r, List& list)
+    {
+        PROFILE_ZONE("Gizmos::Draw");
+
+        if (list.ring)
+        {
+            r.SetShader(sh_Gizmo);
+
+            uint stride = sizeof(Vertex);
+            uint offset = 0;
+            ID3D11Buffer* ring = list.ring.ptr();
+            r.ctx->IASetVertexBuffers(0, 1, &ring, &stride, &offset);
+
+            // A deferred context must discard a dynamic buffer before it may map it any other way
+            if (r.deferred)
+                list.ringOffset = RingSize;
+
+            for (Batch& batch : list.batches)
+            {
+                if (batch.vertices.empty())
+                    continue;
+
+                SetGizmoState(r, batch.depthTest, batch.writeID);
+                r.ctx->RSSetState(batch.raster);
+                r.ctx->IASetPrimitiveTopology(batch.topology);
+
+                // Batches bigger than the ring go in chunks of whole primitives
+                uint32_t total = uint32_t(batch.vertices.size());
+                uint32_t first = 0;
+                while (first < total)
+                {
+                    uint32_t count = std::min(total - first, RingSize - RingSize % 6);
+
+                    D3D11_MAP mode = D3D11_MAP_WRITE_NO_OVERWRITE;
+                    if (list.ringOffset + count > RingSize)
+                    {
+                        mode = D3D11_MAP_WRITE_DISCARD;
+                        list.ringOffset = 0;
+                    }
+
+                    D3D11_MAPPED_SUBRESOURCE mapped;
+                    if (FAILED(r.ctx->Map(ring, 0, mode, 0, &mapped)))
+                        abort();
+                    memcpy((Vertex*)mapped.pData + list.ringOffset, &batch.vertices[first], count * sizeof(Vertex));
+                    r.ctx->Unmap(ring, 0);
+
+                    r.ctx->Draw(count, list.ringOffset);
+
+                    list.ringOffset += count;
+                    first += count;
+                }
+            }
+
+            r.ctx->RSSetState(r.Raster.Default.ptr());
+            r.ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        }
+
+        // Icons after geometry so handles stay on top of the boxes they belong to
+        r.ctx->PSSetSamplers(0, 1, &r.Sample.Point);
+        for (bool depthTest : { true, false })
+        {
+            for (bool writeID : { false, true })
+            {
+                SpriteBatch& icons = list.icons[depthTest][writeID];
+                if (icons.Size() == 0)
+                    continue;
+
+                SetGizmoState(r, depthTest, writeID);
+                icons.Draw(r);
+            }
+        }
+        r.ctx->PSSetSamplers(0, 1, &r.Sample.Default);
+
+        r.ctx->OMSetDepthStencilState(r.Depth.Default.ptr(), 0);
         r.SetBlendState(render::BlendFuncs::Normal);
+
+        list.Clear();
     }
 }
@@ -5,8 +5,10 @@
 #include "math/Math.h"
 #include "Selection.h"
 #include "math/Plane.h"
+#include "SpriteBatch.h"
 
 #include <span>
+#include <vector>
 
 namespace chisel
 {
@@ -14,8 +16,7 @@ namespace chisel
     {
         static inline Rc<Texture> icnObsolete;
         static inline Rc<Texture> icnHandle;
-        static inline render::Shader sh_Sprite;
-        static inline render::Shader sh_Color;
+        static inline render::Shader sh_Gizmo;
 
         Color color    = Colors.White;
         bool depthTest = true;
@@ -35,9 +36,69 @@ namespace chisel
         void DrawWireAABB(const AABB& aabb);
 
         static void Init();
+
+        struct List;
+
+        // Move everything queued by the Draw* functions since the last take into list,
+        // so it can be drawn later, possibly from another thread.
+        static void Take(List& list);
+
+        // Draw list while a viewport's render targets are bound, then clear it.
+        static void Draw(render::RenderContext& r, List& list);
+
+        // Drop everything queued without drawing it.
+        static void Discard();
+
+        // Hash of everything queued, chained onto seed.
+        // Lets views skip re-rendering when the gizmos haven't changed.
+        static uint64 Hash(uint64 seed);
+
     protected:
-        void PreDraw();
-        void PostDraw();
+        struct Vertex
+        {
+            vec3 pos;
+            vec4 color;
+
+            static constexpr D3D11_INPUT_ELEMENT_DESC Layout[] =
+            {
+                { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,                            D3D11_INPUT_PER_VERTEX_DATA, 0 },
+                { "COLOR",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            };
+        };
+
+        // World-space vertices that share pipeline state
+        struct Batch
+        {
+            D3D11_PRIMITIVE_TOPOLOGY topology;
+            ID3D11RasterizerState*   raster;
+            bool                     depthTest;
+            bool                     writeID;
+            std::vector<Vertex>      vertices;
+        };
+
+        // Transient vertex ring, appended with NO_OVERWRITE and discarded when it wraps
+        static constexpr uint32_t RingSize = 64 * 1024; // vertices
+
+    public:
+        // Gizmos of one view. Owns its own vertex ring, so several views can draw at once.
+        struct List
+        {
+            std::vector<Batch> batches;
+            uint32_t           used = 0;    // Batches in draw order, the rest keep their storage for reuse
+            SpriteBatch        icons[2][2]; // [depthTest][writeID]
+
+            Com<ID3D11Buffer>  ring;
+            uint32_t           ringOffset = 0;
+
+            void Init(render::RenderContext& r);
+            void Clear();
+        };
+
+    protected:
+        Vertex* Append(D3D11_PRIMITIVE_TOPOLOGY topology, ID3D11RasterizerState* raster, uint32_t count);
+
+        // Shared by every Gizmos instance, so scoped Gizmo objects draw with the rest
+        static inline List s_queue;
 
         static render::RenderContext& r;
     } Gizmos;
@@ -163,9 +163,8 @@ namespace chisel
     //  Grid
     //--------------------------------------------------
 
-    void Handles::DrawGrid(Camera& camera, vec3 gridSize)
+    void Handles::DrawGrid(render::RenderContext& r, Camera& camera, vec3 gridSize)
     {
-        auto& r = Engine.rctx;
         r.SetBlendState(render::BlendFuncs::Alpha);
         r.ctx->OMSetDepthStencilState(r.Depth.LessEqual.ptr(), 0);
         r.ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
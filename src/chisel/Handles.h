@@ -48,7 +48,7 @@ namespace chisel
 
         static constexpr int gridChunkSize = 200;
 
-        void DrawGrid(Camera& camera, vec3 gridSize);
+        void DrawGrid(render::RenderContext& r, Camera& camera, vec3 gridSize);
 
         Handles();
 
@@ -0,0 +1,7 @@
+#include "chisel/Chisel.h"
+
+int main(int argc, char* argv[])
+{
+    using namespace chisel;
+    Chisel.Run();
+}
@@ -1,21 +1,35 @@
 #include "MapRender.h"
 
 #include "console/ConVar.h"
+#include "common/Profiler.h"
 #include "core/Transform.h"
 #include "FGD/FGD.h"
 #include "gui/Viewport.h"
 #include "render/CBuffers.h"
+#include "chisel/Handles.h"
 #include <glm/gtx/normal.hpp>
 
+#include <algorithm>
+
 namespace chisel
 {
     static ConVar<bool> r_drawbrushes("r_drawbrushes", true, "Draw brushes");
     static ConVar<bool> r_drawworld("r_drawworld", true, "Draw world");
     static ConVar<bool> r_drawsprites("r_drawsprites", true, "Draw sprites");
 
+    static ConVar<bool> r_chunks("r_chunks", true, "Draw unselected brushes merged by world cell");
+    static ConVar<bool> r_cull("r_cull", true, "Skip brush meshes outside the view frustum");
+    static ConVar<bool> r_occlusion("r_occlusion", true, "Skip brush meshes hidden behind large world brushes");
+
+    static ConVar<int>  r_view_threads("r_view_threads", 0, "Threads recording viewports in multi-view layouts. 0 uses every core, 1 draws on the main thread only");
+
+    static ConVar<bool>  r_disp_lod("r_disp_lod", false, "Draw far away displacements at a lower power. Edges aren't stitched, so expect seams between neighbours at different powers");
+    static ConVar<float> r_disp_lod_distance("r_disp_lod_distance", 2048.0f, "Distance at which displacements drop one power. Each doubling of it drops another");
+
     // Orange Tint: Color(0.8, 0.4, 0.1, 1);
     static ConVar<vec4> color_selection = ConVar<vec4>("color_selection", vec4(0.6, 0.1, 0.1, 1), "Selection color");
     static ConVar<vec4> color_selection_outline = ConVar<vec4>("color_selection_outline", vec4(0.95, 0.59, 0.19, 1), "Selection outline color");
+    static ConVar<float> r_selection_outline_width("r_selection_outline_width", 1.0f, "Width in pixels of the outline around selected brushes");
     static ConVar<vec4> color_preview = ConVar<vec4>("color_preview", vec4(1, 1, 1, 0.5), "Placement preview color");
 
     MapRender::MapRender()
@@ -23,108 +37,435 @@ namespace chisel
     {
     }
 
+    MapRender::~MapRender()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_all();
+
+        for (std::thread& thread : m_recorders)
+            thread.join();
+    }
+
     void MapRender::Start()
     {
         Shaders.Brush = render::Shader(r.device.ptr(), VertexSolid::Layout, "brush");
         Shaders.BrushBlend = render::Shader(r.device.ptr(), VertexSolid::Layout, "brush_blend");
         Shaders.BrushDebugID = render::Shader(r.device.ptr(), VertexSolid::Layout, "brush_debug_id");
+        Shaders.SelectionOutline = render::Shader(r.device.ptr(), nullptr, "selection_outline");
 
         // Load builtin textures
         Textures.Missing = Assets.Load<Texture>("textures/error.png");
         Textures.White = Assets.Load<Texture>("textures/white.png");
 
         Chisel.brushAllocator = std::make_unique<BrushGPUAllocator>(r);
+        Engine.OnEndFrame += [](render::RenderContext&) { Chisel.brushAllocator->EndFrame(); };
+        dispIndices = std::make_unique<DispIndexBuffer>(r);
+
+        m_idView = std::make_unique<ViewRender>();
+        m_idView->r = &r;
+        m_idView->sprites.Init(r);
+
+        Engine.OnRender += [this](render::RenderContext&) { RenderViews(); };
+    }
+
+    void MapRender::Update()
+    {
+        Selection.TakeChanges(m_selectionChanges);
+        Solid::UpdateSelectedFaces(m_selectionChanges);
+
+        // Merge and rebuild world cells before any viewport draws them
+        map.Chunks().Update(map, *Chisel.brushAllocator, m_selectionChanges);
+    }
+
+    //--------------------------------------------------
+    //  View Queue
+    //--------------------------------------------------
+
+    void MapRender::CaptureView(ViewRender& view, Viewport& viewport)
+    {
+        view.viewport  = &viewport;
+        view.camera    = viewport.GetCamera();
+        view.view      = view.camera.ViewMatrix();
+        view.proj      = view.camera.ProjMatrix();
+        view.cameraPos = view.camera.position;
+        view.drawMode  = viewport.drawMode;
+        view.wireframe = view.drawMode == Viewport::DrawMode::Wireframe;
+    }
+
+    void MapRender::QueueViewport(Viewport& viewport)
+    {
+        if (!viewport.renderView)
+        {
+            viewport.renderView = std::make_unique<ViewRender>();
+            viewport.renderView->sprites.Init(r);
+            viewport.renderView->gizmos.Init(r);
+            viewport.renderView->culler = std::make_unique<OcclusionCuller>();
+        }
+
+        ViewRender& view = *viewport.renderView;
+        CaptureView(view, viewport);
+        view.grid     = view_grid_show;
+        view.gridSize = view_grid_size;
+
+        // Everything the handles and tools queued up for this view
+        Gizmos::Take(view.gizmos);
+
+        if (std::find(m_views.begin(), m_views.end(), &view) == m_views.end())
+            m_views.push_back(&view);
     }
 
-    void MapRender::DrawViewport(Viewport& viewport)
+    void MapRender::ForgetViewport(Viewport& viewport)
     {
-        // Get camera matrices
-        Camera& camera = viewport.GetCamera();
-        mat4x4 view = camera.ViewMatrix();
-        mat4x4 proj = camera.ProjMatrix();
+        if (viewport.renderView)
+            std::erase(m_views, viewport.renderView.get());
+    }
+
+    void MapRender::RenderViews()
+    {
+        if (m_views.empty())
+            return;
+
+        PROFILE_ZONE("MapRender::RenderViews");
+
+        // GetClass caches what it resolves. Do that here, so the recorders only read it.
+        if (r_drawsprites)
+        {
+            for (const PointEntity& point : map.PointEntities())
+                point.GetClass();
+        }
+
+        // More threads than views would only wait around
+        int setting = r_view_threads;
+        uint threads = setting > 0 ? uint(setting) : std::max(std::thread::hardware_concurrency(), 1u);
+        threads = std::min(threads, uint(m_views.size()));
+
+        // Deferred contexts for every thread, workers for all but the main thread's
+        while (threads > 1 && m_contexts.size() < threads)
+        {
+            auto context = std::make_unique<render::RenderContext>();
+            if (!context->InitDeferred(r))
+            {
+                threads = uint(m_contexts.size());
+                break;
+            }
+            m_contexts.push_back(std::move(context));
+        }
+        while (threads > 1 && m_recorders.size() + 1 < threads)
+            m_recorders.emplace_back(&MapRender::RecorderLoop, this, uint(m_recorders.size() + 1), m_batch);
+
+        if (threads <= 1)
+        {
+            // A single view gains nothing from a command list, draw it straight away
+            PROFILE_GPU_ZONE("Viewports");
+            for (ViewRender* view : m_views)
+                RecordView(*view, r);
+        }
+        else
+        {
+            // Views are handed out one at a time, the main thread records its share too
+            m_nextView = 0;
+            {
+                std::lock_guard lock(m_mutex);
+                m_busy = uint(m_recorders.size());
+                m_batch++;
+            }
+            m_cv.notify_all();
+
+            RecordViews(*m_contexts[0]);
+
+            {
+                std::unique_lock lock(m_mutex);
+                m_cv.wait(lock, [&] { return m_busy == 0; });
+            }
+
+            // Submit in queue order so the frame comes out the same as drawing them one by one
+            PROFILE_GPU_ZONE("Viewports");
+            for (ViewRender* view : m_views)
+            {
+                if (view->commands)
+                    r.ctx->ExecuteCommandList(view->commands.ptr(), FALSE);
+                view->commands = nullptr;
+            }
+
+            // Executing without restoring leaves the immediate context in its cleared state
+            r.SetDefaultState();
+        }
+
+        cullStats = {};
+        for (ViewRender* view : m_views)
+        {
+            if (!view->culler)
+                continue;
+
+            const OcclusionCuller::Stats& stats = view->culler->GetStats();
+            cullStats.occluders     += stats.occluders;
+            cullStats.tested        += stats.tested;
+            cullStats.frustumCulled += stats.frustumCulled;
+            cullStats.occluded      += stats.occluded;
+            cullStats.rasterMs      += stats.rasterMs;
+        }
+
+        m_views.clear();
+    }
+
+    void MapRender::RecordViews(render::RenderContext& r)
+    {
+        for (size_t i = m_nextView++; i < m_views.size(); i = m_nextView++)
+        {
+            ViewRender& view = *m_views[i];
+            RecordView(view, r);
+            view.commands = r.FinishCommandList();
+        }
+    }
+
+    void MapRender::RecordView(ViewRender& view, render::RenderContext& r)
+    {
+        PROFILE_ZONE("MapRender::RecordView");
+
+        view.r = &r;
+        r.SetDefaultState();
+
+        DrawViewport(view);
+
+        Gizmos::Draw(r, view.gizmos);
+
+        if (view.grid)
+            Handles.DrawGrid(r, view.camera, view.gridSize);
+    }
+
+    void MapRender::RecorderLoop(uint index, uint64 batch)
+    {
+#if CHISEL_PROFILE
+        Profiler::SetThreadName("View Recorder");
+#endif
+
+        for (;;)
+        {
+            {
+                std::unique_lock lock(m_mutex);
+                m_cv.wait(lock, [&] { return m_quit || m_batch != batch; });
+                if (m_quit)
+                    return;
+                batch = m_batch;
+            }
+
+            RecordViews(*m_contexts[index]);
+
+            {
+                std::lock_guard lock(m_mutex);
+                if (--m_busy == 0)
+                    m_cv.notify_all();
+            }
+        }
+    }
+
+    //--------------------------------------------------
+    //  Drawing
+    //--------------------------------------------------
+
+    void MapRender::SetupView(ViewRender& view)
+    {
+        render::RenderContext& r = *view.r;
 
         // Update CameraState
         cbuffers::CameraState data;
-        data.viewProj = proj * view;
-        data.view = view;
+        data.viewProj = view.proj * view.view;
+        data.view = view.view;
 
         r.UpdateDynamicBuffer(r.cbuffers.camera.ptr(), data);
         r.ctx->VSSetConstantBuffers1(0, 1, &r.cbuffers.camera, nullptr, nullptr);
 
-        ID3D11RenderTargetView* rts[] = {viewport.rt_SceneView->rtv.ptr(), viewport.rt_ObjectID->rtv.ptr()};
-        r.ctx->OMSetRenderTargets(2, rts, viewport.ds_SceneView->dsv.ptr());
-
-        float2 size = viewport.rt_SceneView->GetSize();
+        float2 size = view.viewport->rt_SceneView->GetSize();
         D3D11_VIEWPORT viewrect = { 0, 0, size.x, size.y, 0.0f, 1.0f };
         r.ctx->RSSetViewports(1, &viewrect);
+    }
+
+    void MapRender::DrawBrushes(ViewRender& view)
+    {
+        if (!r_drawbrushes)
+            return;
+
+        // Merged cells stand in for their solids in the scene.
+        // Picking and the ID view need every solid's own ID, so they draw solids one by one.
+        view.chunks = r_chunks && r_drawworld && !view.idPass && view.drawMode != Viewport::DrawMode::ObjectID;
+        if (view.chunks)
+            DrawChunks(view);
+
+        if (r_drawworld)
+            DrawBrushEntity(view, map);
+
+        for (BrushEntity& brush : map.BrushEntities())
+            DrawBrushEntity(view, brush);
+    }
+
+    void MapRender::DrawViewport(ViewRender& view)
+    {
+        PROFILE_ZONE("MapRender::DrawViewport");
+
+        render::RenderContext& r = *view.r;
+        Viewport& viewport = *view.viewport;
+
+        SetupView(view);
+
+        // Start rasterizing occluders while the world is gathered. Wireframe sees through everything.
+        view.cull = r_cull && view.culler;
+        if (view.cull)
+        {
+            view.culler->Begin(view.proj * view.view);
+            if (r_occlusion && !view.wireframe)
+                occlusion.Queue(*view.culler, map);
+        }
+
+        // Selected brushes and faces mark themselves in the selection mask,
+        // which is tinted and outlined in one pass after them
+        bool outline = !Selection.Empty() && view.drawMode != Viewport::DrawMode::ObjectID;
+
+        // Object IDs are rendered separately, only when queried
+        ID3D11RenderTargetView* rts[] = {
+            viewport.rt_SceneView->rtv.ptr(),
+            nullptr,
+            outline ? viewport.rt_Selection->rtv.ptr() : nullptr
+        };
+        r.ctx->OMSetRenderTargets(3, rts, viewport.ds_SceneView->dsv.ptr());
 
         r.ctx->ClearRenderTargetView(viewport.rt_SceneView->rtv.ptr(), Color(0.2, 0.2, 0.2).Linear());
-        r.ctx->ClearRenderTargetView(viewport.rt_ObjectID->rtv.ptr(), Colors.Black);
         r.ctx->ClearDepthStencilView(viewport.ds_SceneView->dsv.ptr(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+        if (outline)
+            r.ctx->ClearRenderTargetView(viewport.rt_Selection->rtv.ptr(), Colors.Black);
 
-        drawMode = viewport.drawMode;
-        if (wireframe = drawMode == Viewport::DrawMode::Wireframe)
+        if (view.wireframe)
             r.ctx->RSSetState(r.Raster.Wireframe.ptr());
         else
             r.ctx->RSSetState(r.Raster.Default.ptr());
 
-        // TODO: Cull!
-        if (r_drawbrushes)
-        {
-            if (r_drawworld)
-                DrawBrushEntity(map);
-
-            for (auto* entity : map.Entities())
-            {
-                if (BrushEntity* brush = dynamic_cast<BrushEntity*>(entity))
-                    DrawBrushEntity(*brush);
-            }
-        }
+        DrawBrushes(view);
+        view.cull = false;
 
-        if (wireframe)
+        if (view.wireframe)
             r.ctx->RSSetState(r.Raster.Default.ptr());
 
-        for (const auto* entity : map.Entities())
-        {
-            const PointEntity* point = dynamic_cast<const PointEntity*>(entity);
-            if (!point) continue;
+        // Done with the mask, sprites keep their own selection color
+        r.ctx->OMSetRenderTargets(1, rts, viewport.ds_SceneView->dsv.ptr());
+        if (outline)
+            DrawSelectionOutline(view);
 
-            DrawPointEntity(entity->classname, false, point->origin, vec3(0), point->IsSelected(), point->GetSelectionID());
-        }
+        DrawPointEntities(view);
 
         r.ctx->RSSetState(r.Raster.Default.ptr());
     }
 
-    void MapRender::DrawPointEntity(const std::string& classname, bool preview, vec3 origin, vec3 angles, bool selected, SelectionID id)
+    void MapRender::DrawSelectionOutline(ViewRender& view)
     {
-        Color color = selected ? Color(color_selection) : (preview ? Color(color_preview) : Colors.White);
+        render::RenderContext& r = *view.r;
+
+        cbuffers::SelectionState state;
+        state.tint    = color_selection;
+        state.outline = color_selection_outline;
+        state.width   = std::max(float(r_selection_outline_width), 0.0f);
+        r.UpdateDynamicBuffer(r.cbuffers.selection.ptr(), state);
+        r.ctx->PSSetConstantBuffers(1, 1, &r.cbuffers.selection);
+
+        ID3D11ShaderResourceView* mask = view.viewport->rt_Selection->srvLinear.ptr();
+        r.ctx->PSSetShaderResources(0, 1, &mask);
+
+        // Full screen triangle, no vertex input
+        r.SetShader(Shaders.SelectionOutline);
+        r.ctx->IASetInputLayout(nullptr);
+        r.ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        r.ctx->RSSetState(r.Raster.Default.ptr());
+        r.ctx->OMSetDepthStencilState(r.Depth.Ignore.ptr(), 0);
+        r.SetBlendState(render::BlendFuncs::AddMultiply);
+        r.ctx->Draw(3, 0);
 
-        // Draw sprites
-        if (Chisel.fgd->classes.contains(classname))
-        {
-            auto& cls = Chisel.fgd->classes[classname];
+        // Written again next frame
+        ID3D11ShaderResourceView* nullSRV = nullptr;
+        r.ctx->PSSetShaderResources(0, 1, &nullSRV);
+
+        r.ctx->OMSetDepthStencilState(r.Depth.Default.ptr(), 0);
+        r.SetBlendState(render::BlendFuncs::Normal);
+    }
 
-            AABB bounds = AABB{cls.bbox[0], cls.bbox[1]};
+    void MapRender::DrawObjectID(Viewport& viewport, Rect region)
+    {
+        PROFILE_ZONE("MapRender::DrawObjectID");
+        PROFILE_GPU_ZONE("DrawObjectID");
 
-            if (!r_drawsprites)
-                return;
+        ViewRender& view = *m_idView;
+        CaptureView(view, viewport);
+        SetupView(view);
 
-            r.ctx->PSSetSamplers(0, 1, &r.Sample.Point);
-            Gizmos.color = color;
-            Gizmos.id = id;
-            Gizmos.DrawIcon(origin, cls.texture != nullptr ? cls.texture.ptr() : Gizmos.icnObsolete.ptr());
-            Gizmos.id = 0;
-            r.ctx->PSSetSamplers(0, 1, &r.Sample.Default);
-        }
-        else if (r_drawsprites)
+        // Render into the ID target only. The scene pass is drawn later in the frame
+        // and clears depth itself, so its depth buffer is free to reuse.
+        ID3D11RenderTargetView* rts[] = { nullptr, viewport.rt_ObjectID->rtv.ptr() };
+        r.ctx->OMSetRenderTargets(2, rts, viewport.ds_SceneView->dsv.ptr());
+
+        r.ctx->ClearRenderTargetView(viewport.rt_ObjectID->rtv.ptr(), Colors.Black);
+        r.ctx->ClearDepthStencilView(viewport.ds_SceneView->dsv.ptr(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+        // Only rasterize the queried region
+        D3D11_RECT scissor = {
+            LONG(region.x), LONG(region.y),
+            LONG(std::ceil(region.x + region.w)), LONG(std::ceil(region.y + region.h))
+        };
+        r.ctx->RSSetScissorRects(1, &scissor);
+
+        view.idPass = true;
+        r.ctx->RSSetState(view.wireframe ? r.Raster.WireframeScissor.ptr() : r.Raster.Scissor.ptr());
+        DrawBrushes(view);
+        r.ctx->RSSetState(r.Raster.Scissor.ptr());
+        DrawPointEntities(view);
+        view.idPass = false;
+
+        r.ctx->RSSetState(r.Raster.Default.ptr());
+        r.ctx->OMSetRenderTargets(0, nullptr, nullptr);
+    }
+
+    Texture* MapRender::GetEntityIcon(const FGD::Class* cls) const
+    {
+        if (cls && cls->texture != nullptr)
+            return cls->texture.ptr();
+
+        return Gizmos.icnObsolete.ptr();
+    }
+
+    void MapRender::DrawPointEntities(ViewRender& view)
+    {
+        if (!r_drawsprites)
+            return;
+
+        render::RenderContext& r = *view.r;
+
+        for (const PointEntity& point : map.PointEntities())
         {
-            r.ctx->PSSetSamplers(0, 1, &r.Sample.Point);
-            Gizmos.color = color;
-            Gizmos.id = id;
-            Gizmos.DrawIcon(origin, Gizmos.icnObsolete.ptr());
-            Gizmos.id = 0;
-            r.ctx->PSSetSamplers(0, 1, &r.Sample.Default);
+            vec4 color = point.IsSelected() ? vec4(color_selection) : vec4(Colors.White);
+            view.sprites.Add(GetEntityIcon(point.GetClass()), point.origin, 32.0f, color, point.GetSelectionID());
         }
+
+        // Draw all sprites in one pass
+        r.ctx->OMSetDepthStencilState(r.Depth.Default.ptr(), 0);
+        r.SetBlendState(render::BlendFuncs::Alpha);
+        r.ctx->PSSetSamplers(0, 1, &r.Sample.Point);
+
+        view.sprites.Draw(r);
+
+        r.ctx->PSSetSamplers(0, 1, &r.Sample.Default);
+        r.SetBlendState(render::BlendFuncs::Normal);
+    }
+
+    void MapRender::DrawPointEntity(const std::string& classname, bool preview, vec3 origin, vec3 angles, bool selected, SelectionID id)
+    {
+        if (!r_drawsprites)
+            return;
+
+        Color color = selected ? Color(color_selection) : (preview ? Color(color_preview) : Colors.White);
+
+        Gizmos.color = color;
+        Gizmos.id = id;
+        Gizmos.DrawIcon(origin, GetEntityIcon(Chisel.fgd->Find(classname)));
+        Gizmos.id = 0;
     }
 
     struct BrushPass : cbuffers::BrushState
@@ -132,27 +473,51 @@ namespace chisel
         BrushMesh* mesh;
         uint indices;
         uint startIndex = 0;
+        uint lod = 0;
         Texture* texOverride = nullptr;
 
         BrushPass(BrushMesh* mesh)
         {
             this->mesh = mesh;
-            indices = mesh->indices.size();
-            id = mesh->brush->GetSelectionID();
+            indices = mesh->indexCount;
+            id = mesh->brush ? mesh->brush->GetSelectionID() : 0; // Merged meshes use face IDs
             color = Colors.White;
+            selected = 0;
         }
     };
 
-    inline void MapRender::DrawPass(const BrushPass& pass)
+    inline void MapRender::DrawPass(ViewRender& view, const BrushPass& pass)
     {
-        r.UpdateDynamicBuffer(r.cbuffers.brush.ptr(), pass);
+        render::RenderContext& r = *view.r;
+
+        cbuffers::BrushState state = pass;
+        state.faceOffset = pass.mesh->FaceOffset();
+        r.UpdateDynamicBuffer(r.cbuffers.brush.ptr(), state);
         r.ctx->PSSetConstantBuffers(1, 1, &r.cbuffers.brush);
         r.ctx->VSSetConstantBuffers(1, 1, &r.cbuffers.brush);
 
+        uint page = pass.mesh->alloc->page;
+        ID3D11ShaderResourceView* faces = Chisel.brushAllocator->srv(page);
+        r.ctx->VSSetShaderResources(8, 1, &faces);
+
         uint stride = sizeof(VertexSolid);
         uint vertexOffset = pass.mesh->alloc->offset;
-        uint indexOffset = vertexOffset + pass.mesh->vertices.size() * stride;
-        ID3D11Buffer* buffer = Chisel.brushAllocator->buffer();
+        uint indexOffset = pass.mesh->IndexOffset();
+        ID3D11Buffer* buffer = Chisel.brushAllocator->buffer(page);
+
+        // Displacements draw from the shared index buffer for their power
+        ID3D11Buffer* indexBuffer = buffer;
+        uint numIndices = pass.indices;
+        uint startIndex = pass.startIndex;
+        if (pass.mesh->IsDisplacement())
+        {
+            const auto& range = dispIndices->range(pass.mesh->dispPower, pass.lod);
+            indexBuffer = dispIndices->buffer();
+            indexOffset = 0;
+            numIndices = range.count;
+            startIndex = range.start;
+        }
+
         ID3D11ShaderResourceView *srv = nullptr;
         bool pointSample = false;
 
@@ -194,129 +559,138 @@ namespace chisel
         else
             r.SetShader(Shaders.Brush);
 
-        if (this->drawMode == Viewport::DrawMode::ObjectID)
+        if (view.drawMode == Viewport::DrawMode::ObjectID)
             r.SetShader(Shaders.BrushDebugID);
 
         r.ctx->IASetVertexBuffers(0, 1, &buffer, &stride, &vertexOffset);
-        r.ctx->IASetIndexBuffer(buffer, DXGI_FORMAT_R32_UINT, indexOffset);
-        r.ctx->DrawIndexed(pass.indices, pass.startIndex, 0);
+        r.ctx->IASetIndexBuffer(indexBuffer, BrushIndexFormat, indexOffset);
+        r.ctx->DrawIndexed(numIndices, startIndex, 0);
         if (pointSample)
         {
             r.ctx->PSSetSamplers(0, 1, &r.Sample.Default);
         }
     }
 
-    inline void MapRender::DrawSelectionOutline(BrushPass pass)
-    {
-        r.SetBlendState(render::BlendFuncs::Alpha);
-        r.ctx->RSSetState(r.Raster.Wireframe.ptr());
-        r.ctx->OMSetDepthStencilState(r.Depth.NoWrite.ptr(), 0);
-        pass.color = color_selection_outline;
-        pass.texOverride = Textures.White.ptr();
-        DrawPass(pass);
-        r.ctx->OMSetDepthStencilState(r.Depth.Default.ptr(), 0);
-        r.ctx->RSSetState(r.Raster.Default.ptr());
-        r.SetBlendState(nullptr);
-    }
-
-    inline void MapRender::DrawMesh(BrushMesh* mesh)
+    inline void MapRender::DrawMesh(ViewRender& view, BrushMesh* mesh)
     {
         BrushPass pass = BrushPass(mesh);
 
         if (Chisel.selectMode == SelectMode::Faces)
             pass.id = 0;
 
-        if (wireframe)
+        if (mesh->IsDisplacement())
+            pass.lod = GetDispLOD(view, *mesh);
+
+        // Selection highlights don't change IDs
+        if (view.idPass)
+        {
+            DrawPass(view, pass);
+            return;
+        }
+
+        bool selected = mesh->brush && mesh->brush->IsSelected();
+        if (view.wireframe)
         {
             // Draw only wireframe outline
-            pass.color = mesh->brush->IsSelected() ? color_selection_outline : vec4(Colors.White);
+            pass.color = selected ? color_selection_outline : vec4(Colors.White);
             pass.texOverride = Textures.White.ptr();
-            DrawPass(pass);
+            DrawPass(view, pass);
         }
         else
         {
-            if (mesh->brush->IsSelected())
-            {
-                // Highlight face
-                pass.color = color_selection;
-                DrawPass(pass);
-
-                // Draw wireframe outline
-                DrawSelectionOutline(pass);
-            }
-            else
-            {
-                DrawPass(pass);
-            }
+            // Tinted and outlined by DrawSelectionOutline
+            pass.selected = selected;
+            DrawPass(view, pass);
         }
     }
 
-    void MapRender::DrawBrushEntity(BrushEntity& ent)
+    uint MapRender::GetDispLOD(const ViewRender& view, const BrushMesh& mesh) const
     {
-        static std::vector<BrushMesh*> opaqueMeshes;
-        static std::vector<BrushMesh*> transMeshes;
-        opaqueMeshes.clear();
-        transMeshes.clear();
+        float lodDistance = r_disp_lod_distance;
+        if (!r_disp_lod || lodDistance <= 0.0f || mesh.dispPower <= 0)
+            return 0;
+
+        // Distance to the closest point on the mesh bounds
+        vec3 closest = glm::clamp(view.cameraPos, mesh.bounds.min, mesh.bounds.max);
+        float dist = glm::distance(view.cameraPos, closest);
+        if (dist <= lodDistance)
+            return 0;
+
+        uint lod = uint(std::log2(dist / lodDistance)) + 1;
+        return std::min(lod, uint(mesh.dispPower));
+    }
 
-        for (Solid& brush : ent.Brushes())
-        {
-            for (auto& mesh : brush.GetMeshes())
-            {
-                assert(mesh.alloc);
+    inline void MapRender::QueueMesh(ViewRender& view, BrushMesh& mesh)
+    {
+        assert(mesh.alloc);
 
-                if (mesh.material && mesh.material->translucent)
-                    transMeshes.push_back(&mesh);
-                else
-                    opaqueMeshes.push_back(&mesh);
-            }
-        }
+        if (view.cull && !view.culler->InFrustum(mesh.bounds))
+            return;
+
+        if (mesh.material && mesh.material->translucent)
+            view.transMeshes.push_back(&mesh);
+        else
+            view.opaqueMeshes.push_back(&mesh);
+    }
+
+    void MapRender::DrawQueuedMeshes(ViewRender& view)
+    {
+        render::RenderContext& r = *view.r;
+
+        if (view.cull)
+            view.culler->Finish();
 
         // Draw opaque meshes.
-        r.SetBlendState(wireframe ? render::BlendFuncs::Alpha : render::BlendFuncs::Normal);
+        r.SetBlendState(view.wireframe ? render::BlendFuncs::Alpha : render::BlendFuncs::Normal);
         r.ctx->OMSetDepthStencilState(r.Depth.Default.ptr(), 0);
-        for (auto* mesh : opaqueMeshes)
-            DrawMesh(mesh);
+        for (auto* mesh : view.opaqueMeshes)
+        {
+            if (!view.cull || !view.culler->Occluded(mesh->bounds))
+                DrawMesh(view, mesh);
+        }
 
         // Draw trans meshes.
         r.SetBlendState(render::BlendFuncs::Alpha);
         r.ctx->OMSetDepthStencilState(r.Depth.NoWrite.ptr(), 0);
-        for (auto* mesh : transMeshes)
-            DrawMesh(mesh);
+        for (auto* mesh : view.transMeshes)
+        {
+            if (!view.cull || !view.culler->Occluded(mesh->bounds))
+                DrawMesh(view, mesh);
+        }
         
         r.SetBlendState(render::BlendFuncs::Normal);
+
+        view.opaqueMeshes.clear();
+        view.transMeshes.clear();
     }
 
-    void MapRender::DrawHandles(mat4x4& view, mat4x4& proj)
+    void MapRender::DrawChunks(ViewRender& view)
     {
-        if (Selection.Empty())
-            return;
-
-        if (Chisel.selectMode == SelectMode::Faces)
+        for (auto& chunk : map.Chunks())
         {
-            for (auto& item : Selection)
-            {
-                if (Face* face = dynamic_cast<Face*>(item); face && face->solid)
-                {
-                    auto& meshes = face->solid->GetMeshes();
-                    if (meshes.size() > face->meshIdx)
-                    {
-                        auto& mesh = meshes[face->meshIdx];
-                        BrushPass pass = BrushPass(&mesh);
-                        pass.startIndex = face->startIndex;
-                        pass.indices = face->GetDispIndexCount();
-                        pass.id = face->GetSelectionID();
-
-                        // Highlight face
-                        r.ctx->RSSetState(r.Raster.DepthBiased.ptr());
-                        pass.color = color_selection;
-                        DrawPass(pass);
-
-                        // Draw selection outline
-                        DrawSelectionOutline(pass);
-                    }
-                }
-            }
+            if (view.cull && !view.culler->InFrustum(chunk->bounds))
+                continue;
+
+            for (BrushMesh& mesh : chunk->meshes)
+                QueueMesh(view, mesh);
         }
+
+        DrawQueuedMeshes(view);
     }
 
+    void MapRender::DrawBrushEntity(ViewRender& view, BrushEntity& ent)
+    {
+        // Picks must still hit whatever is under the cursor, so only the scene is culled
+        for (Solid& brush : ent.Brushes())
+        {
+            // Already drawn as part of its cell
+            if (view.chunks && brush.GetChunk())
+                continue;
+
+            for (auto& mesh : brush.GetMeshes())
+                QueueMesh(view, mesh);
+        }
+
+        DrawQueuedMeshes(view);
+    }
 }
\ No newline at end of file
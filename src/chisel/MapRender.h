@@ -5,6 +5,8 @@
 #include "chisel/Engine.h"
 #include "chisel/Selection.h"
 #include "chisel/Gizmos.h"
+#include "chisel/Occlusion.h"
+#include "chisel/SpriteBatch.h"
 
 #include "core/Primitives.h"
 #include "gui/Viewport.h"
@@ -13,11 +15,47 @@
 #include "math/Color.h"
 #include "chisel/FGD/FGD.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace chisel
 {
     struct Camera;
     struct BrushPass;
 
+    // Everything needed to record one viewport, captured on the main thread
+    // so it can be drawn from a worker while the editor state stays put.
+    struct ViewRender
+    {
+        render::RenderContext* r = nullptr; // Context recording this view
+        Viewport* viewport = nullptr;
+
+        Camera camera;
+        mat4x4 view = mat4x4(1.0f);
+        mat4x4 proj = mat4x4(1.0f);
+        vec3   cameraPos = vec3(0);
+        Viewport::DrawMode drawMode = Viewport::DrawMode::Shaded;
+
+        bool wireframe = false;
+        bool idPass = false;
+        bool cull = false;
+        bool chunks = false;
+        bool grid = false;
+        vec3 gridSize = vec3(64.0f);
+
+        std::unique_ptr<OcclusionCuller> culler; // None for the object ID view, which never culls
+        SpriteBatch sprites;
+        Gizmos::List gizmos;
+
+        std::vector<BrushMesh*> opaqueMeshes;
+        std::vector<BrushMesh*> transMeshes;
+
+        // Recorded on a deferred context, waiting to be executed
+        Com<ID3D11CommandList> commands;
+    };
+
     struct MapRender : public System
     {
     private:
@@ -29,6 +67,7 @@ namespace chisel
             render::Shader Brush;
             render::Shader BrushBlend;
             render::Shader BrushDebugID;
+            render::Shader SelectionOutline;
         } Shaders;
 
         struct DefaultTextures {
@@ -36,23 +75,75 @@ namespace chisel
             Rc<Texture> White;
         } Textures;
 
+        std::unique_ptr<DispIndexBuffer> dispIndices;
+
+        // Rasterizes the occluders of every view, gathered once per map revision
+        OcclusionWorker occlusion;
+
+        // Culling counters of the views drawn last frame, summed
+        OcclusionCuller::Stats cullStats;
+
         MapRender();
+        ~MapRender();
 
         void Start() final override;
+        void Update() final override;
+
+        // Called by Viewport::Render. Captures the view and the gizmos queued for it,
+        // which are drawn along with every other queued view once all systems have updated.
+        void QueueViewport(Viewport& viewport);
 
-        // Called by Viewport::Render
-        void DrawViewport(Viewport& viewport);
+        // The viewport is going away, drop it from the queue
+        void ForgetViewport(Viewport& viewport);
+
+        // Render object IDs into viewport.rt_ObjectID, clipped to region.
+        // Clobbers the viewport's depth buffer. Draws right away on the immediate context.
+        void DrawObjectID(Viewport& viewport, Rect region);
 
         void DrawPointEntity(const std::string& classname, bool preview, vec3 origin, vec3 angles = vec3(0), bool selected = false, SelectionID id = 0);
-        void DrawBrushEntity(BrushEntity& ent);
-        void DrawHandles(mat4x4& view, mat4x4& proj);
 
     protected:
-        inline void DrawPass(const BrushPass& pass);
-        inline void DrawSelectionOutline(BrushPass pass);
-        inline void DrawMesh(BrushMesh* mesh);
+        Texture* GetEntityIcon(const FGD::Class* cls) const;
 
-        bool wireframe = false;
-        Viewport::DrawMode drawMode = Viewport::DrawMode::Shaded;
+        void CaptureView(ViewRender& view, Viewport& viewport);
+        void RenderViews();
+        void RecordViews(render::RenderContext& r);
+        void RecordView(ViewRender& view, render::RenderContext& r);
+        void RecorderLoop(uint index, uint64 batch);
+
+        void DrawViewport(ViewRender& view);
+        void SetupView(ViewRender& view);
+        void DrawBrushes(ViewRender& view);
+        void DrawChunks(ViewRender& view);
+        void DrawBrushEntity(ViewRender& view, BrushEntity& ent);
+        void DrawPointEntities(ViewRender& view);
+
+        inline void QueueMesh(ViewRender& view, BrushMesh& mesh);
+        void DrawQueuedMeshes(ViewRender& view);
+
+        void DrawSelectionOutline(ViewRender& view);
+
+        inline void DrawPass(ViewRender& view, const BrushPass& pass);
+        inline void DrawMesh(ViewRender& view, BrushMesh* mesh);
+        uint GetDispLOD(const ViewRender& view, const BrushMesh& mesh) const;
+
+        // Objects selected or unselected since the last Update
+        std::vector<SelectionID> m_selectionChanges;
+
+        // Views queued this frame, in the order they were queued
+        std::vector<ViewRender*> m_views;
+
+        // Object ID queries draw straight away, apart from the queued views
+        std::unique_ptr<ViewRender> m_idView;
+
+        // Deferred contexts, one per recording thread. The main thread records on the first.
+        std::vector<std::unique_ptr<render::RenderContext>> m_contexts;
+        std::vector<std::thread> m_recorders;
+        std::mutex               m_mutex;
+        std::condition_variable  m_cv;
+        std::atomic<size_t>      m_nextView = 0;
+        uint64                   m_batch    = 0; // Bumped to wake the recorders
+        uint                     m_busy     = 0; // Recorders still working on the batch
+        bool                     m_quit     = false;
     };
 }
@@ -0,0 +1,442 @@
+#include "chisel/Occlusion.h"
+#include "chisel/Chisel.h"
+#include "chisel/MapRender.h"
+#include "chisel/map/Map.h"
+#include "chisel/map/Solid.h"
+#include "common/Profiler.h"
+#include "console/ConCommand.h"
+#include "console/Console.h"
+#include "console/ConVar.h"
+#include "core/Camera.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define OCCLUSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace chisel
+{
+    static ConVar<float> r_occlusion_min_area("r_occlusion_min_area", 128.0f * 128.0f, "Smallest face area (in units squared) used as an occluder");
+    static ConVar<int>   r_occlusion_max_triangles("r_occlusion_max_triangles", 16384, "Max occluder triangles rasterized per view, largest faces first");
+
+    // Clip space corners, shared by the frustum and occlusion tests
+    static void ProjectCorners(const mat4x4& viewProj, const AABB& bounds, vec4 (&clip)[8])
+    {
+        for (uint i = 0; i < 8; i++)
+        {
+            vec3 corner = vec3(
+                (i & 1) ? bounds.max.x : bounds.min.x,
+                (i & 2) ? bounds.max.y : bounds.min.y,
+                (i & 4) ? bounds.max.z : bounds.min.z);
+            clip[i] = viewProj * vec4(corner, 1.0f);
+        }
+    }
+
+    // NDC to depth buffer pixels. Y points down like the D3D viewport.
+    static vec2 ToPixels(vec4 clip)
+    {
+        vec2 ndc = vec2(clip) / clip.w;
+        return vec2(
+            (ndc.x * 0.5f + 0.5f) * float(OcclusionCuller::Width),
+            (0.5f - ndc.y * 0.5f) * float(OcclusionCuller::Height));
+    }
+
+    OcclusionCuller::OcclusionCuller()
+    {
+        uint32 width = Width, height = Height;
+        while (true)
+        {
+            m_levels.emplace_back(width * height, 1.0f);
+            if (width == 1 && height == 1)
+                break;
+            width  = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+
+    OcclusionCuller::~OcclusionCuller()
+    {
+        Finish();
+    }
+
+    void OcclusionCuller::Begin(const mat4x4& viewProj)
+    {
+        Finish();
+
+        m_viewProj = viewProj;
+        m_ready    = false;
+        m_stats    = Stats{};
+    }
+
+    void OcclusionCuller::Finish()
+    {
+        if (!m_worker)
+            return;
+
+        m_worker->Wait(*this);
+        m_worker = nullptr;
+        m_ready  = true;
+    }
+
+    void OcclusionCuller::Rasterize(const std::vector<vec3>& occluders)
+    {
+        PROFILE_ZONE("OcclusionCuller::Rasterize");
+        uint64 start = Profiler::Now();
+
+        m_stats.occluders = uint32(occluders.size() / 3);
+
+        std::fill(m_levels[0].begin(), m_levels[0].end(), 1.0f);
+        for (size_t i = 0; i + 2 < occluders.size(); i += 3)
+            RasterizeTriangle(occluders[i], occluders[i + 1], occluders[i + 2]);
+
+        BuildHierarchy();
+
+        m_stats.rasterMs = float(double(Profiler::Now() - start) / 1e6);
+    }
+
+    void OcclusionCuller::RasterizeTriangle(vec3 p0, vec3 p1, vec3 p2)
+    {
+        vec4 c0 = m_viewProj * vec4(p0, 1.0f);
+        vec4 c1 = m_viewProj * vec4(p1, 1.0f);
+        vec4 c2 = m_viewProj * vec4(p2, 1.0f);
+
+        // Skipping an occluder is always safe, so don't bother clipping to the near plane
+        if (c0.z < 0.0f || c1.z < 0.0f || c2.z < 0.0f)
+            return;
+
+        vec2 v0 = ToPixels(c0), v1 = ToPixels(c1), v2 = ToPixels(c2);
+        float z0 = c0.z / c0.w, z1 = c1.z / c1.w, z2 = c2.z / c2.w;
+
+        // Both windings occlude
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::abs(area) < 1e-6f)
+            return;
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            std::swap(z1, z2);
+            area = -area;
+        }
+
+        int minX = std::max(int(std::floor(std::min({ v0.x, v1.x, v2.x }))), 0);
+        int minY = std::max(int(std::floor(std::min({ v0.y, v1.y, v2.y }))), 0);
+        int maxX = std::min(int(std::ceil(std::max({ v0.x, v1.x, v2.x }))), int(Width) - 1);
+        int maxY = std::min(int(std::ceil(std::max({ v0.y, v1.y, v2.y }))), int(Height) - 1);
+        if (minX > maxX || minY > maxY)
+            return;
+
+        // Edge functions E(x, y) = A x + B y + C, inside where all three are >= 0
+        auto Edge = [](vec2 a, vec2 b) {
+            return vec3(-(b.y - a.y), b.x - a.x, (b.y - a.y) * a.x - (b.x - a.x) * a.y);
+        };
+        vec3 e0 = Edge(v1, v2);
+        vec3 e1 = Edge(v2, v0);
+        vec3 e2 = Edge(v0, v1);
+
+        // z / w is linear in screen space
+        vec3 zPlane = (z0 * e0 + z1 * e1 + z2 * e2) / area;
+
+        // Spans start on 4 pixel boundaries so rows can be processed 4 at a time
+        minX &= ~3;
+
+        float* depth = m_levels[0].data();
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py  = float(y) + 0.5f;
+            float* row = depth + y * Width;
+
+#if OCCLUSION_SSE2
+            const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+
+            for (int x = minX; x <= maxX; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), lane);
+
+                auto Eval = [&](vec3 e) {
+                    return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e.x), px), _mm_set1_ps(e.y * py + e.z));
+                };
+
+                __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(Eval(e0), zero), _mm_cmpge_ps(Eval(e1), zero)),
+                    _mm_cmpge_ps(Eval(e2), zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                __m128 z       = Eval(zPlane);
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_min_ps(current, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+            }
+#else
+            for (int x = minX; x <= maxX; x++)
+            {
+                vec3 p = vec3(float(x) + 0.5f, py, 1.0f);
+                if (glm::dot(e0, p) < 0.0f || glm::dot(e1, p) < 0.0f || glm::dot(e2, p) < 0.0f)
+                    continue;
+
+                row[x] = std::min(row[x], glm::dot(zPlane, p));
+            }
+#endif
+        }
+    }
+
+    void OcclusionCuller::BuildHierarchy()
+    {
+        uint32 srcWidth = Width, srcHeight = Height;
+        for (size_t level = 1; level < m_levels.size(); level++)
+        {
+            uint32 width  = std::max(srcWidth / 2, 1u);
+            uint32 height = std::max(srcHeight / 2, 1u);
+            const float* src = m_levels[level - 1].data();
+            float*       dst = m_levels[level].data();
+
+            for (uint32 y = 0; y < height; y++)
+            {
+                for (uint32 x = 0; x < width; x++)
+                {
+                    // Odd sizes fold their last row and column into the texel before
+                    uint32 x0 = x * 2, x1 = std::min(x * 2 + 1, srcWidth - 1);
+                    uint32 y0 = y * 2, y1 = std::min(y * 2 + 1, srcHeight - 1);
+                    if (x == width - 1)
+                        x1 = srcWidth - 1;
+                    if (y == height - 1)
+                        y1 = srcHeight - 1;
+
+                    float farthest = 0.0f;
+                    for (uint32 sy = y0; sy <= y1; sy++)
+                    {
+                        for (uint32 sx = x0; sx <= x1; sx++)
+                            farthest = std::max(farthest, src[sy * srcWidth + sx]);
+                    }
+                    dst[y * width + x] = farthest;
+                }
+            }
+
+            srcWidth  = width;
+            srcHeight = height;
+        }
+    }
+
+    OcclusionWorker::OcclusionWorker()
+    {
+        m_thread = std::thread([this] { WorkerLoop(); });
+    }
+
+    OcclusionWorker::~OcclusionWorker()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_quit = true;
+        }
+        m_cv.notify_all();
+        m_thread.join();
+    }
+
+    void OcclusionWorker::Queue(OcclusionCuller& culler, Map& map)
+    {
+        assert(!culler.m_worker);
+
+        culler.m_worker = this;
+        {
+            std::lock_guard lock(m_mutex);
+            culler.m_queued = true;
+            m_jobs.push_back(Job { &culler, &map });
+        }
+        m_cv.notify_all();
+    }
+
+    void OcclusionWorker::Wait(OcclusionCuller& culler)
+    {
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [&] { return !culler.m_queued; });
+    }
+
+    void OcclusionWorker::WorkerLoop()
+    {
+#if CHISEL_PROFILE
+        Profiler::SetThreadName("Occlusion");
+#endif
+
+        std::unique_lock lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this] { return !m_jobs.empty() || m_quit; });
+            if (m_quit)
+                return;
+
+            Job job = m_jobs.front();
+            m_jobs.pop_front();
+
+            // The map and the culler are left alone until the culler's Finish
+            lock.unlock();
+            if (job.map != m_map || job.map->Revision() != m_revision)
+            {
+                // Only the solids that changed since the last gather are collected again
+                m_occluders = &job.map->Occluders().Gather(r_occlusion_min_area, size_t(std::max(int(r_occlusion_max_triangles), 0)));
+                m_map       = job.map;
+                m_revision  = job.map->Revision();
+            }
+            job.culler->Rasterize(*m_occluders);
+            lock.lock();
+
+            job.culler->m_queued = false;
+            m_cv.notify_all();
+        }
+    }
+
+    bool OcclusionCuller::InFrustum(const AABB& bounds)
+    {
+        vec4 clip[8];
+        ProjectCorners(m_viewProj, bounds, clip);
+
+        // Outside if every corner is past the same plane
+        uint outside = 0x3F;
+        for (const vec4& c : clip)
+        {
+            uint mask = 0;
+            mask |= (c.x < -c.w) << 0;
+            mask |= (c.x >  c.w) << 1;
+            mask |= (c.y < -c.w) << 2;
+            mask |= (c.y >  c.w) << 3;
+            mask |= (c.z <  0.0f) << 4;
+            mask |= (c.z >  c.w) << 5;
+            outside &= mask;
+        }
+
+        m_stats.tested++;
+        if (outside)
+        {
+            m_stats.frustumCulled++;
+            return false;
+        }
+        return true;
+    }
+
+    bool OcclusionCuller::Occluded(const AABB& bounds)
+    {
+        if (!m_ready)
+            return false;
+
+        vec4 clip[8];
+        ProjectCorners(m_viewProj, bounds, clip);
+
+        vec2  min     = vec2(FLT_MAX);
+        vec2  max     = vec2(-FLT_MAX);
+        float nearest = 1.0f;
+        for (const vec4& c : clip)
+        {
+            // Reaches the camera, can't be hidden
+            if (c.z <= 0.0f)
+                return false;
+
+            vec2 pixel = ToPixels(c);
+            min     = glm::min(min, pixel);
+            max     = glm::max(max, pixel);
+            nearest = std::min(nearest, c.z / c.w);
+        }
+
+        int x0 = std::max(int(std::floor(min.x)), 0);
+        int y0 = std::max(int(std::floor(min.y)), 0);
+        int x1 = std::min(int(std::ceil(max.x)), int(Width) - 1);
+        int y1 = std::min(int(std::ceil(max.y)), int(Height) - 1);
+        if (x0 > x1 || y0 > y1)
+            return false;
+
+        // Coarsest level where the rect still covers a handful of texels
+        uint32 level = 0;
+        while (level + 1 < m_levels.size() && std::max(x1 - x0, y1 - y0) >> level > 4)
+            level++;
+
+        uint32 width  = std::max(Width >> level, 1u);
+        uint32 height = std::max(Height >> level, 1u);
+        const float* depth = m_levels[level].data();
+        for (uint32 y = std::min(uint32(y0) >> level, height - 1); y <= std::min(uint32(y1) >> level, height - 1); y++)
+        {
+            for (uint32 x = std::min(uint32(x0) >> level, width - 1); x <= std::min(uint32(x1) >> level, width - 1); x++)
+            {
+                if (depth[y * width + x] >= nearest)
+                    return false;
+            }
+        }
+
+        m_stats.occluded++;
+        return true;
+    }
+}
+
+namespace chisel::commands
+{
+    static ConCommand r_occlusion_stats("r_occlusion_stats", "Print culling counters of the viewports drawn last frame", []()
+    {
+        const OcclusionCuller::Stats& stats = Chisel.Renderer->cullStats;
+        Console.Log("{} meshes tested, {} outside the frustum, {} occluded", stats.tested, stats.frustumCulled, stats.occluded);
+        Console.Log("{} occluder triangles rasterized in {:.3f} ms", stats.occluders, stats.rasterMs);
+    });
+
+    // Draw counts with and without occlusion culling, from every point entity looking four ways
+    static ConCommand r_occlusion_bench("r_occlusion_bench", "Compare brush mesh draw counts with and without occlusion culling on the loaded map", []()
+    {
+        Map& map = Chisel.map;
+
+        std::vector<vec3> origins;
+        for (PointEntity& point : map.PointEntities())
+            origins.push_back(point.origin);
+        if (origins.empty())
+            return Console.Error("r_occlusion_bench: the map has no point entities to look from");
+
+        std::vector<const AABB*> meshes;
+        for (Solid& solid : map.Brushes())
+        {
+            for (BrushMesh& mesh : solid.GetMeshes())
+                meshes.push_back(&mesh.bounds);
+        }
+
+        OcclusionWorker& worker = Chisel.Renderer->occlusion;
+        OcclusionCuller culler;
+        Camera camera;
+
+        uint64 views = 0, total = 0, frustum = 0, visible = 0;
+        double rasterMs = 0.0, testMs = 0.0;
+        uint32 occluders = 0;
+
+        for (vec3 origin : origins)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                camera.position = origin;
+                camera.angles   = vec3(0.0f, math::radians(90.0f * i), 0.0f);
+
+                culler.Begin(camera.ProjMatrix() * camera.ViewMatrix());
+                worker.Queue(culler, map);
+                culler.Finish();
+
+                uint64 start = Profiler::Now();
+                for (const AABB* bounds : meshes)
+                {
+                    if (!culler.InFrustum(*bounds))
+                        continue;
+                    frustum++;
+                    if (!culler.Occluded(*bounds))
+                        visible++;
+                }
+                testMs += double(Profiler::Now() - start) / 1e6;
+
+                views++;
+                total     += meshes.size();
+                rasterMs  += culler.GetStats().rasterMs;
+                occluders  = culler.GetStats().occluders;
+            }
+        }
+
+        Console.Log("Occlusion bench: {} views, {} world meshes, {} occluder triangles", views, meshes.size(), occluders);
+        Console.Log("  draws/view, no culling:     {:.1f}", double(total) / views);
+        Console.Log("  draws/view, frustum:        {:.1f}", double(frustum) / views);
+        Console.Log("  draws/view, frustum+occl.:  {:.1f} ({:.0f}% fewer)", double(visible) / views,
+            frustum ? 100.0 * double(frustum - visible) / double(frustum) : 0.0);
+        Console.Log("  raster {:.3f} ms/view, tests {:.3f} ms/view", rasterMs / views, testMs / views);
+    });
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "common/Common.h"
+#include "math/AABB.h"
+#include "math/Math.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chisel
+{
+    class Map;
+    class OcclusionWorker;
+
+    // Software occlusion culling for brush meshes.
+    // Large opaque world faces are rasterized by an OcclusionWorker into a small CPU depth buffer,
+    // which is reduced to a max-depth hierarchy that mesh bounds are tested against.
+    struct OcclusionCuller
+    {
+        static constexpr uint32 Width  = 256;
+        static constexpr uint32 Height = 144;
+
+        struct Stats
+        {
+            uint32 occluders     = 0; // Triangles rasterized
+            uint32 tested        = 0;
+            uint32 frustumCulled = 0;
+            uint32 occluded      = 0;
+            float  rasterMs      = 0.0f;
+        };
+
+        OcclusionCuller();
+        ~OcclusionCuller();
+
+        // Set the view for InFrustum. Occluded() answers false until the view is
+        // rasterized by OcclusionWorker::Queue and picked up with Finish().
+        void Begin(const mat4x4& viewProj);
+
+        // Wait for the worker rasterizing this view, if any
+        void Finish();
+
+        // Frustum test against the viewProj of the last Begin. Cheap, usable while rasterizing.
+        bool InFrustum(const AABB& bounds);
+
+        // True if bounds are entirely behind the occluders
+        bool Occluded(const AABB& bounds);
+
+        // Counters since the last Begin
+        const Stats& GetStats() const { return m_stats; }
+
+    private:
+        friend class OcclusionWorker;
+
+        void Rasterize(const std::vector<vec3>& occluders);
+        void RasterizeTriangle(vec3 v0, vec3 v1, vec3 v2);
+        void BuildHierarchy();
+
+        mat4x4              m_viewProj = mat4x4(1.0f);
+        bool                m_ready    = false;
+        Stats               m_stats;
+
+        // Nearest occluder depth per pixel, then each level keeps the farthest of 2x2 below it
+        std::vector<std::vector<float>> m_levels;
+
+        OcclusionWorker*    m_worker = nullptr; // Rasterizing this view since Queue, until Finish
+        bool                m_queued = false;   // Guarded by the worker's mutex
+    };
+
+    // One thread rasterizing every view's occluders.
+    // The map's occluders are gathered once per revision and shared by all the views queued on it.
+    class OcclusionWorker
+    {
+    public:
+        OcclusionWorker();
+        ~OcclusionWorker();
+
+        // Rasterize the map's occluders for the view culler was last begun with.
+        // The map must hold still until the culler's Finish.
+        void Queue(OcclusionCuller& culler, Map& map);
+
+        // Wait until culler is no longer queued or rasterizing
+        void Wait(OcclusionCuller& culler);
+
+    private:
+        void WorkerLoop();
+
+        struct Job
+        {
+            OcclusionCuller* culler;
+            Map*             map;
+        };
+
+        // Triangle list in world space, of m_map at m_revision. Only touched by the worker.
+        const std::vector<vec3>* m_occluders = nullptr;
+        Map*                     m_map       = nullptr;
+        uint64                   m_revision  = ~0ull;
+
+        std::deque<Job>         m_jobs;
+        std::thread             m_thread;
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+        bool                    m_quit = false;
+    };
+}
@@ -0,0 +1,309 @@
+#include "chisel/Picking.h"
+#include "chisel/Engine.h"
+#include "console/Console.h"
+#include "common/Profiler.h"
+
+#include <algorithm>
+
+namespace chisel
+{
+    // Matches Query in objectid.compute and uniqueid.compute
+    struct GPUPickQuery
+    {
+        uint2    min;
+        uint2    size;
+        uint32_t offset;
+        uint32_t capacity;
+        uint32_t padding[2];
+    };
+
+    void Picking::Init(render::RenderContext& rctx)
+    {
+        r = &rctx;
+        m_shader       = render::ComputeShader(r->device.ptr(), "objectid");
+        m_uniqueShader = render::ComputeShader(r->device.ptr(), "uniqueid");
+
+        D3D11_BUFFER_DESC queryDesc
+        {
+            .ByteWidth           = MaxQueries * sizeof(GPUPickQuery),
+            .Usage               = D3D11_USAGE_DYNAMIC,
+            .BindFlags           = D3D11_BIND_SHADER_RESOURCE,
+            .CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE,
+            .MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+            .StructureByteStride = sizeof(GPUPickQuery),
+        };
+        if (FAILED(r->device->CreateBuffer(&queryDesc, nullptr, &m_queryBuffer)))
+            Console.Error("[D3D11] Failed to create pick query buffer");
+        else if (FAILED(r->device->CreateShaderResourceView(m_queryBuffer.ptr(), nullptr, &m_querySRV)))
+            Console.Error("[D3D11] Failed to create pick query buffer view");
+
+        D3D11_BUFFER_DESC outputDesc
+        {
+            .ByteWidth = MaxTexels * sizeof(SelectionID),
+            .Usage     = D3D11_USAGE_DEFAULT,
+            .BindFlags = D3D11_BIND_UNORDERED_ACCESS,
+        };
+        D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc
+        {
+            .Format        = DXGI_FORMAT_R32_UINT,
+            .ViewDimension = D3D11_UAV_DIMENSION_BUFFER,
+            .Buffer        = { .FirstElement = 0, .NumElements = MaxTexels },
+        };
+        if (FAILED(r->device->CreateBuffer(&outputDesc, nullptr, &m_output)))
+            Console.Error("[D3D11] Failed to create pick output buffer");
+        else if (FAILED(r->device->CreateUnorderedAccessView(m_output.ptr(), &uavDesc, &m_outputUAV)))
+            Console.Error("[D3D11] Failed to create pick output buffer view");
+
+        D3D11_BUFFER_DESC bitsetDesc
+        {
+            .ByteWidth = BitsetIDs / 8,
+            .Usage     = D3D11_USAGE_DEFAULT,
+            .BindFlags = D3D11_BIND_UNORDERED_ACCESS,
+        };
+        D3D11_UNORDERED_ACCESS_VIEW_DESC bitsetUAVDesc
+        {
+            .Format        = DXGI_FORMAT_R32_UINT,
+            .ViewDimension = D3D11_UAV_DIMENSION_BUFFER,
+            .Buffer        = { .FirstElement = 0, .NumElements = BitsetIDs / 32 },
+        };
+        if (FAILED(r->device->CreateBuffer(&bitsetDesc, nullptr, &m_bitset)))
+            Console.Error("[D3D11] Failed to create pick bitset buffer");
+        else if (FAILED(r->device->CreateUnorderedAccessView(m_bitset.ptr(), &bitsetUAVDesc, &m_bitsetUAV)))
+            Console.Error("[D3D11] Failed to create pick bitset buffer view");
+
+        D3D11_BUFFER_DESC stagingDesc
+        {
+            .ByteWidth      = MaxTexels * sizeof(SelectionID),
+            .Usage          = D3D11_USAGE_STAGING,
+            .CPUAccessFlags = D3D11_CPU_ACCESS_READ,
+        };
+        D3D11_QUERY_DESC fenceDesc = { .Query = D3D11_QUERY_EVENT };
+        for (Slot& slot : m_slots)
+        {
+            if (FAILED(r->device->CreateBuffer(&stagingDesc, nullptr, &slot.staging)))
+                Console.Error("[D3D11] Failed to create pick staging buffer");
+            if (FAILED(r->device->CreateQuery(&fenceDesc, &slot.fence)))
+                Console.Error("[D3D11] Failed to create pick fence");
+        }
+
+        Engine.OnEndFrame += [this](render::RenderContext&) { EndFrame(); };
+    }
+
+    void Picking::QueryPoint(const Rc<render::RenderTarget>& target, uint2 point, PointCallback callback)
+    {
+        QueryRect(target, point, uint2(1), [callback](std::span<const SelectionID> ids, uint2) {
+            callback(ids.empty() ? 0 : ids[0]);
+        });
+    }
+
+    void Picking::Clip(const Rc<render::RenderTarget>& target, uint2& min, uint2& size)
+    {
+        uint2 targetSize = uint2(target->GetSize());
+        min  = glm::min(min, targetSize);
+        size = glm::min(size, targetSize - min);
+    }
+
+    void Picking::QueryRect(const Rc<render::RenderTarget>& target, uint2 min, uint2 size, RectCallback callback)
+    {
+        Clip(target, min, size);
+
+        // Has to fit in a single frame's output
+        if (size.x * size.y > MaxTexels)
+        {
+            Console.Warn("Pick region {}x{} is too large, clipping it", size.x, size.y);
+            size.y = MaxTexels / std::max(size.x, 1u);
+        }
+
+        m_queries.push_back(Query { Query::Texels, target, min, size, 0, std::move(callback) });
+    }
+
+    void Picking::QueryUnique(const Rc<render::RenderTarget>& target, uint2 min, uint2 size, UniqueCallback callback)
+    {
+        // Output is bounded by MaxUniqueIDs, not by the region's size
+        Clip(target, min, size);
+
+        m_queries.push_back(Query { Query::Unique, target, min, size, 0, [callback](std::span<const SelectionID> ids, uint2) {
+            callback(ids);
+        }});
+    }
+
+    void Picking::EndFrame()
+    {
+        // Answer finished frames, oldest first
+        while (m_inFlight > 0)
+        {
+            Slot& oldest = m_slots[(m_next + RingSize - m_inFlight) % RingSize];
+            if (!Resolve(oldest))
+                break;
+            m_inFlight--;
+        }
+
+        if (!m_queries.empty() && m_inFlight < RingSize)
+        {
+            Dispatch(m_slots[m_next]);
+            m_next = (m_next + 1) % RingSize;
+            m_inFlight++;
+        }
+
+        // Targets are redrawn next frame, so queries can't wait for it.
+        // Callers hold back while CanDispatch is false, these are past a frame's limits.
+        if (!m_queries.empty())
+        {
+            Console.Warn("Dropping {} pick queries that didn't fit this frame", m_queries.size());
+            for (Query& query : m_queries)
+                query.callback({}, uint2(0));
+            m_queries.clear();
+        }
+
+        // Keep frames coming until every answer is delivered
+        if (Pending())
+            Engine.Wake(1);
+    }
+
+    void Picking::Dispatch(Slot& slot)
+    {
+        PROFILE_ZONE("Picking::Dispatch");
+        PROFILE_GPU_ZONE("Picking");
+
+        // Take what fits this frame, EndFrame answers the rest with nothing
+        size_t   count  = 0;
+        uint32_t texels = 0;
+        while (count < m_queries.size() && count < MaxQueries)
+        {
+            uint32_t size = m_queries[count].Footprint();
+            if (texels + size > MaxTexels)
+                break;
+            texels += size;
+            count++;
+        }
+
+        slot.queries.assign(std::make_move_iterator(m_queries.begin()), std::make_move_iterator(m_queries.begin() + count));
+        m_queries.erase(m_queries.begin(), m_queries.begin() + count);
+
+        // One dispatch per target for texel queries, one per query for unique ones
+        std::stable_sort(slot.queries.begin(), slot.queries.end(), [](const Query& a, const Query& b) {
+            if (a.kind != b.kind)
+                return a.kind < b.kind;
+            return a.target.ptr() < b.target.ptr();
+        });
+
+        // ID targets can't be read while bound
+        r->ctx->OMSetRenderTargets(0, nullptr, nullptr);
+
+        ID3D11UnorderedAccessView* uavs[] = { m_outputUAV.ptr(), m_bitsetUAV.ptr() };
+        r->ctx->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+
+        uint32_t offset = 0;
+        size_t   start  = 0;
+        while (start < slot.queries.size())
+        {
+            Query& first = slot.queries[start];
+            size_t end = start + 1;
+            if (first.kind == Query::Texels)
+            {
+                while (end < slot.queries.size() && slot.queries[end].kind == Query::Texels && slot.queries[end].target.ptr() == first.target.ptr())
+                    end++;
+            }
+
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            if (FAILED(r->ctx->Map(m_queryBuffer.ptr(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+                abort();
+
+            GPUPickQuery* gpu = (GPUPickQuery*)mapped.pData;
+            uint2 maxSize = uint2(0);
+            for (size_t i = start; i < end; i++)
+            {
+                Query& query = slot.queries[i];
+                query.offset = offset;
+                offset += query.Footprint();
+                maxSize = glm::max(maxSize, query.size);
+
+                gpu[i - start] = GPUPickQuery { query.min, query.size, query.offset, query.Footprint() - 1 };
+            }
+            r->ctx->Unmap(m_queryBuffer.ptr(), 0);
+
+            if (first.kind == Query::Unique)
+            {
+                // Every unique query starts from no IDs seen and a zero count
+                static const UINT zero[4] = {};
+                D3D11_BOX box = { first.offset * uint(sizeof(SelectionID)), 0, 0, (first.offset + 1) * uint(sizeof(SelectionID)), 1, 1 };
+                r->ctx->ClearUnorderedAccessViewUint(m_bitsetUAV.ptr(), zero);
+                r->ctx->UpdateSubresource(m_output.ptr(), 0, &box, zero, 0, 0);
+                r->ctx->CSSetShader(m_uniqueShader.cs.ptr(), nullptr, 0);
+            }
+            else
+            {
+                r->ctx->CSSetShader(m_shader.cs.ptr(), nullptr, 0);
+            }
+
+            ID3D11ShaderResourceView* srvs[] = { first.target->srvLinear.ptr(), m_querySRV.ptr() };
+            r->ctx->CSSetShaderResources(0, 2, srvs);
+
+            // 8x8 threads per group, one z slice per query
+            r->ctx->Dispatch((maxSize.x + 7) / 8, (maxSize.y + 7) / 8, uint(end - start));
+            start = end;
+        }
+
+        ID3D11ShaderResourceView*  nullSRVs[2] = {};
+        ID3D11UnorderedAccessView* nullUAVs[2] = {};
+        r->ctx->CSSetShaderResources(0, 2, nullSRVs);
+        r->ctx->CSSetUnorderedAccessViews(0, 2, nullUAVs, nullptr);
+
+        // Copy out just the part that was written and fence it
+        if (offset > 0)
+        {
+            D3D11_BOX box = { 0, 0, 0, offset * uint(sizeof(SelectionID)), 1, 1 };
+            r->ctx->CopySubresourceRegion(slot.staging.ptr(), 0, 0, 0, 0, m_output.ptr(), 0, &box);
+        }
+        r->ctx->End(slot.fence.ptr());
+    }
+
+    bool Picking::Resolve(Slot& slot)
+    {
+        if (r->ctx->GetData(slot.fence.ptr(), nullptr, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+            return false;
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        HRESULT hr = r->ctx->Map(slot.staging.ptr(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+            return false;
+
+        const SelectionID* ids = SUCCEEDED(hr) ? (const SelectionID*)mapped.pData : nullptr;
+        for (Query& query : slot.queries)
+        {
+            if (!ids)
+            {
+                query.callback({}, uint2(0));
+            }
+            else if (query.kind == Query::Texels)
+            {
+                query.callback(std::span(ids + query.offset, query.size.x * query.size.y), query.size);
+            }
+            else
+            {
+                // The count keeps going past capacity, those IDs were dropped
+                uint32_t capacity = query.Footprint() - 1;
+                uint32_t count    = ids[query.offset];
+                if (count > capacity)
+                {
+                    Console.Warn("Pick region has more than {} objects, ignoring the rest", capacity);
+                    count = capacity;
+                }
+
+                // Only IDs past the GPU bitset can repeat
+                const SelectionID* found = ids + query.offset + 1;
+                std::vector<SelectionID> unique(found, found + count);
+                std::sort(unique.begin(), unique.end());
+                unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+                query.callback(unique, query.size);
+            }
+        }
+
+        if (ids)
+            r->ctx->Unmap(slot.staging.ptr(), 0);
+
+        slot.queries.clear();
+        return true;
+    }
+}
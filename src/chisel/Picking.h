@@ -0,0 +1,97 @@
+#pragma once
+
+#include "render/Render.h"
+#include "chisel/Selection.h"
+#include "math/Math.h"
+
+#include <algorithm>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace chisel
+{
+    // Reads object IDs back from ID render targets without stalling the CPU.
+    // Queries made during a frame are answered by one objectid dispatch per target at the end of it,
+    // unique queries get a uniqueid dispatch each that compacts their region to a list of distinct IDs.
+    // Results go through a ring of staging buffers and reach their callbacks a frame or two later,
+    // once the GPU has passed the copy's fence. Targets are only read the frame they are queried,
+    // so check CanDispatch before drawing one for a query.
+    struct Picking
+    {
+        static constexpr uint32_t RingSize   = 3;           // Frames of queries in flight
+        static constexpr uint32_t MaxQueries = 256;         // Per frame
+        static constexpr uint32_t MaxTexels  = 1024 * 1024; // Per frame, across all queries
+        static constexpr uint32_t MaxUniqueIDs = 64 * 1024; // Per unique query
+        static constexpr uint32_t BitsetIDs  = 1024 * 1024; // IDs below this are deduplicated on the GPU
+
+        // IDs of every texel in the queried rect, row by row
+        using RectCallback  = std::function<void(std::span<const SelectionID> ids, uint2 size)>;
+        using PointCallback = std::function<void(SelectionID id)>;
+        // Every distinct non-zero ID in the queried rect, sorted
+        using UniqueCallback = std::function<void(std::span<const SelectionID> ids)>;
+
+        void Init(render::RenderContext& r);
+
+        // Coordinates are in target pixels and clamped to its size
+        void QueryPoint(const Rc<render::RenderTarget>& target, uint2 point, PointCallback callback);
+        void QueryRect(const Rc<render::RenderTarget>& target, uint2 min, uint2 size, RectCallback callback);
+        void QueryUnique(const Rc<render::RenderTarget>& target, uint2 min, uint2 size, UniqueCallback callback);
+
+        // Any query not answered yet
+        bool Pending() const { return !m_queries.empty() || m_inFlight > 0; }
+
+        // Queries made now are dispatched at the end of this frame. Otherwise every slot is still
+        // in flight and they would be answered with nothing.
+        bool CanDispatch() const { return m_inFlight < RingSize; }
+
+        // Dispatch this frame's queries and answer the ones that finished. Run at the end of every frame.
+        void EndFrame();
+
+    private:
+        struct Query
+        {
+            enum Kind { Texels, Unique };
+
+            Kind         kind;
+            Rc<render::RenderTarget> target;
+            uint2        min;
+            uint2        size;
+            uint32_t     offset = 0; // Into the output buffer, in texels
+            RectCallback callback;
+
+            // Output buffer space. Unique queries store their ID count first.
+            uint32_t Footprint() const
+            {
+                uint32_t texels = size.x * size.y;
+                return kind == Texels ? texels : 1 + std::min(texels, MaxUniqueIDs);
+            }
+        };
+
+        struct Slot
+        {
+            Com<ID3D11Buffer>  staging;
+            Com<ID3D11Query>   fence;
+            std::vector<Query> queries;
+        };
+
+        void Clip(const Rc<render::RenderTarget>& target, uint2& min, uint2& size);
+        void Dispatch(Slot& slot);
+        bool Resolve(Slot& slot);
+
+        render::RenderContext*         r = nullptr;
+        render::ComputeShader          m_shader;
+        render::ComputeShader          m_uniqueShader;
+        Com<ID3D11Buffer>              m_queryBuffer;
+        Com<ID3D11ShaderResourceView>  m_querySRV;
+        Com<ID3D11Buffer>              m_output;
+        Com<ID3D11UnorderedAccessView> m_outputUAV;
+        Com<ID3D11Buffer>              m_bitset; // IDs seen by the current unique query
+        Com<ID3D11UnorderedAccessView> m_bitsetUAV;
+
+        std::vector<Query> m_queries; // Waiting for the end of the frame
+        Slot               m_slots[RingSize];
+        uint32_t           m_next     = 0; // Slot the next dispatch goes into
+        uint32_t           m_inFlight = 0;
+    };
+}
@@ -0,0 +1,413 @@
+#include "common/Profiler.h"
+
+#if CHISEL_PROFILE
+
+#include "chisel/Engine.h"
+#include "common/Parse.h"
+#include "console/ConCommand.h"
+#include "console/Console.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+
+namespace chisel
+{
+//-------------------------------------------------------------------------------------------------
+// Threads
+
+    static std::mutex                        s_threadsMutex;
+    static std::vector<ProfileThreadBuffer*> s_threads;
+
+    /*static*/ ProfileThreadBuffer* Profiler::RegisterThread()
+    {
+        std::lock_guard lock(s_threadsMutex);
+
+        // The first thread to record anything is the main thread
+        auto* buffer  = new ProfileThreadBuffer();
+        buffer->index = uint32(s_threads.size());
+        buffer->name  = buffer->index == 0 ? "Main" : "Worker";
+
+        s_threads.push_back(buffer);
+        return buffer;
+    }
+
+    /*static*/ const char* Profiler::ThreadName(uint32 thread)
+    {
+        if (thread == GPUThread)
+            return "GPU";
+
+        std::lock_guard lock(s_threadsMutex);
+        return thread < s_threads.size() ? s_threads[thread]->name : "";
+    }
+
+//-------------------------------------------------------------------------------------------------
+// GPU
+
+    // D3D11 timestamp queries, bracketed per frame by a disjoint query.
+    // Frames are read back a few frames later without waiting on the GPU.
+    struct GPUProfiler
+    {
+        static constexpr uint32 RingSize = 4;
+
+        struct Zone
+        {
+            const char* name;
+            uint32      depth;
+            uint32      begin; // Timestamp indices
+            uint32      end;
+        };
+
+        struct Frame
+        {
+            uint64                        index    = 0;
+            uint64                        cpuStart = 0;
+            bool                          pending  = false;
+            Com<ID3D11Query>              disjoint;
+            std::vector<Com<ID3D11Query>> timestamps; // [0] is the start of the frame, reused every time around
+            uint32                        used = 0;
+            std::vector<Zone>             zones;
+        };
+
+        render::RenderContext* r = nullptr;
+        Frame  frames[RingSize];
+        uint32 next   = 0;
+        Frame* active = nullptr;
+        uint32 depth  = 0;
+
+        uint32 Timestamp()
+        {
+            Frame& frame = *active;
+            if (frame.used == frame.timestamps.size())
+            {
+                D3D11_QUERY_DESC desc = { .Query = D3D11_QUERY_TIMESTAMP };
+                Com<ID3D11Query> query;
+                if (FAILED(r->device->CreateQuery(&desc, &query)))
+                    return ~0u;
+                frame.timestamps.push_back(std::move(query));
+            }
+
+            r->ctx->End(frame.timestamps[frame.used].ptr());
+            return frame.used++;
+        }
+
+        void BeginFrame(uint64 index, uint64 cpuStart)
+        {
+            // Still waiting on the GPU for this slot, skip timing this frame
+            Frame& frame = frames[next];
+            if (!r || !frame.disjoint || frame.pending)
+                return;
+
+            frame.index    = index;
+            frame.cpuStart = cpuStart;
+            frame.used     = 0;
+            frame.zones.clear();
+
+            active = &frame;
+            depth  = 0;
+            r->ctx->Begin(frame.disjoint.ptr());
+            Timestamp();
+        }
+
+        void EndFrame()
+        {
+            if (!active)
+                return;
+
+            r->ctx->End(active->disjoint.ptr());
+            active->pending = true;
+            active = nullptr;
+            next = (next + 1) % RingSize;
+        }
+
+        uint32 BeginZone(const char* name)
+        {
+            if (!active)
+                return ~0u;
+
+            uint32 begin = Timestamp();
+            if (begin == ~0u)
+                return ~0u;
+
+            active->zones.push_back(Zone { name, depth++, begin, begin });
+            return uint32(active->zones.size() - 1);
+        }
+
+        void EndZone(uint32 zone)
+        {
+            if (!active || zone == ~0u)
+                return;
+
+            depth--;
+            uint32 end = Timestamp();
+            active->zones[zone].end = end == ~0u ? active->zones[zone].begin : end;
+        }
+
+        void Resolve()
+        {
+            // Oldest first
+            for (uint32 i = 0; i < RingSize; i++)
+            {
+                Frame& frame = frames[(next + i) % RingSize];
+                if (!frame.pending)
+                    continue;
+
+                D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+                if (r->ctx->GetData(frame.disjoint.ptr(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+                    break;
+
+                frame.pending = false;
+                if (disjoint.Disjoint || disjoint.Frequency == 0)
+                    continue;
+
+                std::vector<uint64> ticks(frame.used, 0);
+                for (uint32 t = 0; t < frame.used; t++)
+                    r->ctx->GetData(frame.timestamps[t].ptr(), &ticks[t], sizeof(uint64), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+
+                // GPU clocks aren't comparable with the CPU's, line the frame up with the start of its CPU frame
+                auto ToCPU = [&](uint32 t) {
+                    return frame.cpuStart + uint64(double(ticks[t] - ticks[0]) * 1e9 / double(disjoint.Frequency));
+                };
+
+                std::vector<ProfileEvent> events;
+                events.reserve(frame.zones.size());
+                for (const Zone& zone : frame.zones)
+                    events.push_back(ProfileEvent { zone.name, ToCPU(zone.begin), ToCPU(zone.end), Profiler::GPUThread, zone.depth });
+
+                Profiler.AddGPUEvents(frame.index, events);
+            }
+        }
+    };
+
+    static GPUProfiler s_gpu;
+
+    void Profiler::Init()
+    {
+        s_gpu.r = &Engine.rctx;
+
+        D3D11_QUERY_DESC desc = { .Query = D3D11_QUERY_TIMESTAMP_DISJOINT };
+        for (auto& frame : s_gpu.frames)
+        {
+            if (FAILED(s_gpu.r->device->CreateQuery(&desc, &frame.disjoint)))
+                Console.Error("[D3D11] Failed to create profiler disjoint query");
+        }
+    }
+
+    uint32 Profiler::BeginGPUZone(const char* name)
+    {
+        return s_gpu.BeginZone(name);
+    }
+
+    void Profiler::EndGPUZone(uint32 zone)
+    {
+        s_gpu.EndZone(zone);
+    }
+
+    void Profiler::AddGPUEvents(uint64 index, std::vector<ProfileEvent>& events)
+    {
+        auto Attach = [&](auto& frames)
+        {
+            for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+            {
+                if (it->index == index)
+                {
+                    it->gpu = events;
+                    return;
+                }
+            }
+        };
+
+        Attach(history);
+        Attach(capture);
+    }
+
+    double ProfileFrame::GPUMilliseconds() const
+    {
+        // Top level zones don't overlap
+        uint64 total = 0;
+        for (const ProfileEvent& event : gpu)
+        {
+            if (event.depth == 0)
+                total += event.end - event.start;
+        }
+        return double(total) / 1e6;
+    }
+
+//-------------------------------------------------------------------------------------------------
+// Frames
+
+    void Profiler::BeginFrame()
+    {
+        m_frameStart = Now();
+        s_gpu.BeginFrame(m_frameIndex, m_frameStart);
+    }
+
+    void Profiler::EndFrame()
+    {
+        s_gpu.EndFrame();
+
+        ProfileFrame frame;
+        frame.index = m_frameIndex++;
+        frame.start = m_frameStart;
+        frame.end   = Now();
+
+        // Collect everything finished since last frame
+        {
+            std::lock_guard lock(s_threadsMutex);
+            for (ProfileThreadBuffer* buffer : s_threads)
+            {
+                uint64 tail = buffer->tail.load(std::memory_order_relaxed);
+                uint64 head = buffer->head.load(std::memory_order_acquire);
+                for (; tail < head; tail++)
+                    frame.cpu.push_back(buffer->events[tail % ProfileThreadBuffer::Capacity]);
+                buffer->tail.store(tail, std::memory_order_release);
+
+                if (uint32 dropped = buffer->dropped.exchange(0, std::memory_order_relaxed))
+                    Console.Warn("[Profiler] Thread '{}' dropped {} zones", buffer->name, dropped);
+            }
+        }
+
+        if (m_captureRemaining > 0)
+        {
+            capture.push_back(frame);
+            if (--m_captureRemaining == 0)
+                Console.Log("[Profiler] Captured {} frames, write them out with prof_dump", capture.size());
+        }
+
+        if (!paused)
+        {
+            history.push_back(std::move(frame));
+            while (history.size() > HistorySize)
+                history.pop_front();
+        }
+
+        s_gpu.Resolve();
+    }
+
+    void Profiler::Capture(uint32 frames)
+    {
+        capture.clear();
+        capture.reserve(frames);
+        m_captureRemaining = frames;
+    }
+
+//-------------------------------------------------------------------------------------------------
+// Chrome trace
+
+    static void WriteJSONString(std::ofstream& out, const char* str)
+    {
+        out << '"';
+        for (; *str; str++)
+        {
+            if (*str == '"' || *str == '\\')
+                out << '\\';
+            out << *str;
+        }
+        out << '"';
+    }
+
+    bool Profiler::Dump(std::string_view path) const
+    {
+        std::ofstream out = std::ofstream(std::string(path));
+        if (!out.is_open())
+            return false;
+
+        auto WriteFrames = [&](const auto& frames)
+        {
+            if (frames.empty())
+                return;
+
+            uint64 origin = frames.front().start;
+            bool   first  = true;
+
+            auto WriteEvent = [&](const ProfileEvent& event, const char* category)
+            {
+                // Microseconds, relative to the first frame
+                out << (first ? "\n" : ",\n") << R"({"ph":"X","pid":1,"cat":")" << category << R"(","name":)";
+                WriteJSONString(out, event.name);
+                out << fmt::format(R"(,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                    event.thread == GPUThread ? -1 : int64(event.thread),
+                    double(event.start - std::min(event.start, origin)) / 1e3,
+                    double(event.end - std::min(event.end, event.start)) / 1e3);
+                first = false;
+            };
+
+            // Name every thread that shows up
+            std::vector<uint32> threads;
+            for (const ProfileFrame& frame : frames)
+            {
+                for (const ProfileEvent& event : frame.cpu)
+                    threads.push_back(event.thread);
+                if (!frame.gpu.empty())
+                    threads.push_back(GPUThread);
+            }
+            std::sort(threads.begin(), threads.end());
+            threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+
+            for (uint32 thread : threads)
+            {
+                out << (first ? "\n" : ",\n") << R"({"ph":"M","pid":1,"name":"thread_name","tid":)"
+                    << (thread == GPUThread ? -1 : int64(thread)) << R"(,"args":{"name":)";
+                WriteJSONString(out, ThreadName(thread));
+                out << "}}";
+                first = false;
+            }
+
+            for (const ProfileFrame& frame : frames)
+            {
+                WriteEvent(ProfileEvent { "Frame", frame.start, frame.end, 0, 0 }, "frame");
+                for (const ProfileEvent& event : frame.cpu)
+                    WriteEvent(event, "cpu");
+                for (const ProfileEvent& event : frame.gpu)
+                    WriteEvent(event, "gpu");
+            }
+        };
+
+        out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+        if (!capture.empty())
+            WriteFrames(capture);
+        else
+            WriteFrames(history);
+        out << "\n]}\n";
+
+        return out.good();
+    }
+}
+
+namespace chisel::commands
+{
+    static ConCommand prof_capture("prof_capture", "Record the next N frames (default 120) for prof_dump", [](ConCmd& cmd)
+    {
+        uint32 frames = 120;
+        if (cmd.argc > 0)
+        {
+            const char* arg = cmd.argv[0].data();
+            auto result = stream::Parse<uint32>(arg, cmd.argv[0].size());
+            if (!result.IsSuccess() || *result == 0)
+                return Console.Error("Usage: prof_capture [frames]");
+            frames = *result;
+        }
+
+        Profiler.Capture(frames);
+
+        // Don't sleep through the capture
+        Engine.Wake(frames);
+        Console.Log("[Profiler] Capturing {} frames...", frames);
+    });
+
+    static ConCommand prof_dump("prof_dump", "Write the last capture (or the frame history) as Chrome trace JSON", [](ConCmd& cmd)
+    {
+        if (cmd.argc != 1)
+            return Console.Error("Usage: prof_dump <file>");
+
+        if (Profiler.Capturing())
+            Console.Warn("[Profiler] Capture still in progress, writing the frames recorded so far");
+
+        if (!Profiler.Dump(cmd.argv[0]))
+            return Console.Error("Failed to write profile to '{}'", cmd.argv[0]);
+
+        Console.Log("[Profiler] Wrote '{}'. Open it in chrome://tracing or ui.perfetto.dev", cmd.argv[0]);
+    });
+}
+
+#endif
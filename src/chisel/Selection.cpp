@@ -1,41 +1,131 @@
 #include "chisel/Selection.h"
+#include "chisel/Chisel.h"
+
+#include <algorithm>
 
 namespace chisel
 {
-    SelectionID Selectable::s_nextID = 1;
+    static SelectionID MakeID(uint32_t index, uint32_t generation)
+    {
+        return (generation << Selectable::IndexBits) | index;
+    }
 
 //-------------------------------------------------------------------------------------------------
 
-    inline SelectionID Selectable::NextID()
+    /*static*/ void Selectable::Allocate(uint32_t count, SelectionID* ids)
+    {
+        std::lock_guard lock(s_mutex);
+
+        // Released slots go first, one at a time, the rest come off the end
+        uint32_t reused = uint32_t(std::min<size_t>(count, s_free.size()));
+        for (uint32_t i = 0; i < reused; i++)
+        {
+            uint32_t index = s_free.back();
+            s_free.pop_back();
+            ids[i] = MakeID(index, GetSlot(index).generation);
+        }
+        ids   += reused;
+        count -= reused;
+        if (count == 0)
+            return;
+
+        uint32_t first = s_count;
+        if (first + count > IndexMask)
+        {
+            Console.Error("Out of selection IDs ({} in use)", first);
+            std::fill(ids, ids + count, 0);
+            return;
+        }
+
+        for (uint32_t page = first / PageSize; page <= (first + count - 1) / PageSize; page++)
+        {
+            if (!s_pages[page])
+                s_pages[page] = std::make_unique<Slot[]>(PageSize);
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+            ids[i] = MakeID(first + i, 0);
+        s_count = first + count;
+    }
+
+    /*static*/ void Selectable::Bind(SelectionID id, Selectable* object)
+    {
+        if (id != 0)
+            GetSlot(id & IndexMask).object = object;
+    }
+
+    /*static*/ void Selectable::ReserveIDs(uint32_t count, std::vector<SelectionID>& ids)
+    {
+        size_t offset = ids.size();
+        ids.resize(offset + count);
+        if (count)
+            Allocate(count, ids.data() + offset);
+    }
+
+    /*static*/ void Selectable::ReleaseID(SelectionID id)
     {
-        if (s_freeIDs.empty())
-            return s_nextID++;
-        
-        SelectionID id = s_freeIDs.top();
-        s_freeIDs.pop();
-        return id;
+        if (id == 0)
+            return;
+
+        std::lock_guard lock(s_mutex);
+
+        uint32_t index = id & IndexMask;
+        Slot& slot = GetSlot(index);
+        slot.object     = nullptr;
+        slot.generation = (slot.generation + 1) & GenerationMask;
+        s_free.push_back(index);
     }
 
     Selectable::Selectable()
-        : m_id(NextID())
     {
-        s_map.emplace(m_id, this);
+        Allocate(1, &m_id);
+        Bind(m_id, this);
+    }
+
+    Selectable::Selectable(SelectionID reserved)
+        : m_id(reserved)
+        , m_ownsID(false)
+    {
+        Bind(m_id, this);
+    }
+
+    Selectable::Selectable(const Selectable& other)
+        : Selectable()
+    {
+        m_kind = other.m_kind;
+    }
+
+    Selectable::Selectable(Selectable&& other)
+        : m_id(other.m_id)
+        , m_ownsID(other.m_ownsID)
+        , m_kind(other.m_kind)
+    {
+        // Selection still points at other, which unselects itself when it goes
+        Bind(m_id, this);
+        other.m_id = 0;
     }
 
     Selectable::~Selectable()
     {
-        s_freeIDs.push(m_id);
         Selection.Unselect(this);
-        s_map.erase(m_id);
+
+        if (m_ownsID)
+            ReleaseID(m_id);
+        else if (m_id != 0 && Find(m_id) == this)
+            Bind(m_id, nullptr);
     }
 
     /*static*/ Selectable* Selectable::Find(SelectionID id)
     {
-        auto iter = s_map.find(id);
-        if (iter == s_map.end())
+        uint32_t index = id & IndexMask;
+        if (index == 0 || index >= s_count.load(std::memory_order_relaxed))
+            return nullptr;
+
+        const Slot& slot = GetSlot(index);
+        if (MakeID(index, slot.generation) != id)
             return nullptr;
 
-        return iter->second;
+        return slot.object;
     }
 
 //-------------------------------------------------------------------------------------------------
@@ -49,17 +139,50 @@ namespace chisel
         return m_selection.empty();
     }
 
-    void Selection::Select(Selectable* ent)
+    static Selectable* Resolve(Selectable* ent)
     {
-        if (ent->IsSelected())
-            return;
-
         Selectable* resolved;
         while ((resolved = ent->ResolveSelectable()) != ent)
             ent = resolved;
+        return ent;
+    }
+
+    void Selection::Add(Selectable* ent)
+    {
+        if (m_selection.empty())
+            m_primary = ent;
 
         ent->SetSelected(true);
-        m_selection.emplace_back(ent);
+        ent->m_selectionOrder = m_order++;
+        ent->m_selectionIndex = uint32_t(m_selection.size());
+        m_selection.push_back(ent);
+        m_changed.push_back(ent->GetSelectionID());
+    }
+
+    void Selection::RemoveAt(uint32_t index)
+    {
+        m_selection[index]->SetSelected(false);
+        m_changed.push_back(m_selection[index]->GetSelectionID());
+        if (m_selection[index] == m_primary)
+            m_primary = nullptr;
+
+        Selectable* last = m_selection.back();
+        m_selection[index] = last;
+        last->m_selectionIndex = index;
+        m_selection.pop_back();
+    }
+
+    void Selection::Select(Selectable* ent)
+    {
+        if (ent->IsSelected())
+            return;
+
+        ent = Resolve(ent);
+        if (ent->Selectable::IsSelected())
+            return;
+
+        Add(ent);
+        m_generation++;
     }
 
     void Selection::Unselect(Selectable* ent)
@@ -67,13 +190,12 @@ namespace chisel
         if (!ent->IsSelected())
             return;
 
-        Selectable* resolved;
-        while ((resolved = ent->ResolveSelectable()) != ent)
-            ent = resolved;
+        ent = Resolve(ent);
+        if (!ent->Selectable::IsSelected())
+            return;
 
-        ent->SetSelected(false);
-        if (m_selection.size() > 0)
-            std::erase(m_selection, ent);
+        RemoveAt(ent->m_selectionIndex);
+        m_generation++;
     }
 
     void Selection::Toggle(Selectable* ent)
@@ -87,8 +209,63 @@ namespace chisel
     void Selection::Clear()
     {
         for (const auto& selected : m_selection)
+        {
             selected->SetSelected(false);
+            m_changed.push_back(selected->GetSelectionID());
+        }
         m_selection.clear();
+        m_primary = nullptr;
+        m_generation++;
+    }
+
+    void Selection::SelectMany(std::span<Selectable* const> ents)
+    {
+        m_selection.reserve(m_selection.size() + ents.size());
+        for (Selectable* ent : ents)
+        {
+            if (ent->IsSelected())
+                continue;
+
+            ent = Resolve(ent);
+            if (!ent->Selectable::IsSelected())
+                Add(ent);
+        }
+        m_generation++;
+    }
+
+    void Selection::UnselectMany(std::span<Selectable* const> ents)
+    {
+        for (Selectable* ent : ents)
+        {
+            if (!ent->IsSelected())
+                continue;
+
+            ent = Resolve(ent);
+            if (ent->Selectable::IsSelected())
+                RemoveAt(ent->m_selectionIndex);
+        }
+        m_generation++;
+    }
+
+    void Selection::ToggleMany(std::span<Selectable* const> ents)
+    {
+        // Several objects can resolve to the same one, which must only flip once
+        std::vector<Selectable*> resolved;
+        resolved.reserve(ents.size());
+        for (Selectable* ent : ents)
+            resolved.push_back(Resolve(ent));
+
+        std::sort(resolved.begin(), resolved.end());
+        resolved.erase(std::unique(resolved.begin(), resolved.end()), resolved.end());
+
+        for (Selectable* ent : resolved)
+        {
+            if (ent->Selectable::IsSelected())
+                RemoveAt(ent->m_selectionIndex);
+            else
+                Add(ent);
+        }
+        m_generation++;
     }
 
     Selectable* Selection::Find(SelectionID id)
@@ -96,10 +273,31 @@ namespace chisel
         return Selectable::Find(id);
     }
 
+    Selectable* Selection::Primary() const
+    {
+        if (!m_primary && !m_selection.empty())
+        {
+            m_primary = *std::min_element(m_selection.begin(), m_selection.end(), [](const Selectable* a, const Selectable* b)
+            {
+                return a->m_selectionOrder < b->m_selectionOrder;
+            });
+        }
+        return m_primary;
+    }
+
+    void Selection::TakeChanges(std::vector<SelectionID>& changed)
+    {
+        changed.clear();
+        std::swap(changed, m_changed);
+    }
+
 //-------------------------------------------------------------------------------------------------
 
     std::optional<AABB> Selection::GetBounds() const
     {
+        if (m_boundsGeneration == m_generation && m_boundsRevision == m_revision)
+            return m_bounds;
+
         std::optional<AABB> bounds;
         for (Selectable* selectable : m_selection)
         {
@@ -111,36 +309,109 @@ namespace chisel
                 ? AABB::Extend(*bounds, *selectedBounds)
                 : *selectedBounds;
         }
-        
+
+        m_bounds           = bounds;
+        m_boundsGeneration = m_generation;
+        m_boundsRevision   = m_revision;
         return bounds;
     }
 
+    void Selection::Transform(const mat4x4& matrix)
+    {
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin("Transform");
+
+        // Solids, on their own or in selected brush entities, move as one batch
+        std::vector<Solid*> solids;
+        for (auto* s : m_selection)
+        {
+            if (Solid* solid = s->As<Solid>())
+                solids.push_back(solid);
+            else if (BrushEntity* ent = s->As<BrushEntity>())
+            {
+                for (Solid& solid : ent->Brushes())
+                    solids.push_back(&solid);
+            }
+            else
+                s->Transform(matrix);
+        }
+
+        // A solid can be in the batch twice when its entity is selected too
+        std::sort(solids.begin(), solids.end());
+        solids.erase(std::unique(solids.begin(), solids.end()), solids.end());
+        Solid::TransformMany(solids, matrix);
+
+        actions.Commit();
+    }
+
     void Selection::Delete()
     {
-        for (Selectable* s : m_selection)
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin("Delete");
+
+        // Deleted objects unselect themselves, so don't walk the list they remove themselves from
+        std::vector<Selectable*> deleting = std::move(m_selection);
+        m_selection.clear();
+        m_primary = nullptr;
+        for (Selectable* s : deleting)
         {
-            s->Delete();
+            s->SetSelected(false);
+            m_changed.push_back(s->GetSelectionID());
         }
-        Clear();
+
+        for (Selectable* s : deleting)
+            s->Delete();
+        m_generation++;
+
+        actions.Commit();
+    }
+
+    void Selection::AlignToGrid(vec3 gridSize)
+    {
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin("Align to Grid");
+        for (auto* s : m_selection)
+            s->AlignToGrid(gridSize);
+        actions.Commit();
     }
 
     bool Selection::Duplicate()
     {
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin("Duplicate");
+
+        // Clones upload as they are made, map the brush heap once for all of them
+        BrushGPUAllocator& a = *Chisel.brushAllocator;
+        a.open();
+
         bool containsUnduplicatables = false;
 
-        for (Selectable*& s : m_selection)
+        // Clones take the place of their originals in the selection, in the order those were selected
+        std::vector<Selectable*> originals = m_selection;
+        std::sort(originals.begin(), originals.end(), [](const Selectable* a, const Selectable* b)
         {
-            Selectable *duplicated = s->Duplicate();
-            if (duplicated)
+            return a->m_selectionOrder < b->m_selectionOrder;
+        });
+
+        for (Selectable* s : originals)
+        {
+            Selectable* duplicated = s->Duplicate();
+            if (!duplicated)
             {
-                s->SetSelected(false);
-                duplicated->SetSelected(true);
-                s = duplicated;
-            }
-            else
                 containsUnduplicatables = true;
+                continue;
+            }
+
+            bool primary = s == m_primary;
+            RemoveAt(s->m_selectionIndex);
+            Add(duplicated);
+            if (primary)
+                m_primary = duplicated;
         }
+        m_generation++;
 
+        a.close();
+        actions.Commit();
         return containsUnduplicatables;
     }
 
@@ -5,21 +5,65 @@
 
 #include "math/AABB.h"
 #include "math/Math.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <optional>
-#include <unordered_map>
-#include <stack>
+#include <span>
+#include <vector>
 
 namespace chisel
 {
+    // Index into the selectable slot table in the low bits, the slot's generation in the high bits.
+    // A stale ID, say from a pick that was in flight while its object got deleted, resolves to nothing
+    // instead of to whatever reused the slot. 0 is never a valid ID.
     using SelectionID = uint32_t;
 
+    // Concrete type of a Selectable, set once by its constructor
+    enum class SelectableKind : uint8_t
+    {
+        Unknown,
+        Solid,
+        Face,
+        PointEntity,
+        BrushEntity,
+    };
+
     class Selectable
     {
     public:
+        static constexpr uint32_t IndexBits = 24;
+        static constexpr uint32_t IndexMask = (1u << IndexBits) - 1;
+
+        // Generations stop short of the top bit, which is free for flags stored next to an ID
+        static constexpr uint32_t GenerationMask = ~0u >> (IndexBits + 1);
+
         Selectable();
+
+        // Use an ID from ReserveIDs, or one an owner keeps across rebuilding this object.
+        // The ID stays reserved after this object is gone, until it is released.
+        explicit Selectable(SelectionID reserved);
+
+        Selectable(const Selectable& other); // Copies are new objects with their own ID
+        Selectable(Selectable&& other);      // Moves take the ID along
+        Selectable& operator=(const Selectable&) { return *this; }
         virtual ~Selectable();
 
+        // Reserve count IDs and append them to ids. Released IDs are reused first, so they need not be consecutive.
+        // Safe from any thread, so importers can hand out IDs to objects they build in parallel.
+        static void ReserveIDs(uint32_t count, std::vector<SelectionID>& ids);
+
+        // Give back a reserved ID. Objects still using it can't be found by it anymore.
+        static void ReleaseID(SelectionID id);
+
         SelectionID GetSelectionID() const { return m_id; }
+        SelectableKind GetKind() const { return m_kind; }
+
+        // Checked downcast through the kind tag, for hot paths where dynamic_cast adds up.
+        // T provides static bool IsKind(SelectableKind).
+        template <typename T> T* As() { return T::IsKind(m_kind) ? static_cast<T*>(this) : nullptr; }
+        template <typename T> const T* As() const { return T::IsKind(m_kind) ? static_cast<const T*>(this) : nullptr; }
+
         virtual bool IsSelected() const { return m_selected; }
 
         virtual std::optional<AABB> GetBounds() const = 0;
@@ -32,16 +76,35 @@ namespace chisel
         friend class Selection;
 
         void SetSelected(bool selected) { m_selected = selected; }
+        void SetKind(SelectableKind kind) { m_kind = kind; }
         static Selectable* Find(SelectionID id);
     private:
-        static SelectionID s_nextID;
-        static inline std::unordered_map<SelectionID, Selectable*> s_map;
-        static inline std::stack<SelectionID> s_freeIDs;
+        struct Slot
+        {
+            Selectable* object     = nullptr;
+            uint32_t    generation = 0;
+        };
 
-        static inline SelectionID NextID();
+        // Slots live in fixed pages that never move, so claiming a reserved slot
+        // needs no lock even while another thread grows the table.
+        static constexpr uint32_t PageSize = 4096;
+        static constexpr uint32_t MaxPages = (IndexMask + 1) / PageSize;
+
+        static inline std::unique_ptr<Slot[]> s_pages[MaxPages];
+        static inline std::atomic<uint32_t>   s_count = 1; // Slots handed out so far, 0 stays unused
+        static inline std::vector<uint32_t>   s_free;
+        static inline std::mutex              s_mutex;
+
+        static Slot& GetSlot(uint32_t index) { return s_pages[index / PageSize][index % PageSize]; }
+        static void Allocate(uint32_t count, SelectionID* ids);
+        static void Bind(SelectionID id, Selectable* object);
 
         SelectionID m_id = 0;
+        bool m_ownsID = true;
         bool m_selected = false;
+        SelectableKind m_kind = SelectableKind::Unknown;
+        uint32_t m_selectionIndex = 0; // Position in Selection while selected
+        uint64_t m_selectionOrder = 0; // When it was selected, oldest first
     };
 
     extern class Selection
@@ -55,22 +118,59 @@ namespace chisel
         void Unselect(Selectable* ent);
         void Toggle(Selectable* ent);
         void Clear();
+
+        // Batched versions for marquee selection and large edits. Constant time per object.
+        void SelectMany(std::span<Selectable* const> ents);
+        void UnselectMany(std::span<Selectable* const> ents);
+        void ToggleMany(std::span<Selectable* const> ents);
         Selectable* Find(SelectionID id);
 
+        // Bumped whenever the set of selected objects changes
+        uint Generation() const { return m_generation; }
+
+        // Move out the IDs of every object selected or unselected since the last call.
+        // Unordered and may repeat. Objects that are gone since no longer resolve.
+        void TakeChanges(std::vector<SelectionID>& changed);
+
+        // Something may have moved or changed shape, so the cached bounds are stale.
+        // Map::Touch calls this on every edit.
+        void Touch() { m_revision++; }
+
         Selectable** begin() { return m_selection.size() > 0 ? &m_selection.front() : nullptr; }
         Selectable** end()   { return m_selection.size() > 0 ? &m_selection.back() + 1 : nullptr; }
         Selectable* operator [](size_t index) { return m_selection[index]; }
 
+        // The earliest selected object still in the selection, null if empty.
+        // Indexing follows no order, this is what inspects and acts for the selection.
+        Selectable* Primary() const;
+
     public:
     // Selectable Interface //
 
+        // Each edit is one undo step
         std::optional<AABB> GetBounds() const;
-        void Transform(const mat4x4& matrix) { for (auto* s : m_selection) s->Transform(matrix); }
+        void Transform(const mat4x4& matrix);
         void Delete();
-        void AlignToGrid(vec3 gridSize) { for (auto* s : m_selection) s->AlignToGrid(gridSize); }
+        void AlignToGrid(vec3 gridSize);
         bool Duplicate();
 
     private:
+        void Add(Selectable* ent);
+        void RemoveAt(uint32_t index);
+
+        // Dense, in no particular order. Each object knows its index, so removal swaps in the last one.
         std::vector<Selectable*> m_selection;
+        uint64_t m_order = 0;
+
+        // Found again by the next Primary call after it is unselected
+        mutable Selectable* m_primary = nullptr;
+        std::vector<SelectionID> m_changed;
+        uint m_generation = 0;
+        uint64_t m_revision = 0;
+
+        // GetBounds result, valid while neither the generation nor the revision moved
+        mutable std::optional<AABB> m_bounds;
+        mutable uint     m_boundsGeneration = ~0u;
+        mutable uint64_t m_boundsRevision   = ~0ull;
     } Selection;
 }
\ No newline at end of file
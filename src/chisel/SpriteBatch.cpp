@@ -0,0 +1,97 @@
+#include "chisel/SpriteBatch.h"
+#include "core/Primitives.h"
+#include "console/Console.h"
+#include "common/Hash.h"
+
+#include <algorithm>
+
+namespace chisel
+{
+    void SpriteBatch::Init(render::RenderContext& r)
+    {
+        m_shader = render::Shader(r.device.ptr(), SpriteInstance::Layout, "sprite_instanced");
+    }
+
+    void SpriteBatch::Add(Texture* texture, vec3 origin, float size, vec4 color, SelectionID id)
+    {
+        m_sprites.push_back(Sprite { texture, SpriteInstance { origin, size, color, id } });
+    }
+
+    uint64 SpriteBatch::Hash(uint64 seed) const
+    {
+        for (const Sprite& sprite : m_sprites)
+        {
+            seed = HashValue(sprite.texture, seed);
+            seed = HashValue(sprite.instance, seed);
+        }
+        return seed;
+    }
+
+    void SpriteBatch::Draw(render::RenderContext& r)
+    {
+        if (m_sprites.empty())
+            return;
+
+        // Group by texture
+        std::sort(m_sprites.begin(), m_sprites.end(), [](const Sprite& a, const Sprite& b) {
+            return a.texture < b.texture;
+        });
+
+        m_upload.clear();
+        m_upload.reserve(m_sprites.size());
+        for (const Sprite& sprite : m_sprites)
+            m_upload.push_back(sprite.instance);
+
+        // Grow instance buffer
+        if (m_upload.size() > m_capacity)
+        {
+            m_capacity = std::max<uint32_t>(1024, uint32_t(m_upload.size()) * 2);
+            D3D11_BUFFER_DESC desc
+            {
+                .ByteWidth      = uint32_t(m_capacity * sizeof(SpriteInstance)),
+                .Usage          = D3D11_USAGE_DYNAMIC,
+                .BindFlags      = D3D11_BIND_VERTEX_BUFFER,
+                .CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
+            };
+            m_instances = nullptr;
+            if (FAILED(r.device->CreateBuffer(&desc, nullptr, &m_instances)))
+            {
+                Console.Error("[D3D11] Failed to create sprite instance buffer");
+                m_capacity = 0;
+                m_sprites.clear();
+                return;
+            }
+        }
+
+        r.UpdateDynamicBuffer(m_instances.ptr(), m_upload.data(), m_upload.size() * sizeof(SpriteInstance));
+
+        r.SetShader(m_shader);
+
+        ID3D11Buffer* buffers[] = { Primitives.Quad.ptr(), m_instances.ptr() };
+        uint strides[] = { sizeof(Primitives::Vertex), sizeof(SpriteInstance) };
+        uint offsets[] = { 0, 0 };
+        r.ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        r.ctx->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+
+        // One instanced draw per texture
+        uint32_t start = 0;
+        while (start < m_sprites.size())
+        {
+            Texture* texture = m_sprites[start].texture;
+            uint32_t end = start + 1;
+            while (end < m_sprites.size() && m_sprites[end].texture == texture)
+                end++;
+
+            r.ctx->PSSetShaderResources(0, 1, &texture->srvSRGB);
+            r.ctx->DrawInstanced(6, end - start, 0, start);
+            start = end;
+        }
+
+        // Don't leave the instance buffer bound
+        ID3D11Buffer* nullBuffer = nullptr;
+        uint zero = 0;
+        r.ctx->IASetVertexBuffers(1, 1, &nullBuffer, &zero, &zero);
+
+        m_sprites.clear();
+    }
+}
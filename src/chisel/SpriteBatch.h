@@ -0,0 +1,67 @@
+#pragma once
+
+#include "render/Render.h"
+#include "math/Math.h"
+#include "chisel/Selection.h"
+
+#include <vector>
+
+namespace chisel
+{
+    // Per-instance data for sprite_instanced.hlsl
+    struct SpriteInstance
+    {
+        vec3        origin;
+        float       size;
+        vec4        color;
+        SelectionID id;
+
+        static constexpr D3D11_INPUT_ELEMENT_DESC Layout[] =
+        {
+            // Slot 0: Primitives.Quad
+            { "POSITION",     0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,                            D3D11_INPUT_PER_VERTEX_DATA,   0 },
+            { "TEXCOORD",     0, DXGI_FORMAT_R32G32_FLOAT,       0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA,   0 },
+            // Slot 1: SpriteInstance
+            { "TEXCOORD",     1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,                            D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "COLOR",        0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "BLENDINDICES", 0, DXGI_FORMAT_R32_UINT,           1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+        };
+    };
+
+    // Collects camera-facing sprites and draws them instanced, one draw per texture.
+    struct SpriteBatch
+    {
+        void Init(render::RenderContext& r);
+
+        void Add(Texture* texture, vec3 origin, float size, vec4 color, SelectionID id = 0);
+
+        // Draw and clear everything added so far.
+        // Expects blend, depth and sampler states to be set by the caller.
+        void Draw(render::RenderContext& r);
+
+        // Drop everything added so far without drawing it.
+        void Clear() { m_sprites.clear(); }
+
+        // Trade sprites with other. GPU resources stay with their batch.
+        void Swap(SpriteBatch& other) { std::swap(m_sprites, other.m_sprites); }
+
+        // Hash of everything added so far, chained onto seed.
+        uint64 Hash(uint64 seed) const;
+
+        size_t Size() const { return m_sprites.size(); }
+
+    private:
+        struct Sprite
+        {
+            Texture*       texture;
+            SpriteInstance instance;
+        };
+
+        std::vector<Sprite>         m_sprites;
+        std::vector<SpriteInstance> m_upload;
+
+        render::Shader    m_shader;
+        Com<ID3D11Buffer> m_instances;
+        uint32_t          m_capacity = 0;
+    };
+}
@@ -3,6 +3,7 @@
 #include "../map/Solid.h"
 #include "../map/Map.h"
 #include "../Chisel.h"
+#include "common/Profiler.h"
 
 #include "zstd.h"
 
@@ -109,21 +110,20 @@ namespace chisel
     {
         yyjson_val* solids = yyjson_obj_get(entity_val, "solids");
         bool point = solids == nullptr;
+        const char* classname = GetStringSafe(entity_val, "classname");
         Entity* entity = nullptr;
         if (point)
         {
-            PointEntity* point = new PointEntity(&map);
-            entity = point;
+            entity = map.AddPointEntity(classname);
         }
         else
         {
-            BrushEntity* brush = new BrushEntity(&map);
+            BrushEntity* brush = map.AddBrushEntity(classname);
             AddSolid(*brush, entity_val);
             entity = brush;
         }
 
-        entity->classname = GetStringSafe(entity_val, "classname");
-        entity->targetname = GetStringSafe(entity_val, "targetname");
+        entity->SetTargetname(GetStringSafe(entity_val, "targetname"));
         entity->origin = YYJsonToVector3(yyjson_obj_get(entity_val, "origin"));
 
         yyjson_val* properties_val = yyjson_obj_get(entity_val, "properties");
@@ -173,12 +173,12 @@ namespace chisel
                 }
             }
         }
-
-        map.AddEntity(entity);
     }
 
     bool ImportBox(std::string_view filepath, Map& map)
     {
+        PROFILE_ZONE("ImportBox");
+
         auto file = fs::readFile(filepath);
         if (!file)
             return false;
@@ -304,19 +304,19 @@ namespace chisel
     static void WriteEntityKVPairs(yyjson_mut_doc* doc, yyjson_mut_val* val, const Entity& entity)
     {
         // Write classname
-        if (entity.classname.empty())
+        if (entity.GetClassname().empty())
         {
             yyjson_mut_obj_add_str(doc, val, "classname", "worldspawn");  // TODO: worldspawn doesn't have a classname! should asset on no classname
         }
         else
         {
-            yyjson_mut_obj_add_str(doc, val, "classname", entity.classname.c_str());
+            yyjson_mut_obj_add_str(doc, val, "classname", entity.GetClassname().c_str());
         }
 
         // Write targetname
-        if (!entity.targetname.empty())
+        if (!entity.GetTargetname().empty())
         {
-            yyjson_mut_obj_add_str(doc, val, "targetname", entity.targetname.c_str());
+            yyjson_mut_obj_add_str(doc, val, "targetname", entity.GetTargetname().c_str());
         }
 
         // Write the origin
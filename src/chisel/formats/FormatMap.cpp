@@ -12,13 +12,13 @@ namespace chisel
     static void WriteEntityKVPairs(std::ofstream& out, const Entity& entity)
     {
         // Write classname
-        if (entity.classname.empty())
+        if (entity.GetClassname().empty())
         {
             WriteKVPair(out, "classname", "worldspawn"); // TODO: worldspawn doesn't have a classname! should asset on no classname
         }
         else
         {
-            WriteKVPair(out, "classname", entity.classname);
+            WriteKVPair(out, "classname", entity.GetClassname());
         }
 
         // Write the origin
@@ -27,9 +27,9 @@ namespace chisel
         WriteKVPair(out, "origin", originString);
 
         // Write targetname
-        if (!entity.targetname.empty())
+        if (!entity.GetTargetname().empty())
         {
-            WriteKVPair(out, "targetname", entity.targetname);
+            WriteKVPair(out, "targetname", entity.GetTargetname());
         }
 
         // Write all keyvalues
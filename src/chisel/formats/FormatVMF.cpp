@@ -1,4 +1,5 @@
 #include "../Chisel.h"
+#include "common/Profiler.h"
 
 namespace chisel
 {
@@ -23,22 +24,22 @@ namespace chisel
     static void WriteEntityKVPairs(std::ofstream& out, const Entity& entity)
     {
         // Write classname
-        if (entity.classname.empty())
+        if (entity.GetClassname().empty())
         {
             WriteKVPair(out, "classname", "worldspawn"); // TODO: worldspawn doesn't have a classname! should asset on no classname
         }
         else
         {
-            WriteKVPair(out, "classname", entity.classname);
+            WriteKVPair(out, "classname", entity.GetClassname());
         }
 
         // Write the origin
         WriteKVPair(out, "origin", "%g %g %g", entity.origin.x, entity.origin.y, entity.origin.z);
 
         // Write targetname
-        if (!entity.targetname.empty())
+        if (!entity.GetTargetname().empty())
         {
-            WriteKVPair(out, "targetname", entity.targetname);
+            WriteKVPair(out, "targetname", entity.GetTargetname());
         }
 
         // Write all keyvalues
@@ -262,7 +263,28 @@ namespace chisel
     }
 
 
-    static bool AddSolid(BrushEntity& map, kv::KeyValues& kvWorld, std::string& matNameScratch)
+    // Maps repeat a few hundred material names over thousands of sides.
+    // Intern each name once and resolve it to its asset once.
+    struct MaterialCache
+    {
+        std::unordered_map<InternedString, Rc<Material>> loaded;
+        std::string path;
+
+        Rc<Material> Get(std::string_view name)
+        {
+            auto [it, inserted] = loaded.try_emplace(InternedString(name));
+            if (inserted)
+            {
+                path = "materials/";
+                path += name;
+                path += ".vmt";
+                it->second = Assets.Load<Material>(path);
+            }
+            return it->second;
+        }
+    };
+
+    static bool AddSolid(BrushEntity& map, kv::KeyValues& kvWorld, MaterialCache& materials)
     {
         std::vector<Side> sideData;
 
@@ -286,11 +308,7 @@ namespace chisel
 
                 Side thisSide{};
                 thisSide.plane = ParsePlane(kvSide["plane"]);
-                matNameScratch = "materials/";
-                matNameScratch += (std::string_view)kvSide["material"];
-                matNameScratch += ".vmt";
-
-                thisSide.material = Assets.Load<Material>(matNameScratch);
+                thisSide.material = materials.Get((std::string_view)kvSide["material"]);
                 ParseAxis(kvSide["uaxis"], thisSide.textureAxes[0], thisSide.scale[0]);
                 ParseAxis(kvSide["vaxis"], thisSide.textureAxes[1], thisSide.scale[1]);
                 thisSide.rotate = kvSide["rotate"];
@@ -342,27 +360,26 @@ namespace chisel
         return true;
     }
 
-    static bool AddEntity(Map& map, kv::KeyValues& kvEntity, std::string& matNameScratch)
+    static bool AddEntity(Map& map, kv::KeyValues& kvEntity, MaterialCache& materials)
     {
         auto solids = kvEntity.FindAll("solid");
         // Solid can also be the vphysics solid type.
         // Really annoying.
         bool point = solids.first == solids.second || solids.first->second.GetType() != kv::Types::KeyValues;
+        InternedString classname = (std::string_view)kvEntity["classname"];
         Entity* entity = nullptr;
         if (point)
         {
-            PointEntity* point = new PointEntity(&map);
-            entity = point;
+            entity = map.AddPointEntity(classname);
         }
         else
         {
-            BrushEntity* brush = new BrushEntity(&map);
-            AddSolid(*brush, kvEntity, matNameScratch);
+            BrushEntity* brush = map.AddBrushEntity(classname);
+            AddSolid(*brush, kvEntity, materials);
             entity = brush;
         }
 
-        entity->classname = (std::string_view)kvEntity["classname"];
-        entity->targetname = (std::string_view)kvEntity["targetname"];
+        entity->SetTargetname((std::string_view)kvEntity["targetname"]);
         entity->origin = kvEntity["origin"];
         kvEntity.RemoveAll("origin");
         kvEntity.RemoveAll("classname");
@@ -371,12 +388,13 @@ namespace chisel
         kvEntity.RemoveAllWithType("editor", kv::Types::KeyValues);
         kvEntity.RemoveAllWithType("solid", kv::Types::KeyValues);
         entity->kv = std::move(kvEntity);
-        map.AddEntity(entity);
         return true;
     }
 
     bool ImportVMF(std::string_view filepath, Map& map)
     {
+        PROFILE_ZONE("ImportVMF");
+
         auto text = fs::readTextFile(filepath);
         if (!text)
             return false;
@@ -392,10 +410,10 @@ namespace chisel
         // Add solids.
         Chisel.brushAllocator->open();
         {
-            std::string matname;
+            MaterialCache materials;
             kv::KeyValues& kvWorld = (kv::KeyValues&)world;
             // TODO: Do we want to parse the other "worldspawn" KVs?
-            if (!AddSolid(map, kvWorld, matname))
+            if (!AddSolid(map, kvWorld, materials))
             {
                 Chisel.brushAllocator->close();
                 return false;
@@ -409,7 +427,7 @@ namespace chisel
                     return false;
 
                 kv::KeyValues& kvEntity = (kv::KeyValues&)entity;
-                if (!AddEntity(map, kvEntity, matname))
+                if (!AddEntity(map, kvEntity, materials))
                 {
                     Chisel.brushAllocator->close();
                     return false;
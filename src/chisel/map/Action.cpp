@@ -0,0 +1,703 @@
+#include "chisel/map/Action.h"
+#include "chisel/map/Map.h"
+#include "chisel/Chisel.h"
+#include "common/Profiler.h"
+#include "console/ConVar.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace chisel
+{
+    static ConVar<int> undo_budget_mb("undo_budget_mb", 256, "Memory the undo history may use in MB, the oldest steps are dropped past it");
+
+    Atom::~Atom()
+    {
+        if (m_actionID)
+            Chisel.map.Actions().Forget(*this);
+    }
+
+//-------------------------------------------------------------------------------------------------
+
+    static bool SameDisp(const DispInfo& a, const DispInfo& b)
+    {
+        // DispVert is all floats, no padding to compare
+        return a.power == b.power
+            && a.startPos == b.startPos
+            && a.elevation == b.elevation
+            && a.subdiv == b.subdiv
+            && a.flags == b.flags
+            && a.verts.size() == b.verts.size()
+            && memcmp(a.verts.data(), b.verts.data(), a.verts.size() * sizeof(DispVert)) == 0;
+    }
+
+    static bool SameSide(const Side& a, const Side& b)
+    {
+        if (a.disp.has_value() != b.disp.has_value())
+            return false;
+
+        return a.plane.normal == b.plane.normal
+            && a.plane.offset == b.plane.offset
+            && a.material.ptr() == b.material.ptr()
+            && a.textureAxes == b.textureAxes
+            && a.scale == b.scale
+            && a.rotate == b.rotate
+            && a.lightmapScale == b.lightmapScale
+            && a.smoothing == b.smoothing
+            && (!a.disp || SameDisp(*a.disp, *b.disp));
+    }
+
+    static bool SameValue(const kv::KeyValuesVariant& a, const kv::KeyValuesVariant& b);
+
+    static bool SameKeyValues(const kv::KeyValues& a, const kv::KeyValues& b)
+    {
+        if (a.ChildCount() != b.ChildCount())
+            return false;
+
+        for (const auto& [key, value] : a)
+        {
+            // Children sharing a key come in no particular order
+            auto [first, last] = const_cast<kv::KeyValues&>(b).FindAll(key);
+            if (std::none_of(first, last, [&](const auto& child) { return SameValue(value, child.second); }))
+                return false;
+        }
+        return true;
+    }
+
+    static bool SameValue(const kv::KeyValuesVariant& a, const kv::KeyValuesVariant& b)
+    {
+        if (a.GetType() != b.GetType())
+            return false;
+
+        switch (a.GetType())
+        {
+            case kv::Types::Int:       return a.Get<int64_t>() == b.Get<int64_t>();
+            case kv::Types::Float:     return a.Get<double>() == b.Get<double>();
+            case kv::Types::Ptr:       return static_cast<void*>(a) == static_cast<void*>(b);
+            case kv::Types::Vector2:   return a.Get<vec2>() == b.Get<vec2>();
+            case kv::Types::Vector3:   return a.Get<vec3>() == b.Get<vec3>();
+            case kv::Types::Vector4:   return a.Get<vec4>() == b.Get<vec4>();
+            case kv::Types::KeyValues: return SameKeyValues(a.Get<kv::KeyValues&>(), b.Get<kv::KeyValues&>());
+            default:                   return a.Get<std::string_view>() == b.Get<std::string_view>();
+        }
+    }
+
+    static bool SameValues(const std::vector<kv::KeyValuesVariant>& a, const std::vector<kv::KeyValuesVariant>& b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (!SameValue(a[i], b[i]))
+                return false;
+        }
+        return true;
+    }
+
+    static std::vector<kv::KeyValuesVariant> GetValues(kv::KeyValues& keys, InternedString key)
+    {
+        std::vector<kv::KeyValuesVariant> values;
+        auto [first, last] = keys.FindAll(key);
+        for (auto it = first; it != last; ++it)
+            values.push_back(std::as_const(it->second));
+        return values;
+    }
+
+    static void SetValues(kv::KeyValues& keys, InternedString key, const std::vector<kv::KeyValuesVariant>& values)
+    {
+        keys.RemoveAll(key);
+        for (const kv::KeyValuesVariant& value : values)
+            keys.CreateTypedChild(key, value);
+    }
+
+    static size_t SideBytes(const std::vector<Side>& sides)
+    {
+        size_t bytes = sides.capacity() * sizeof(Side);
+        for (const Side& side : sides)
+        {
+            if (side.disp)
+                bytes += side.disp->verts.capacity() * sizeof(DispVert);
+        }
+        return bytes;
+    }
+
+    static size_t ValueBytes(const kv::KeyValuesVariant& value);
+
+    static size_t KeyValuesBytes(const kv::KeyValues& keys)
+    {
+        size_t bytes = 0;
+        for (const auto& [key, value] : keys)
+            bytes += sizeof(InternedString) + ValueBytes(value);
+        return bytes;
+    }
+
+    static size_t ValueBytes(const kv::KeyValuesVariant& value)
+    {
+        if (value.GetType() == kv::Types::KeyValues)
+            return sizeof(value) + KeyValuesBytes(value.Get<kv::KeyValues&>());
+        if (value.GetType() == kv::Types::String)
+            return sizeof(value) + value.Get<std::string_view>().size();
+        return sizeof(value);
+    }
+
+    // Records that turned out to change nothing
+    static bool Unchanged(const Action::Record& record)
+    {
+        if (auto* delta = std::get_if<Action::SideDelta>(&record))
+            return delta->sides[Action::Before].empty() && delta->sides[Action::After].empty();
+
+        if (auto* delta = std::get_if<Action::EntityDelta>(&record))
+        {
+            return delta->origin[Action::Before] == delta->origin[Action::After]
+                && delta->classname[Action::Before] == delta->classname[Action::After]
+                && delta->targetname[Action::Before] == delta->targetname[Action::After]
+                && delta->keys.empty();
+        }
+
+        return false;
+    }
+
+//-------------------------------------------------------------------------------------------------
+
+    void ActionList::Begin(const char* name, uint64_t coalesce)
+    {
+        if (m_depth++ > 0)
+            return;
+
+        // Continuing the newest step takes it back up as the open transaction
+        if (coalesce && !m_sealed && m_cursor > 0 && m_cursor == m_actions.size())
+        {
+            Action& newest = m_actions.back();
+            if (newest.coalesce == coalesce && strcmp(newest.name, name) == 0)
+            {
+                m_bytes -= newest.bytes;
+                m_open = std::move(newest);
+                m_actions.pop_back();
+                m_cursor--;
+                Reopen(m_open);
+                return;
+            }
+        }
+
+        m_open = Action{ .name = name, .coalesce = coalesce };
+    }
+
+    void ActionList::Commit()
+    {
+        assert(m_depth > 0);
+        if (m_depth == 0 || --m_depth > 0)
+            return;
+
+        PROFILE_ZONE("ActionList::Commit");
+
+        for (auto& [id, index] : m_pending)
+            Finish(m_open.records[index]);
+        m_pending.clear();
+        m_created.clear();
+
+        std::erase_if(m_open.records, Unchanged);
+        if (m_open.records.empty())
+        {
+            m_open = {};
+            return;
+        }
+
+        // A new edit ends the redo branch
+        while (m_actions.size() > m_cursor)
+        {
+            m_bytes -= m_actions.back().bytes;
+            m_actions.pop_back();
+        }
+
+        m_open.bytes = Measure(m_open);
+        m_bytes += m_open.bytes;
+        m_actions.push_back(std::move(m_open));
+        m_open = {};
+        m_cursor = m_actions.size();
+        m_sealed = false;
+
+        Trim();
+    }
+
+    void ActionList::Seal()
+    {
+        m_sealed = true;
+    }
+
+    void ActionList::Modify(Solid& solid)
+    {
+        if (!Recording())
+            return;
+
+        uint32_t id = Track(solid);
+        if (m_created.contains(id) || m_pending.contains(id))
+            return;
+
+        // The whole side list for now, Finish trims it down to what changed
+        Action::SideDelta delta = { .id = id };
+        delta.sides[Action::Before] = solid.GetSides();
+
+        m_pending.emplace(id, m_open.records.size());
+        m_open.records.push_back(std::move(delta));
+    }
+
+    void ActionList::Modify(Entity& entity)
+    {
+        if (!Recording())
+            return;
+
+        uint32_t id = Track(entity);
+        if (m_created.contains(id) || m_pending.contains(id))
+            return;
+
+        // Keys are only taken as they are edited, see ModifyKey
+        Action::EntityDelta delta = { .id = id };
+        delta.origin[Action::Before]     = entity.origin;
+        delta.classname[Action::Before]  = entity.GetClassname();
+        delta.targetname[Action::Before] = entity.GetTargetname();
+
+        m_pending.emplace(id, m_open.records.size());
+        m_open.records.push_back(std::move(delta));
+    }
+
+    void ActionList::ModifyKey(Entity& entity, InternedString key, const kv::KeyValuesVariant* before)
+    {
+        if (!Recording())
+            return;
+
+        Modify(entity);
+        auto it = m_pending.find(Track(entity));
+        if (it == m_pending.end())
+            return;
+
+        auto& delta = std::get<Action::EntityDelta>(m_open.records[it->second]);
+        for (const Action::KeyDelta& keyDelta : delta.keys)
+        {
+            if (keyDelta.key.EqualsNoCase(key))
+                return;
+        }
+
+        Action::KeyDelta& keyDelta = delta.keys.emplace_back();
+        keyDelta.key = key;
+
+        auto& values = keyDelta.values[Action::Before];
+        values = GetValues(entity.kv, key);
+        if (before && values.empty())
+            values.push_back(*before);
+        else if (before)
+            values[0] = kv::KeyValuesVariant(*before);
+    }
+
+    void ActionList::Created(Atom& atom)
+    {
+        if (!Recording())
+            return;
+
+        uint32_t id = Track(atom);
+        m_created.insert(id);
+        m_open.records.push_back(Action::Presence{ .id = id, .kind = atom.GetKind() });
+    }
+
+    void ActionList::Deleting(Atom& atom)
+    {
+        if (!Recording())
+            return;
+
+        Action::Presence presence = { .id = Track(atom), .kind = atom.GetKind() };
+        Capture(presence, atom);
+        m_open.records.push_back(std::move(presence));
+    }
+
+    void ActionList::Undo()
+    {
+        if (!CanUndo())
+            return;
+
+        Apply(m_actions[--m_cursor], Action::Before);
+    }
+
+    void ActionList::Redo()
+    {
+        if (!CanRedo())
+            return;
+
+        Apply(m_actions[m_cursor++], Action::After);
+    }
+
+    void ActionList::Clear()
+    {
+        m_actions.clear();
+        m_cursor = 0;
+        m_bytes  = 0;
+
+        // A transaction left open stays open, it just forgets what it had
+        m_open.records.clear();
+        m_pending.clear();
+        m_created.clear();
+        m_sealed = true;
+
+        m_objects.assign(1, nullptr);
+    }
+
+    void ActionList::Forget(Atom& atom)
+    {
+        uint32_t id = atom.m_actionID;
+        if (id < m_objects.size() && m_objects[id] == &atom)
+            m_objects[id] = nullptr;
+    }
+
+    uint32_t ActionList::Track(Atom& atom)
+    {
+        uint32_t id = atom.m_actionID;
+        if (id && id < m_objects.size() && m_objects[id] == &atom)
+            return id;
+
+        id = uint32_t(m_objects.size());
+        m_objects.push_back(&atom);
+        atom.m_actionID = id;
+        return id;
+    }
+
+    void ActionList::Bind(uint32_t id, Atom& atom)
+    {
+        m_objects[id] = &atom;
+        atom.m_actionID = id;
+    }
+
+    Atom* ActionList::Resolve(uint32_t id) const
+    {
+        return id < m_objects.size() ? m_objects[id] : nullptr;
+    }
+
+    template <typename T>
+    T* ActionList::Find(uint32_t id) const
+    {
+        Atom* atom = Resolve(id);
+        return atom ? atom->As<T>() : nullptr;
+    }
+
+    void ActionList::Reopen(Action& action)
+    {
+        for (size_t i = 0; i < action.records.size(); i++)
+        {
+            Action::Record& record = action.records[i];
+
+            if (auto* delta = std::get_if<Action::SideDelta>(&record))
+            {
+                // Deleted later in the step, its delta is final
+                Solid* solid = Find<Solid>(delta->id);
+                if (!solid)
+                    continue;
+
+                // Rebuild the whole side list from before, as Modify takes it
+                std::vector<Side>& before = delta->sides[Action::Before];
+                std::vector<Side>& after  = delta->sides[Action::After];
+
+                std::vector<Side> sides = solid->GetSides();
+                auto at = sides.erase(sides.begin() + delta->first, sides.begin() + delta->first + after.size());
+                sides.insert(at, std::make_move_iterator(before.begin()), std::make_move_iterator(before.end()));
+
+                before = std::move(sides);
+                after.clear();
+                delta->first = 0;
+                m_pending[delta->id] = i;
+            }
+            else if (auto* delta = std::get_if<Action::EntityDelta>(&record))
+            {
+                // Everything from before is still there
+                if (Find<Entity>(delta->id))
+                    m_pending[delta->id] = i;
+            }
+            else if (auto* presence = std::get_if<Action::Presence>(&record))
+            {
+                if (Resolve(presence->id))
+                    m_created.insert(presence->id);
+            }
+        }
+    }
+
+    void ActionList::Finish(Action::Record& record)
+    {
+        if (auto* delta = std::get_if<Action::SideDelta>(&record))
+        {
+            std::vector<Side>& before = delta->sides[Action::Before];
+            std::vector<Side>& after  = delta->sides[Action::After];
+
+            Solid* solid = Find<Solid>(delta->id);
+            if (!solid)
+            {
+                before.clear();
+                return;
+            }
+
+            // Keep only the range between the unchanged sides at either end
+            const std::vector<Side>& current = solid->GetSides();
+            size_t count = std::min(before.size(), current.size());
+
+            size_t prefix = 0;
+            while (prefix < count && SameSide(before[prefix], current[prefix]))
+                prefix++;
+
+            size_t suffix = 0;
+            while (suffix < count - prefix && SameSide(before[before.size() - 1 - suffix], current[current.size() - 1 - suffix]))
+                suffix++;
+
+            delta->first = uint32_t(prefix);
+            after.assign(current.begin() + prefix, current.end() - suffix);
+            before.erase(before.end() - suffix, before.end());
+            before.erase(before.begin(), before.begin() + prefix);
+            before.shrink_to_fit();
+        }
+        else if (auto* delta = std::get_if<Action::EntityDelta>(&record))
+        {
+            Entity* entity = Find<Entity>(delta->id);
+            if (!entity)
+            {
+                delta->keys.clear();
+                return;
+            }
+
+            delta->origin[Action::After]     = entity->origin;
+            delta->classname[Action::After]  = entity->GetClassname();
+            delta->targetname[Action::After] = entity->GetTargetname();
+
+            for (Action::KeyDelta& keyDelta : delta->keys)
+                keyDelta.values[Action::After] = GetValues(entity->kv, keyDelta.key);
+
+            std::erase_if(delta->keys, [](const Action::KeyDelta& keyDelta)
+            {
+                return SameValues(keyDelta.values[Action::Before], keyDelta.values[Action::After]);
+            });
+        }
+    }
+
+    void ActionList::FinishPending(uint32_t id)
+    {
+        auto it = m_pending.find(id);
+        if (it == m_pending.end())
+            return;
+
+        Finish(m_open.records[it->second]);
+        m_pending.erase(it);
+    }
+
+    Action::SolidState ActionList::Capture(Solid& solid)
+    {
+        // Changes so far are final, taken against the solid as it is now
+        uint32_t id = Track(solid);
+        FinishPending(id);
+
+        BrushEntity* parent = solid.GetParent();
+        return Action::SolidState{
+            .id     = id,
+            .parent = parent->IsMap() ? 0 : Track(*parent),
+            .sides  = solid.GetSides(),
+        };
+    }
+
+    void ActionList::Capture(Action::Presence& presence, Atom& atom)
+    {
+        if (Solid* solid = atom.As<Solid>())
+        {
+            presence.solid = Capture(*solid);
+            return;
+        }
+
+        Entity* entity = atom.As<Entity>();
+        if (!entity)
+            return;
+
+        FinishPending(presence.id);
+        presence.classname  = entity->GetClassname();
+        presence.targetname = entity->GetTargetname();
+        presence.origin     = entity->origin;
+        presence.keyValues  = entity->kv;
+
+        presence.solids.clear();
+        if (BrushEntity* brush = entity->As<BrushEntity>())
+        {
+            for (Solid& child : brush->Brushes())
+                presence.solids.push_back(Capture(child));
+        }
+    }
+
+    void ActionList::Restore(BrushEntity& parent, Action::SolidState& state, std::vector<uint32_t>& remesh)
+    {
+        // Meshed with the rest of the step
+        Solid& solid = parent.AddBrush(std::move(state.sides), false);
+        Bind(state.id, solid);
+        remesh.push_back(state.id);
+        state.sides = {};
+    }
+
+    void ActionList::Toggle(Action::Presence& presence, std::vector<uint32_t>& remesh)
+    {
+        if (Atom* atom = Resolve(presence.id))
+        {
+            Capture(presence, *atom);
+            atom->Delete();
+            return;
+        }
+
+        Map& map = Chisel.map;
+        if (presence.kind == SelectableKind::Solid)
+        {
+            BrushEntity* parent = presence.solid.parent ? Find<BrushEntity>(presence.solid.parent) : &map;
+            if (parent)
+                Restore(*parent, presence.solid, remesh);
+            return;
+        }
+
+        Entity* entity = presence.kind == SelectableKind::BrushEntity
+            ? static_cast<Entity*>(map.AddBrushEntity(presence.classname))
+            : static_cast<Entity*>(map.AddPointEntity(presence.classname));
+        Bind(presence.id, *entity);
+
+        entity->SetTargetname(presence.targetname);
+        entity->origin = presence.origin;
+        entity->kv = std::move(presence.keyValues);
+        entity->KeyValuesChanged();
+        presence.keyValues = {};
+
+        if (BrushEntity* brush = entity->As<BrushEntity>())
+        {
+            for (Action::SolidState& state : presence.solids)
+                Restore(*brush, state, remesh);
+        }
+        presence.solids = {};
+    }
+
+    void ActionList::Apply(Action& action, uint32_t to)
+    {
+        PROFILE_ZONE("ActionList::Apply");
+
+        m_applying = true;
+        m_sealed   = true;
+
+        // IDs rather than pointers, a later record may delete what an earlier one reshaped
+        std::vector<uint32_t> remesh;
+
+        auto ApplyRecord = [&](Action::Record& record)
+        {
+            if (auto* delta = std::get_if<Action::SideDelta>(&record))
+            {
+                if (Solid* solid = Find<Solid>(delta->id))
+                {
+                    solid->ReplaceSides(delta->first, uint32_t(delta->sides[to ^ 1].size()), delta->sides[to]);
+                    remesh.push_back(delta->id);
+                }
+            }
+            else if (auto* delta = std::get_if<Action::EntityDelta>(&record))
+            {
+                if (Entity* entity = Find<Entity>(delta->id))
+                {
+                    entity->origin = delta->origin[to];
+                    if (entity->GetClassname() != delta->classname[to])
+                        entity->SetClassname(delta->classname[to]);
+                    if (entity->GetTargetname() != delta->targetname[to])
+                        entity->SetTargetname(delta->targetname[to]);
+
+                    for (const Action::KeyDelta& keyDelta : delta->keys)
+                        SetValues(entity->kv, keyDelta.key, keyDelta.values[to]);
+
+                    entity->KeyValuesChanged();
+                    Chisel.map.Touch();
+                }
+            }
+            else if (auto* presence = std::get_if<Action::Presence>(&record))
+                Toggle(*presence, remesh);
+        };
+
+        if (to == Action::After)
+        {
+            for (Action::Record& record : action.records)
+                ApplyRecord(record);
+        }
+        else
+        {
+            for (auto it = action.records.rbegin(); it != action.records.rend(); ++it)
+                ApplyRecord(*it);
+        }
+
+        // Everything the step reshaped remeshes in one batch
+        std::sort(remesh.begin(), remesh.end());
+        remesh.erase(std::unique(remesh.begin(), remesh.end()), remesh.end());
+
+        std::vector<Solid*> solids;
+        solids.reserve(remesh.size());
+        for (uint32_t id : remesh)
+        {
+            if (Solid* solid = Find<Solid>(id))
+                solids.push_back(solid);
+        }
+        if (!solids.empty())
+            Solid::UpdateMeshes(solids);
+
+        m_applying = false;
+
+        // Deleting and restoring moves state in and out of the step
+        m_bytes -= action.bytes;
+        action.bytes = Measure(action);
+        m_bytes += action.bytes;
+        Trim();
+    }
+
+    void ActionList::Trim()
+    {
+        size_t budget = size_t(std::max(int(undo_budget_mb), 0)) * 1024 * 1024;
+        while (m_bytes > budget && !m_actions.empty())
+        {
+            // Oldest undo steps go first, then the furthest redo steps
+            if (m_cursor > 0)
+            {
+                if (m_actions.size() == 1)
+                    Console.Warn("'{}' is larger than undo_budget_mb, it can't be undone", m_actions.front().name);
+
+                m_bytes -= m_actions.front().bytes;
+                m_actions.pop_front();
+                m_cursor--;
+            }
+            else
+            {
+                m_bytes -= m_actions.back().bytes;
+                m_actions.pop_back();
+            }
+        }
+    }
+
+    size_t ActionList::Measure(const Action& action)
+    {
+        size_t bytes = sizeof(Action) + action.records.capacity() * sizeof(Action::Record);
+        for (const Action::Record& record : action.records)
+        {
+            if (auto* delta = std::get_if<Action::SideDelta>(&record))
+            {
+                bytes += SideBytes(delta->sides[Action::Before]);
+                bytes += SideBytes(delta->sides[Action::After]);
+            }
+            else if (auto* delta = std::get_if<Action::EntityDelta>(&record))
+            {
+                bytes += delta->keys.capacity() * sizeof(Action::KeyDelta);
+                for (const Action::KeyDelta& keyDelta : delta->keys)
+                {
+                    for (const auto& values : keyDelta.values)
+                    {
+                        for (const kv::KeyValuesVariant& value : values)
+                            bytes += ValueBytes(value);
+                    }
+                }
+            }
+            else if (auto* presence = std::get_if<Action::Presence>(&record))
+            {
+                bytes += SideBytes(presence->solid.sides);
+                bytes += KeyValuesBytes(presence->keyValues);
+                bytes += presence->solids.capacity() * sizeof(Action::SolidState);
+                for (const Action::SolidState& state : presence->solids)
+                    bytes += SideBytes(state.sides);
+            }
+        }
+        return bytes;
+    }
+}
@@ -1,162 +1,163 @@
 #pragma once
 
-#include <any>
+#include "Types.h"
+#include "Face.h"
+#include "formats/KeyValues.h"
+#include "common/Intern.h"
+#include "math/Math.h"
+
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
 
 namespace chisel
 {
-    class Action
+    /**
+     * One undo step. Holds what changed, not copies of the objects:
+     * the range of sides a solid had replaced, the entity fields and keys that differ,
+     * and objects that were created or deleted.
+     */
+    struct Action
     {
-    public:
-        Action(const char *name, bool dummy)
-            : m_dummy(dummy) { }
-
-        virtual ~Action() { }
+        enum : uint32_t { Before = 0, After = 1 };
 
-        virtual void Do() = 0;
-        virtual void Undo() = 0;
-
-        bool IsDummy() const { return m_dummy; }
+        // Sides [first, first + sides[Before].size()) were replaced by sides[After]
+        struct SideDelta
+        {
+            uint32_t          id;
+            uint32_t          first = 0;
+            std::vector<Side> sides[2];
+        };
 
-        void SetGraphInfo(Action *prev, Action *next0, Action *next1)
+        // Every value of one key, keys can repeat
+        struct KeyDelta
         {
-            m_prev = prev;
-            m_next0 = next0;
-            m_next1 = next1;
-        }
-
-        Action* GetPrev() const  { return m_prev; }
-        Action* GetNext0() const { return m_next0; }
-        Action* GetNext1() const  { return m_next1; }
-    private:
-        Action* m_prev = nullptr;
-        Action* m_next0 = nullptr; // Our most recent paths.
-        Action* m_next1 = nullptr; // The past do's... Only used on dummy nodes
+            InternedString                    key;
+            std::vector<kv::KeyValuesVariant> values[2];
+        };
 
-        // Whether this is a dummy node in our history graph
-        // to represent a divergence in history
-        bool m_dummy = false;
+        struct EntityDelta
+        {
+            uint32_t              id;
+            vec3                  origin[2];
+            InternedString        classname[2];
+            InternedString        targetname[2];
+            std::vector<KeyDelta> keys;
+        };
+
+        struct SolidState
+        {
+            uint32_t          id     = 0;
+            uint32_t          parent = 0; // Brush entity, 0 for the world
+            std::vector<Side> sides;
+        };
+
+        // An object that was created or deleted. Undo and redo both flip whether it exists,
+        // its state is captured on the way out and dropped again once it is back.
+        struct Presence
+        {
+            uint32_t       id;
+            SelectableKind kind;
+
+            SolidState              solid;
+            InternedString          classname;
+            InternedString          targetname;
+            vec3                    origin = vec3(0);
+            kv::KeyValues           keyValues;
+            std::vector<SolidState> solids; // Of a brush entity
+        };
+
+        using Record = std::variant<SideDelta, EntityDelta, Presence>;
+
+        const char*         name     = "";
+        uint64_t            coalesce = 0;
+        std::vector<Record> records;  // In the order they happened
+        size_t              bytes    = 0;
     };
 
-    // Dummy nodes to simplify the graph
-    class DummyAction final : public Action
+    /**
+     * Linear undo history of the map, within undo_budget_mb.
+     *
+     * Edits happen in transactions: Begin, change things, Commit. Objects record
+     * themselves when changed with a transaction open (Modify, Created, Deleting), so
+     * callers only say where a step starts and ends. Transactions nest, only the
+     * outermost Commit makes a step. Committing after an undo drops the redo steps.
+     *
+     * Objects are referred to by an ID kept across being deleted and brought back,
+     * so records never hold pointers.
+     */
+    class ActionList
     {
     public:
-        DummyAction(const char *name)
-            : Action(name, true) { }
+        // Begin with the same name and nonzero coalesce key as the newest step to extend it
+        // instead, for edits that arrive a frame at a time. Seal ends that.
+        void Begin(const char* name, uint64_t coalesce = 0);
+        void Commit();
+        void Seal();
 
-        DummyAction             (DummyAction&&) = delete;
-        DummyAction& operator = (DummyAction&&) = delete;
+        bool Recording() const { return m_depth > 0 && !m_applying; }
 
-        // Should never be executed as it's a dummy.
-        void Do()   { assert(false && "Attempted to do dummy action"); }
-        void Undo() { assert(false && "Attempted to undo dummy action"); }
-    };
+        // Call before changing an object, they do nothing outside a transaction
+        void Modify(Solid& solid);
+        void Modify(Entity& entity);
 
-    template <typename DoCmd, typename UndoCmd>
-    class FunctionAction final : public Action
-    {
-    public:
-        FunctionAction(const char *name, DoCmd&& doCmd, UndoCmd&& undoCmd)
-            : Action(name, false)
-            , m_do(std::move(doCmd))
-            , m_undo(std::move(undoCmd)) { }
+        // Call before changing the values of key. If they were changed in place already,
+        // pass the value the first one had.
+        void ModifyKey(Entity& entity, InternedString key, const kv::KeyValuesVariant* before = nullptr);
+
+        void Created(Atom& atom);
+        void Deleting(Atom& atom);
+
+        void Undo();
+        void Redo();
+
+        bool CanUndo() const { return m_depth == 0 && m_cursor > 0; }
+        bool CanRedo() const { return m_depth == 0 && m_cursor < m_actions.size(); }
 
-        FunctionAction             (FunctionAction&&) = delete;
-        FunctionAction& operator = (FunctionAction&&) = delete;
+        // Drop all history, the objects it refers to are gone
+        void Clear();
+
+        // From Atom's destructor
+        void Forget(Atom& atom);
+
+        size_t MemoryUsage() const { return m_bytes; }
 
-        void Do() { m_do(m_userdata); }
-        void Undo() { m_undo(m_userdata); m_userdata.reset(); }
     private:
-        std::any m_userdata;
+        uint32_t Track(Atom& atom);
+        void Bind(uint32_t id, Atom& atom);
+        Atom* Resolve(uint32_t id) const;
 
-        DoCmd   m_do;
-        UndoCmd m_undo;
-    };
+        template <typename T>
+        T* Find(uint32_t id) const;
 
-    class ActionList
-    {
-    public:
-        ActionList()
-        {
-            m_head = new DummyAction("Root");
-            m_activeTail = m_head;
-        }
+        void Reopen(Action& action);
+        void Finish(Action::Record& record);
+        void FinishPending(uint32_t id);
 
-        template <typename DoCmd, typename UndoCmd>
-        void PerformAction(const char *name, DoCmd&& doFunc, UndoCmd&& undoFunc)
-        {
-            Action* prevTail = m_activeTail;
-            Action* prevNext = prevTail->GetNext0();
-
-            m_activeTail = new FunctionAction<DoCmd, UndoCmd>(name, std::move(doFunc), std::move(undoFunc));
-            // Insert a dummy node if we have divergence.
-            if (prevNext)
-            {
-                DummyAction *dummy = new DummyAction("Divergence");
-                dummy->SetGraphInfo(prevTail, m_activeTail, prevNext);
-                m_activeTail->SetGraphInfo(dummy, nullptr, nullptr);
-                prevNext->SetGraphInfo(dummy, prevNext->GetNext0(), prevNext->GetNext1());
-                prevTail->SetGraphInfo(prevTail->GetPrev(), m_activeTail, prevTail->GetNext1());
-
-                //                  /-- m_activeTail (new)
-                // prevTail -- dummy
-                //                  \-- prevNext (prevTail->GetNext0())
-            }
-            else
-            {
-                m_activeTail->SetGraphInfo(prevTail, nullptr, nullptr);
-                prevTail->SetGraphInfo(prevTail->GetPrev(), m_activeTail, prevTail->GetNext1());
-
-                // prevTail -- m_activeTail
-            }
-
-            m_activeTail->Do();
-
-            GraphSanityAssert();
-        }
-
-        void Undo()
-        {
-            if (!m_activeTail->IsDummy())
-            {
-                m_activeTail->Undo();
+        Action::SolidState Capture(Solid& solid);
+        void Capture(Action::Presence& presence, Atom& atom);
+        void Restore(BrushEntity& parent, Action::SolidState& state, std::vector<uint32_t>& remesh);
 
-                do
-                {
-                    if (Action *newTail = m_activeTail->GetPrev())
-                        m_activeTail = newTail;
-                } while (m_activeTail->IsDummy() && m_activeTail != m_head);
-            }
+        void Apply(Action& action, uint32_t to);
+        void Toggle(Action::Presence& presence, std::vector<uint32_t>& remesh);
+        void Trim();
 
-            GraphSanityAssert();
-        }
+        static size_t Measure(const Action& action);
 
-        void Redo()
-        {
-            Action *redoNode = nullptr;
-            do
-            {
-                if ( Action *nextNode = m_activeTail->GetNext0() )
-                    redoNode = nextNode;
-            } while ( redoNode && redoNode->IsDummy() );
-
-            if ( redoNode && !redoNode->IsDummy() )
-            {
-                redoNode->Do();
-                m_activeTail = redoNode;
-            }
-
-            GraphSanityAssert();
-        }
-
-        void GraphSanityAssert()
-        {
-            assert(m_activeTail && m_head);
-            assert(!m_activeTail->IsDummy() || m_activeTail == m_head);
-            assert(m_head->IsDummy());
-        }
-    private:
-        Action *m_head = nullptr;
-        Action *m_activeTail = nullptr;
+        std::deque<Action> m_actions;
+        size_t             m_cursor = 0; // Steps before it can be undone, the rest redone
+        size_t             m_bytes  = 0;
+
+        // The open transaction
+        Action                                 m_open;
+        uint32_t                               m_depth = 0;
+        std::unordered_map<uint32_t, size_t>   m_pending; // Object ID to its delta in m_open, until finished
+        std::unordered_set<uint32_t>           m_created; // Made in m_open, their creation covers any change
+        bool                                   m_sealed   = true;
+        bool                                   m_applying = false;
+
+        std::vector<Atom*> m_objects = { nullptr }; // By ID, null while deleted. 0 is never an ID.
     };
 }
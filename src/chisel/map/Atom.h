@@ -13,6 +13,8 @@ namespace chisel
         {
         }
 
+        ~Atom();
+
         BrushEntity *GetParent() const
         {
             return m_parent;
@@ -20,6 +22,10 @@ namespace chisel
 
     protected:
         BrushEntity* m_parent;
+
+    private:
+        friend class ActionList;
+        uint32_t m_actionID = 0; // Kept across undo deleting and restoring this, 0 until the history refers to it
     };
 
 }
@@ -0,0 +1,356 @@
+#include "chisel/map/BrushGPUAllocator.h"
+#include "chisel/map/Solid.h"
+#include "chisel/Chisel.h"
+#include "common/Bit.h"
+#include "console/ConCommand.h"
+#include "console/ConVar.h"
+
+namespace chisel
+{
+    static ConVar<bool>  r_brushheap_defrag("r_brushheap_defrag", true, "Drain sparse brush heap pages in the background so they can be released");
+    static ConVar<float> r_brushheap_defrag_threshold("r_brushheap_defrag_threshold", 0.25f, "Brush heap pages less full than this are drained");
+    static ConVar<int>   r_brushheap_defrag_budget("r_brushheap_defrag_budget", 256, "Max brush meshes relocated per frame while defragmenting");
+
+    BrushGPUAllocator::BrushGPUAllocator(render::RenderContext& rctx)
+        : m_rctx(rctx)
+    {
+        // Pages are read through a shader view, which only 11.1 drivers reporting it can keep mapping
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        if (SUCCEEDED(m_rctx.device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+            m_mappable = options.MapNoOverwriteOnDynamicBufferSRV;
+        if (!m_mappable)
+            Console.Warn("[D3D11] No-overwrite maps of shader visible buffers are unsupported, brush heap writes are copied on upload");
+
+        CreatePage(PageSize);
+    }
+
+    BrushGPUAllocator::~BrushGPUAllocator()
+    {
+        assert(m_refs == 0);
+    }
+
+    BrushGPUAllocator::Page* BrushGPUAllocator::CreatePage(uint32_t size)
+    {
+        auto page = std::make_unique<Page>(size);
+
+        D3D11_BUFFER_DESC desc
+        {
+            .ByteWidth      = size,
+            .Usage          = m_mappable ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT,
+            .BindFlags      = D3D11_BIND_VERTEX_BUFFER | D3D11_BIND_INDEX_BUFFER | D3D11_BIND_SHADER_RESOURCE,
+            .CPUAccessFlags = m_mappable ? D3D11_CPU_ACCESS_WRITE : 0u,
+            .MiscFlags      = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS,
+        };
+        if (FAILED(m_rctx.device->CreateBuffer(&desc, nullptr, &page->buffer)))
+        {
+            Console.Error("[D3D11] Failed to create brush heap page ({} bytes)", size);
+            return nullptr;
+        }
+
+        // Raw view for reading BrushFace attributes in the vertex shader
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc
+        {
+            .Format        = DXGI_FORMAT_R32_TYPELESS,
+            .ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX,
+            .BufferEx      = {
+                .FirstElement = 0,
+                .NumElements  = size / 4,
+                .Flags        = D3D11_BUFFEREX_SRV_FLAG_RAW,
+            }
+        };
+        if (FAILED(m_rctx.device->CreateShaderResourceView(page->buffer.ptr(), &srvDesc, &page->srv)))
+            Console.Error("[D3D11] Failed to create brush heap page view");
+
+        // Reuse the slot of a released page
+        for (auto& slot : m_pages)
+        {
+            if (!slot)
+            {
+                slot = std::move(page);
+                return slot.get();
+            }
+        }
+
+        return m_pages.emplace_back(std::move(page)).get();
+    }
+
+    void BrushGPUAllocator::open()
+    {
+        m_refs++;
+    }
+
+    void BrushGPUAllocator::close()
+    {
+        assert(m_refs > 0);
+        if (--m_refs == 0)
+        {
+            // Only ever staged to live ranges, which UpdateSubresource keeps in order with the GPU
+            for (const Upload& upload : m_uploads)
+            {
+                D3D11_BOX box = { upload.offset, 0, 0, upload.offset + uint32_t(upload.bytes.size()), 1, 1 };
+                m_rctx.ctx->UpdateSubresource(m_pages[upload.page]->buffer.ptr(), 0, &box, upload.bytes.data(), 0, 0);
+            }
+            m_uploads.clear();
+
+            for (auto& page : m_pages)
+            {
+                if (page && page->base)
+                {
+                    m_rctx.ctx->Unmap(page->buffer.ptr(), 0);
+                    page->base = nullptr;
+                }
+            }
+        }
+    }
+
+    uint8_t* BrushGPUAllocator::data(const Allocation& alloc)
+    {
+        assert(m_refs > 0);
+
+        if (!m_mappable)
+        {
+            Upload& upload = m_uploads.emplace_back(Upload { alloc.page, alloc.offset });
+            upload.bytes.resize(alloc.size);
+            return upload.bytes.data();
+        }
+
+        Page& page = *m_pages[alloc.page];
+        if (!page.base)
+        {
+            // Live ranges may still be in use by the GPU, only ever write to unused ones.
+            D3D11_MAP mode = page.fresh ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            HRESULT hr = m_rctx.ctx->Map(page.buffer.ptr(), 0, mode, 0, &mapped);
+            if (FAILED(hr))
+            {
+                abort();
+            }
+            page.base = (uint8_t*)mapped.pData;
+            page.fresh = false;
+        }
+
+        return page.base + alloc.offset;
+    }
+
+    BrushGPUAllocator::Allocation BrushGPUAllocator::alloc(uint32_t size)
+    {
+        // Keep every allocation 4 byte aligned for vertex offsets and raw loads
+        size = align(std::max(size, 4u), 4u);
+
+        auto TryAllocate = [&](uint32_t index, Allocation& result)
+        {
+            Page& page = *m_pages[index];
+            OffsetAllocator::Allocation handle = page.allocator.allocate(size);
+            if (handle.offset == OffsetAllocator::Allocation::NO_SPACE)
+                return false;
+
+            page.liveCount++;
+            page.liveBytes += size;
+
+            result = Allocation { index, handle.offset, size, handle };
+            return true;
+        };
+
+        Allocation result;
+        for (uint32_t i = 0; i < m_pages.size(); i++)
+        {
+            if (m_pages[i] && int(i) != m_evacuating && TryAllocate(i, result))
+                return result;
+        }
+
+        // Out of space, grow.
+        Page* page = CreatePage(std::max(PageSize, size));
+        if (!page)
+            abort();
+
+        for (uint32_t i = 0; i < m_pages.size(); i++)
+        {
+            if (m_pages[i].get() == page && TryAllocate(i, result))
+                return result;
+        }
+
+        abort();
+    }
+
+    void BrushGPUAllocator::free(const Allocation& alloc)
+    {
+        Page& page = *m_pages[alloc.page];
+        assert(page.liveCount > 0);
+        page.liveCount--;
+        page.liveBytes -= alloc.size;
+        page.pendingCount++;
+        page.pendingBytes += alloc.size;
+
+        m_frees.push_back(alloc);
+    }
+
+    void BrushGPUAllocator::Release(const Allocation& alloc)
+    {
+        Page& page = *m_pages[alloc.page];
+        page.allocator.free(alloc.handle);
+        page.pendingCount--;
+        page.pendingBytes -= alloc.size;
+    }
+
+    void BrushGPUAllocator::EndFrame()
+    {
+        // Fence this frame's frees
+        if (!m_frees.empty())
+        {
+            Fence fence;
+            if (!m_queryPool.empty())
+            {
+                fence.query = std::move(m_queryPool.back());
+                m_queryPool.pop_back();
+            }
+            else
+            {
+                D3D11_QUERY_DESC desc = { .Query = D3D11_QUERY_EVENT };
+                if (FAILED(m_rctx.device->CreateQuery(&desc, &fence.query)))
+                    Console.Error("[D3D11] Failed to create brush heap fence");
+            }
+
+            if (fence.query)
+                m_rctx.ctx->End(fence.query.ptr());
+
+            fence.frees = std::move(m_frees);
+            m_frees.clear();
+            m_fences.push_back(std::move(fence));
+        }
+
+        RetireFences();
+        Defragment();
+    }
+
+    void BrushGPUAllocator::RetireFences()
+    {
+        while (!m_fences.empty())
+        {
+            Fence& fence = m_fences.front();
+            if (fence.query)
+            {
+                BOOL done = FALSE;
+                HRESULT hr = m_rctx.ctx->GetData(fence.query.ptr(), &done, sizeof(done), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+                if (hr != S_OK || !done)
+                    break;
+
+                m_queryPool.push_back(std::move(fence.query));
+            }
+
+            for (const Allocation& alloc : fence.frees)
+                Release(alloc);
+            m_fences.pop_front();
+        }
+    }
+
+    void BrushGPUAllocator::Defragment()
+    {
+        // Release the drained page once nothing references it anymore
+        if (m_evacuating >= 0)
+        {
+            Page& page = *m_pages[m_evacuating];
+            if (page.liveCount == 0 && page.pendingCount == 0 && !page.base)
+            {
+                m_pages[m_evacuating] = nullptr;
+                m_evacuating = -1;
+            }
+        }
+
+        if (!r_brushheap_defrag || m_refs > 0)
+            return;
+
+        if (m_evacuating < 0)
+        {
+            Stats stats = GetStats();
+            if (stats.pages < 2)
+                return;
+
+            // Drain the emptiest page whose contents fit in the others
+            float minUsage = r_brushheap_defrag_threshold;
+            for (uint32_t i = 0; i < m_pages.size(); i++)
+            {
+                if (!m_pages[i])
+                    continue;
+
+                Page& page = *m_pages[i];
+                float usage = float(page.liveBytes) / float(page.size);
+                uint64_t freeElsewhere = stats.freeBytes - page.allocator.storageReport().totalFreeSpace;
+                if (usage < minUsage && page.liveBytes < freeElsewhere)
+                {
+                    minUsage = usage;
+                    m_evacuating = int(i);
+                }
+            }
+
+            if (m_evacuating < 0)
+                return;
+        }
+
+        uint32_t budget = uint32_t(std::max(int(r_brushheap_defrag_budget), 1));
+        uint32_t moved  = 0;
+
+        auto Relocate = [&](BrushEntity& ent)
+        {
+            for (Solid& solid : ent.Brushes())
+            {
+                if (moved >= budget)
+                    return;
+                moved += solid.RelocateMeshes(uint32_t(m_evacuating));
+            }
+        };
+
+        Relocate(Chisel.map);
+        for (BrushEntity& brush : Chisel.map.BrushEntities())
+            Relocate(brush);
+        if (moved < budget)
+            moved += Chisel.map.Chunks().RelocateMeshes(*this, uint32_t(m_evacuating));
+
+        // Nothing left that we know how to move
+        if (moved == 0 && m_pages[m_evacuating]->liveCount != 0)
+            m_evacuating = -1;
+    }
+
+    BrushGPUAllocator::Stats BrushGPUAllocator::GetStats() const
+    {
+        Stats stats;
+        for (const auto& page : m_pages)
+        {
+            if (!page)
+                continue;
+
+            OffsetAllocator::StorageReport report = page->allocator.storageReport();
+
+            stats.pages++;
+            stats.allocations       += page->liveCount;
+            stats.pendingFrees      += page->pendingCount;
+            stats.pendingFreeBytes  += page->pendingBytes;
+            stats.reservedBytes     += page->size;
+            stats.usedBytes         += page->liveBytes;
+            stats.freeBytes         += report.totalFreeSpace;
+            stats.largestFreeRegion  = std::max<uint64_t>(stats.largestFreeRegion, report.largestFreeRegion);
+        }
+        // Whatever isn't live, pending or free went to rounding allocations up
+        uint64_t accounted = stats.usedBytes + stats.pendingFreeBytes + stats.freeBytes;
+        stats.wasteBytes = stats.reservedBytes > accounted ? stats.reservedBytes - accounted : 0;
+        return stats;
+    }
+}
+
+namespace chisel::commands
+{
+    static ConCommand brushheap_stats("brushheap_stats", "Print brush GPU heap usage and fragmentation", []()
+    {
+        if (!Chisel.brushAllocator)
+            return Console.Error("Brush heap is not initialized");
+
+        constexpr double MB = 1024.0 * 1024.0;
+        auto stats = Chisel.brushAllocator->GetStats();
+        Console.Log("Brush heap: {} pages, {:.1f} MB reserved", stats.pages, stats.reservedBytes / MB);
+        Console.Log("  used:    {:.1f} MB in {} allocations", stats.usedBytes / MB, stats.allocations);
+        Console.Log("  pending: {:.1f} MB in {} frees waiting on the GPU", stats.pendingFreeBytes / MB, stats.pendingFrees);
+        Console.Log("  free:    {:.1f} MB, largest region {:.1f} MB, {:.0f}% fragmented",
+            stats.freeBytes / MB, stats.largestFreeRegion / MB, stats.Fragmentation() * 100.0f);
+        Console.Log("  waste:   {:.1f} MB lost to rounding up allocations", stats.wasteBytes / MB);
+    });
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "render/Render.h"
+
+#include "../submodules/OffsetAllocator/offsetAllocator.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace chisel
+{
+    // Heap for brush mesh vertices, indices and face attributes.
+    // Made of dynamic buffer pages that are added on demand. Drivers that can't map a buffer
+    // with shader views for no-overwrite get default pages, written with UpdateSubresource on close().
+    // Frees are deferred until the GPU has finished the frame they were made in,
+    // and sparse pages are drained in the background so they can be released.
+    struct BrushGPUAllocator
+    {
+    public:
+        static constexpr uint32_t PageSize = 64 * 1024 * 1024; // 64 mb
+        static constexpr uint32_t MaxAllocationsPerPage = 65535;
+
+        struct Allocation
+        {
+            uint32_t page   = 0;
+            uint32_t offset = 0; // Byte offset into the page's buffer
+            uint32_t size   = 0;
+            OffsetAllocator::Allocation handle;
+        };
+
+        struct Stats
+        {
+            uint32_t pages            = 0;
+            uint32_t allocations      = 0;
+            uint32_t pendingFrees     = 0;
+            uint64_t reservedBytes    = 0;
+            uint64_t usedBytes        = 0;
+            uint64_t pendingFreeBytes = 0;
+            uint64_t freeBytes        = 0;
+            uint64_t wasteBytes       = 0; // Lost to the allocator rounding sizes up to its bins
+            uint64_t largestFreeRegion = 0;
+
+            // 0 when all free space is contiguous, towards 1 as it gets split up
+            float Fragmentation() const { return freeBytes ? 1.0f - float(largestFreeRegion) / float(freeBytes) : 0.0f; }
+        };
+
+        BrushGPUAllocator(render::RenderContext& rctx);
+        ~BrushGPUAllocator();
+
+        // Map pages for writing. Refcounted; pages are mapped as they are first written.
+        void open();
+        void close();
+
+        // Write pointer to the start of an allocation. Only valid between open() and close(),
+        // where it is either the mapped page or a copy uploaded then.
+        uint8_t* data(const Allocation& alloc);
+
+        Allocation alloc(uint32_t size);
+
+        // Released once the GPU is done with the current frame.
+        void free(const Allocation& alloc);
+
+        // Retire finished frames and make a step of background defragmentation.
+        void EndFrame();
+
+        Stats GetStats() const;
+
+        render::RenderContext& rctx() const { return m_rctx; }
+
+        ID3D11Buffer* buffer(uint32_t page) const { return m_pages[page]->buffer.ptr(); }
+        ID3D11ShaderResourceView* srv(uint32_t page) const { return m_pages[page]->srv.ptr(); }
+
+    private:
+        struct Page
+        {
+            Page(uint32_t size) : allocator(size, MaxAllocationsPerPage), size(size) {}
+
+            OffsetAllocator::Allocator allocator;
+            uint32_t                   size;
+
+            Com<ID3D11Buffer>             buffer;
+            Com<ID3D11ShaderResourceView> srv;
+            uint8_t*                      base = nullptr;
+            bool                          fresh = true; // Never mapped yet
+
+            uint32_t liveCount    = 0;
+            uint64_t liveBytes    = 0;
+            uint32_t pendingCount = 0;
+            uint64_t pendingBytes = 0;
+        };
+
+        // A write staged on the CPU for a page that can't be mapped
+        struct Upload
+        {
+            uint32_t             page;
+            uint32_t             offset;
+            std::vector<uint8_t> bytes;
+        };
+
+        struct Fence
+        {
+            Com<ID3D11Query>        query;
+            std::vector<Allocation> frees;
+        };
+
+        Page* CreatePage(uint32_t size);
+        void  Release(const Allocation& alloc);
+        void  RetireFences();
+        void  Defragment();
+
+        render::RenderContext&             m_rctx;
+        std::vector<std::unique_ptr<Page>> m_pages; // Slots of released pages are null and reused
+        uint32_t                           m_refs = 0;
+        bool                               m_mappable = false; // MapNoOverwriteOnDynamicBufferSRV
+        std::deque<Upload>                 m_uploads;          // Staged while open, when not mappable
+
+        std::vector<Allocation>  m_frees;      // Freed this frame
+        std::deque<Fence>        m_fences;     // Frames in flight, oldest first
+        std::vector<Com<ID3D11Query>> m_queryPool;
+
+        int                      m_evacuating = -1; // Page being drained by Defragment
+    };
+}
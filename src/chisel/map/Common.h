@@ -1,10 +1,14 @@
 #pragma once
 
+#include "console/Console.h"
 #include "core/VertexLayout.h"
 #include "math/Math.h"
 #include "render/Render.h"
+#include "render/CBuffers.h"
+#include "common/Bit.h"
+#include "BrushGPUAllocator.h"
 
-#include "../submodules/OffsetAllocator/offsetAllocator.hpp"
+#include <vector>
 
 namespace chisel
 {
@@ -24,96 +28,132 @@ namespace chisel
         T& m_things;
     };
 
+    // Packed brush vertex (24 bytes).
+    // Per-face attributes (normal, selection id) live in a BrushFace array
+    // uploaded after the mesh's indices, indexed by the face field.
     struct VertexSolid
-    {        
-        vec3 position;
-        vec3 normal;
-        vec3 uv;
-        uint face;
-        
+    {
+        vec3     position;
+        vec2     uv;
+        uint16_t face  = 0; // Index into the mesh's BrushFace attributes
+        uint8_t  alpha = 0; // Displacement blend alpha
+        uint8_t  pad   = 0;
+
         static constexpr D3D11_INPUT_ELEMENT_DESC Layout[] =
         {
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,                            D3D11_INPUT_PER_VERTEX_DATA, 0 },
-            { "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-            { "TEXCOORD", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-            { "BLENDINDICES", 0, DXGI_FORMAT_R32_UINT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "POSITION",     0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,                            D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD",     0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "BLENDINDICES", 0, DXGI_FORMAT_R16_UINT,        0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "COLOR",        0, DXGI_FORMAT_R8_UNORM,        0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
         };
     };
-    
-    struct BrushGPUAllocator
+    static_assert(sizeof(VertexSolid) == 24);
+
+    using BrushFace = cbuffers::BrushFace;
+    static_assert(sizeof(BrushFace) == 16);
+
+    // Set in BrushFace::id for selected faces, which then mark the selection mask.
+    // Selection IDs never use the top bit.
+    static constexpr uint32_t BrushFaceSelected = 1u << 31;
+
+    // Brush meshes are indexed with 16-bit indices
+    using BrushIndex = uint16_t;
+    static constexpr DXGI_FORMAT BrushIndexFormat = DXGI_FORMAT_R16_UINT;
+    static constexpr uint32_t MaxBrushMeshVertices = uint32_t(UINT16_MAX) + 1;
+
+    // Every displacement of the same power has the same triangulation,
+    // so they all share one immutable index buffer instead of uploading their own.
+    // Indices always address the full (2^power + 1)^2 vertex grid; a lod level N
+    // draws the sub-grid made of every 2^N-th vertex.
+    struct DispIndexBuffer
     {
     public:
-        static constexpr uint32_t BufferSize = 256 * 1024 * 1024; // 256 mb
-        static constexpr uint32_t MaxAllocations = 65535 * 4;
-
-        using Allocation = OffsetAllocator::Allocation;
-        
-        BrushGPUAllocator(render::RenderContext& rctx)
-            : m_rctx     (rctx)
-            , m_allocator(BufferSize, MaxAllocations)
+        static constexpr uint32_t MaxPower = 4;
+
+        struct Range
         {
-            D3D11_BUFFER_DESC desc
-            {
-                .ByteWidth      = BufferSize,
-                .Usage          = D3D11_USAGE_DYNAMIC,
-                .BindFlags      = D3D11_BIND_VERTEX_BUFFER,
-                .CPUAccessFlags = D3D11_CPU_ACCESS_WRITE,
-            };
-            m_rctx.device->CreateBuffer(&desc, nullptr, &m_buffer);
-        }
+            uint32_t start = 0;
+            uint32_t count = 0;
+        };
 
-        void open()
+        DispIndexBuffer(render::RenderContext& rctx)
         {
-            if (m_refs++ == 0)
+            std::vector<BrushIndex> indices;
+            for (uint32_t power = 0; power <= MaxPower; power++)
             {
-                assert(m_base == nullptr);
-
-                D3D11_MAPPED_SUBRESOURCE mapped;
-                HRESULT hr = m_rctx.ctx->Map(m_buffer.ptr(), 0, D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped);
-                if (FAILED(hr))
+                for (uint32_t lod = 0; lod <= power; lod++)
                 {
-                    abort();
+                    m_ranges[power][lod].start = uint32_t(indices.size());
+                    Generate(power, lod, indices);
+                    m_ranges[power][lod].count = uint32_t(indices.size()) - m_ranges[power][lod].start;
                 }
-                m_base = (uint8_t*)mapped.pData;
             }
-        }
 
-        void close()
-        {
-            if (--m_refs == 0)
+            D3D11_BUFFER_DESC desc
             {
-                assert(m_base != nullptr);
-                m_rctx.ctx->Unmap(m_buffer.ptr(), 0);
-                m_base = nullptr;
-            }
+                .ByteWidth      = uint32_t(indices.size() * sizeof(BrushIndex)),
+                .Usage          = D3D11_USAGE_IMMUTABLE,
+                .BindFlags      = D3D11_BIND_INDEX_BUFFER,
+                .CPUAccessFlags = 0,
+            };
+            D3D11_SUBRESOURCE_DATA data
+            {
+                .pSysMem = indices.data(),
+                .SysMemPitch = 0,
+                .SysMemSlicePitch = 0,
+            };
+            if (FAILED(rctx.device->CreateBuffer(&desc, &data, &m_buffer)))
+                Console.Error("[D3D11] Failed to create displacement index buffer");
         }
 
-        uint8_t* data()
+        const Range& range(uint32_t power, uint32_t lod) const
         {
-            assert(m_base != nullptr);
-            return m_base;
+            assert(power <= MaxPower);
+            return m_ranges[power][std::min(lod, power)];
         }
 
-        Allocation alloc(uint32_t size)
-        {
-            return m_allocator.allocate(size);
-        }
+        ID3D11Buffer* buffer() const { return m_buffer.ptr(); }
 
-        void free(Allocation alloc)
+        // Triangulate a grid with alternating diagonals, matching Hammer and VBSP.
+        // The diagonal pattern is based on the quad's position in the lod grid,
+        // so coarser levels alternate the same way a native lower power would.
+        static void Generate(uint32_t power, uint32_t lod, std::vector<BrushIndex>& indices)
         {
-            m_allocator.free(alloc);
-        }
+            const uint32_t length    = (1u << power) + 1;
+            const uint32_t step      = 1u << lod;
+            const uint32_t numSlices = 1u << (power - lod);
 
-        render::RenderContext& rctx() const { return m_rctx; }
-
-        ID3D11Buffer* buffer() const { return m_buffer.ptr(); }
+            indices.reserve(indices.size() + numSlices * numSlices * 6);
+            for (uint32_t y = 0; y < numSlices; y++)
+            {
+                for (uint32_t x = 0; x < numSlices; x++)
+                {
+                    const BrushIndex i00 = BrushIndex((y * step) * length + (x * step));
+                    const BrushIndex i01 = BrushIndex((y * step) * length + (x * step) + step);
+                    const BrushIndex i10 = BrushIndex((y * step + step) * length + (x * step));
+                    const BrushIndex i11 = BrushIndex((y * step + step) * length + (x * step) + step);
+
+                    bool even = (y * (numSlices + 1) + x) % 2 == 0;
+                    if (!even)
+                    {
+                        // 1, 2, 0 (clockwise from bottom left)
+                        indices.insert(indices.end(), { i00, i01, i10 });
+                        // 3, 0, 2
+                        indices.insert(indices.end(), { i11, i10, i01 });
+                    }
+                    else
+                    {
+                        // 1, 0, 3
+                        indices.insert(indices.end(), { i11, i10, i00 });
+                        // 3, 2, 1
+                        indices.insert(indices.end(), { i00, i01, i11 });
+                    }
+                }
+            }
+        }
 
     private:
-        render::RenderContext&     m_rctx;
-        OffsetAllocator::Allocator m_allocator;
-
-        Com<ID3D11Buffer>          m_buffer;
-        uint8_t*                   m_base = nullptr;
-        uint32_t                   m_refs = 0;
+        Range             m_ranges[MaxPower + 1][MaxPower + 1];
+        Com<ID3D11Buffer> m_buffer;
     };
 }
@@ -3,6 +3,7 @@
 #include "Entity.h"
 #include "Map.h"
 #include "Convex.h"
+#include "chisel/Chisel.h"
 
 namespace chisel
 {
@@ -15,6 +16,41 @@ namespace chisel
     {
     }
 
+    void Entity::SetClassname(InternedString classname)
+    {
+        Chisel.map.Actions().Modify(*this);
+        m_classname = classname;
+        m_classGeneration = 0;
+        KeyValuesChanged();
+    }
+
+    void Entity::SetTargetname(InternedString targetname)
+    {
+        Chisel.map.Actions().Modify(*this);
+        m_targetname = targetname;
+        KeyValuesChanged();
+    }
+
+    void Entity::KeyValuesChanged()
+    {
+        if (m_parent && m_parent->IsMap())
+            static_cast<Map*>(m_parent)->Index().Invalidate(*this);
+    }
+
+    const FGD::Class* Entity::GetClass() const
+    {
+        const FGD* fgd = Chisel.fgd;
+        if (!fgd)
+            return nullptr;
+
+        if (m_classGeneration != fgd->generation)
+        {
+            m_class = fgd->Find(m_classname);
+            m_classGeneration = fgd->generation;
+        }
+        return m_class;
+    }
+
     void Entity::Delete()
     {
         assert(m_parent->IsMap());
@@ -28,6 +64,7 @@ namespace chisel
     PointEntity::PointEntity(BrushEntity* parent)
         : Entity(parent)
     {
+        SetKind(SelectableKind::PointEntity);
     }
 
     // TODO: Bounds from model or FGD
@@ -37,21 +74,23 @@ namespace chisel
     }
     void PointEntity::Transform(const mat4x4& matrix)
     {
+        Chisel.map.Actions().Modify(*this);
         origin = matrix * vec4(origin, 1.0f);
+        Chisel.map.Touch();
     }
     void PointEntity::AlignToGrid(vec3 gridSize)
     {
+        Chisel.map.Actions().Modify(*this);
         origin = math::Snap(origin, gridSize);
+        Chisel.map.Touch();
     }
     Selectable* PointEntity::Duplicate()
     {
         assert(m_parent->IsMap());
-        PointEntity *newEntity = new PointEntity(m_parent);
-        newEntity->classname = this->classname;
-        newEntity->targetname = this->targetname;
+        PointEntity* newEntity = static_cast<Map*>(m_parent)->AddPointEntity(m_classname);
+        newEntity->SetTargetname(m_targetname);
         newEntity->origin = this->origin;
         newEntity->kv = this->kv;
-        static_cast<Map*>(m_parent)->AddEntity(newEntity);
         return newEntity;
     }
 
@@ -62,6 +101,7 @@ namespace chisel
     BrushEntity::BrushEntity(BrushEntity* parent)
         : Entity(parent)
     {
+        SetKind(SelectableKind::BrushEntity);
     }
 
     std::optional<AABB> BrushEntity::GetBounds() const
@@ -83,8 +123,10 @@ namespace chisel
 
     void BrushEntity::Transform(const mat4x4& matrix)
     {
+        std::vector<Solid*> solids;
         for (auto& b : m_solids)
-            b.Transform(matrix);
+            solids.push_back(&b);
+        Solid::TransformMany(solids, matrix);
     }
 
     void BrushEntity::AlignToGrid(vec3 gridSize)
@@ -96,25 +138,34 @@ namespace chisel
     Selectable* BrushEntity::Duplicate()
     {
         assert(m_parent->IsMap());
-        BrushEntity *newEntity = new BrushEntity(m_parent);
-        newEntity->classname = this->classname;
-        newEntity->targetname = this->targetname;
+        BrushEntity* newEntity = static_cast<Map*>(m_parent)->AddBrushEntity(m_classname);
+        newEntity->SetTargetname(m_targetname);
         newEntity->origin = this->origin;
         newEntity->kv = this->kv;
         for (Solid& brush : Brushes())
-            newEntity->AddBrush(brush.GetSides());
-        static_cast<Map*>(m_parent)->AddEntity(newEntity);
+            newEntity->CloneBrush(brush);
         return newEntity;
     }
 
-    Solid& BrushEntity::AddBrush(std::vector<Side> sides)
+    Solid& BrushEntity::AddBrush(std::vector<Side> sides, bool initMesh)
+    {
+        Solid& solid = m_solids.emplace(this, std::move(sides), initMesh);
+        Chisel.map.Actions().Created(solid);
+        return solid;
+    }
+
+    Solid& BrushEntity::CloneBrush(const Solid& source)
     {
-        return m_solids.emplace_back(this, sides);
+        Solid& solid = m_solids.emplace(this, source);
+        Chisel.map.Actions().Created(solid);
+        return solid;
     }
 
     void BrushEntity::RemoveBrush(const Solid& brush)
     {
-        m_solids.remove(brush);
+        Chisel.map.Actions().Deleting(const_cast<Solid&>(brush));
+        m_solids.erase(brush);
+        Chisel.map.Touch();
     }
 
     std::optional<RayHit> BrushEntity::QueryRay(const Ray& ray) const
@@ -5,8 +5,9 @@
 #include "RayHit.h"
 #include "Solid.h"
 #include "formats/KeyValues.h"
+#include "chisel/FGD/FGD.h"
+#include "common/Pool.h"
 #include <optional>
-#include <list>
 
 namespace chisel
 {
@@ -19,14 +20,36 @@ namespace chisel
 
         virtual bool IsBrushEntity() const = 0;
 
-    // Public members
+        static bool IsKind(SelectableKind kind) { return kind == SelectableKind::PointEntity || kind == SelectableKind::BrushEntity; }
+
+        InternedString GetClassname() const { return m_classname; }
+        void SetClassname(InternedString classname);
+
+        InternedString GetTargetname() const { return m_targetname; }
+        void SetTargetname(InternedString targetname);
 
-        std::string classname;
-        std::string targetname;
+        // Call after editing kv, so the map's entity index picks up the change
+        void KeyValuesChanged();
+
+        // FGD class for the classname, null if the FGD doesn't know it.
+        // Resolved once per classname change or FGD load, then just a compare.
+        // Resolving writes the cache, so only the main thread may call it while it could be stale.
+        const FGD::Class* GetClass() const;
+
+    // Public members
 
         glm::vec3 origin;
 
         kv::KeyValues kv;
+
+    private:
+        friend class Map;
+        uint32_t m_mapIndex = 0; // Into Map::m_entities
+
+        InternedString m_classname;
+        InternedString m_targetname;
+        mutable const FGD::Class* m_class = nullptr;
+        mutable uint32_t m_classGeneration = 0; // FGD::generation m_class was resolved against, 0 if never
     };
 
     class PointEntity final : public Entity
@@ -34,6 +57,8 @@ namespace chisel
     public:
         PointEntity(BrushEntity* parent);
 
+        static bool IsKind(SelectableKind kind) { return kind == SelectableKind::PointEntity; }
+
     // Selectable Interface //
 
         std::optional<AABB> GetBounds() const final override;
@@ -51,6 +76,8 @@ namespace chisel
     public:
         BrushEntity(BrushEntity* parent);
 
+        static bool IsKind(SelectableKind kind) { return kind == SelectableKind::BrushEntity; }
+
     // Selectable Interface //
 
         std::optional<AABB> GetBounds() const final override;
@@ -68,14 +95,19 @@ namespace chisel
 
         auto Brushes() { return IteratorPassthru(m_solids); }
 
-        Solid& AddBrush(std::vector<Side> sides);
+        // Without initMesh, UpdateMesh the brush before it draws
+        Solid& AddBrush(std::vector<Side> sides, bool initMesh = true);
+
+        // Copy of a brush from any entity, reusing its built faces and meshes
+        Solid& CloneBrush(const Solid& source);
 
+        // O(1), the last brush takes the removed one's place in iteration order
         void RemoveBrush(const Solid& brush);
 
         std::optional<RayHit> QueryRay(const Ray& ray) const;
 
     protected:
 
-        std::list<Solid> m_solids;
+        Pool<Solid> m_solids;
     };
 }
\ No newline at end of file
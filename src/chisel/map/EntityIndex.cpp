@@ -0,0 +1,418 @@
+#include "chisel/map/EntityIndex.h"
+#include "chisel/map/Map.h"
+#include "chisel/Chisel.h"
+#include "chisel/Selection.h"
+#include "common/Profiler.h"
+#include "common/String.h"
+#include "console/ConCommand.h"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace chisel
+{
+    static char Lower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+    }
+
+    static std::string ToLower(std::string_view str)
+    {
+        std::string lower(str);
+        for (char& c : lower)
+            c = Lower(c);
+        return lower;
+    }
+
+    static bool IsPattern(std::string_view str)
+    {
+        return str.find_first_of("*?") != std::string_view::npos;
+    }
+
+    // Case-insensitive glob with * and ?
+    static bool GlobMatch(std::string_view pattern, std::string_view text)
+    {
+        size_t p = 0, t = 0;
+        size_t star = std::string_view::npos, resume = 0;
+        while (t < text.size())
+        {
+            if (p < pattern.size() && (pattern[p] == '?' || Lower(pattern[p]) == Lower(text[t])))
+            {
+                p++;
+                t++;
+            }
+            else if (p < pattern.size() && pattern[p] == '*')
+            {
+                star   = p++;
+                resume = t;
+            }
+            else if (star != std::string_view::npos)
+            {
+                p = star + 1;
+                t = ++resume;
+            }
+            else
+                return false;
+        }
+
+        while (p < pattern.size() && pattern[p] == '*')
+            p++;
+        return p == pattern.size();
+    }
+
+    // Target name of each output in the entity's connections block.
+    // Outputs are "target<sep>input<sep>param<sep>delay<sep>times", newer VMFs separate with ESC.
+    static void GatherOutputTargets(Entity& ent, std::vector<InternedString>& targets)
+    {
+        auto* connections = ent.kv.Find(std::string_view("connections"));
+        if (!connections || connections->GetType() != kv::Types::KeyValues)
+            return;
+
+        kv::KeyValues& outputs = *connections;
+        for (const auto& [output, value] : outputs)
+        {
+            std::string_view text = value;
+            char sep = text.find('\x1B') != std::string_view::npos ? '\x1B' : ',';
+            std::string_view target = text.substr(0, text.find(sep));
+            if (!target.empty())
+                targets.push_back(InternedString(target).Folded());
+        }
+    }
+
+    template <typename Table>
+    static void Unlink(Table& postings, const typename Table::key_type& key, Entity* ent)
+    {
+        auto it = postings.find(key);
+        if (it == postings.end())
+            return;
+
+        it->second.erase(ent);
+        if (it->second.empty())
+            postings.erase(it);
+    }
+
+    // Every posting of the map whose term matches the pattern. pattern is lowercase.
+    template <typename Table>
+    static void MatchPostings(const Table& postings, const std::string& pattern, std::vector<const std::unordered_set<Entity*>*>& out)
+    {
+        if (!IsPattern(pattern))
+        {
+            if constexpr (std::is_same_v<typename Table::key_type, InternedString>)
+            {
+                // Never interned means nothing is named that
+                auto key = InternedString::Find(pattern);
+                if (!key)
+                    return;
+                if (auto it = postings.find(*key); it != postings.end())
+                    out.push_back(&it->second);
+            }
+            else
+            {
+                if (auto it = postings.find(pattern); it != postings.end())
+                    out.push_back(&it->second);
+            }
+            return;
+        }
+
+        for (const auto& [term, posting] : postings)
+        {
+            if (GlobMatch(pattern, std::string_view(term)))
+                out.push_back(&posting);
+        }
+    }
+
+    bool EntityIndex::Term::Contains(Entity* ent) const
+    {
+        for (const Posting* posting : postings)
+        {
+            if (posting->contains(ent))
+                return true;
+        }
+        return false;
+    }
+
+    size_t EntityIndex::Term::Size() const
+    {
+        size_t size = 0;
+        for (const Posting* posting : postings)
+            size += posting->size();
+        return size;
+    }
+
+    void EntityIndex::Add(Entity& ent)
+    {
+        m_records[&ent] = Record();
+        m_dirty.push_back(&ent);
+    }
+
+    void EntityIndex::Remove(Entity& ent)
+    {
+        auto it = m_records.find(&ent);
+        if (it == m_records.end())
+            return;
+
+        // Dirty records were never indexed, and the pointer left in m_dirty finds no record
+        if (!it->second.dirty)
+            Unindex(ent, it->second);
+        m_records.erase(it);
+    }
+
+    void EntityIndex::Invalidate(Entity& ent)
+    {
+        auto it = m_records.find(&ent);
+        if (it == m_records.end() || it->second.dirty)
+            return;
+
+        Unindex(ent, it->second);
+        it->second.dirty = true;
+        m_dirty.push_back(&ent);
+    }
+
+    void EntityIndex::Clear()
+    {
+        m_records.clear();
+        m_dirty.clear();
+        m_classnames.clear();
+        m_targetnames.clear();
+        m_values.clear();
+        m_outputTargets.clear();
+    }
+
+    void EntityIndex::Refresh()
+    {
+        if (m_dirty.empty())
+            return;
+
+        PROFILE_ZONE("EntityIndex::Refresh");
+        for (Entity* ent : m_dirty)
+        {
+            // Pointers can repeat when a pool slot was reused
+            auto it = m_records.find(ent);
+            if (it == m_records.end() || !it->second.dirty)
+                continue;
+
+            Index(*ent, it->second);
+        }
+        m_dirty.clear();
+    }
+
+    void EntityIndex::Index(Entity& ent, Record& record)
+    {
+        record = Record();
+        record.dirty = false;
+
+        record.classname = ent.GetClassname().Folded();
+        m_classnames[record.classname].insert(&ent);
+
+        record.targetname = ent.GetTargetname().Folded();
+        if (!record.targetname.empty())
+            m_targetnames[record.targetname].insert(&ent);
+
+        for (const auto& [key, value] : ent.kv)
+        {
+            if (value.GetType() == kv::Types::KeyValues)
+                continue;
+
+            auto& entry = record.values.emplace_back(key.Folded(), ToLower(std::string_view(value)));
+            m_values[entry.first][entry.second].insert(&ent);
+        }
+
+        GatherOutputTargets(ent, record.outputTargets);
+        for (const InternedString& target : record.outputTargets)
+            m_outputTargets[target].insert(&ent);
+    }
+
+    void EntityIndex::Unindex(Entity& ent, Record& record)
+    {
+        Unlink(m_classnames, record.classname, &ent);
+        if (!record.targetname.empty())
+            Unlink(m_targetnames, record.targetname, &ent);
+
+        for (const auto& [key, value] : record.values)
+        {
+            auto it = m_values.find(key);
+            if (it == m_values.end())
+                continue;
+
+            Unlink(it->second, value, &ent);
+            if (it->second.empty())
+                m_values.erase(it);
+        }
+
+        for (const InternedString& target : record.outputTargets)
+            Unlink(m_outputTargets, target, &ent);
+    }
+
+    EntityIndex::Term EntityIndex::Match(std::string_view key, std::string_view patterns)
+    {
+        Term term;
+        InternedString field = key.empty() ? InternedString() : InternedString::FindFolded(key).value_or(InternedString());
+
+        size_t start = 0;
+        while (start <= patterns.size())
+        {
+            size_t end = std::min(patterns.find(',', start), patterns.size());
+            std::string pattern = ToLower(patterns.substr(start, end - start));
+            start = end + 1;
+
+            if (key.empty())
+            {
+                MatchPostings(m_classnames, pattern, term.postings);
+                MatchPostings(m_targetnames, pattern, term.postings);
+            }
+            else if (field == "classname")
+                MatchPostings(m_classnames, pattern, term.postings);
+            else if (field == "targetname")
+                MatchPostings(m_targetnames, pattern, term.postings);
+            else if (auto it = m_values.find(field); !field.empty() && it != m_values.end())
+                MatchPostings(it->second, pattern, term.postings);
+        }
+        return term;
+    }
+
+    std::vector<Entity*> EntityIndex::Query(std::string_view query)
+    {
+        PROFILE_ZONE("EntityIndex::Query");
+        Refresh();
+
+        std::vector<Term> terms;
+        for (std::string_view token : str::split(query))
+        {
+            if (token.empty())
+                continue;
+
+            bool exclude = token[0] == '-';
+            if (exclude)
+                token.remove_prefix(1);
+
+            size_t eq = token.find('=');
+            Term& term = terms.emplace_back(eq == std::string_view::npos
+                ? Match({}, token)
+                : Match(token.substr(0, eq), token.substr(eq + 1)));
+            term.exclude = exclude;
+        }
+
+        // Walk the smallest set that must match, and check the rest against it
+        const Term* smallest = nullptr;
+        for (const Term& term : terms)
+        {
+            if (!term.exclude && (!smallest || term.Size() < smallest->Size()))
+                smallest = &term;
+        }
+
+        std::vector<Entity*> results;
+        auto Test = [&](Entity* ent)
+        {
+            for (const Term& term : terms)
+            {
+                if (&term != smallest && term.Contains(ent) == term.exclude)
+                    return;
+            }
+            results.push_back(ent);
+        };
+
+        if (!smallest)
+        {
+            for (auto& [ent, record] : m_records)
+                Test(ent);
+            return results;
+        }
+
+        // A wildcard can hit several postings holding the same entity
+        std::unordered_set<Entity*> seen;
+        for (const Posting* posting : smallest->postings)
+        {
+            for (Entity* ent : *posting)
+            {
+                if (smallest->postings.size() == 1 || seen.insert(ent).second)
+                    Test(ent);
+            }
+        }
+        return results;
+    }
+
+    std::vector<Entity*> EntityIndex::OutputTargets(Entity& ent)
+    {
+        Refresh();
+
+        auto it = m_records.find(&ent);
+        if (it == m_records.end())
+            return {};
+
+        Term term;
+        for (const InternedString& target : it->second.outputTargets)
+            MatchPostings(m_targetnames, target.str(), term.postings);
+
+        std::unordered_set<Entity*> targets;
+        for (const Posting* posting : term.postings)
+            targets.insert(posting->begin(), posting->end());
+        return std::vector<Entity*>(targets.begin(), targets.end());
+    }
+
+    std::vector<Entity*> EntityIndex::OutputSources(Entity& ent)
+    {
+        Refresh();
+
+        auto it = m_records.find(&ent);
+        if (it == m_records.end() || it->second.targetname.empty())
+            return {};
+
+        std::string_view name = it->second.targetname;
+        std::unordered_set<Entity*> sources;
+        for (const auto& [target, posting] : m_outputTargets)
+        {
+            bool match = IsPattern(target) ? GlobMatch(target, name) : target == it->second.targetname;
+            if (match)
+                sources.insert(posting.begin(), posting.end());
+        }
+        return std::vector<Entity*>(sources.begin(), sources.end());
+    }
+}
+
+namespace chisel::commands
+{
+    static std::string JoinArgs(ConCmd& cmd)
+    {
+        std::string query;
+        for (std::string_view arg : cmd)
+        {
+            if (!query.empty())
+                query += ' ';
+            query += arg;
+        }
+        return query;
+    }
+
+    static ConCommand find_entities("find_entities", "List entities matching a query, e.g. find_entities classname=prop_* targetname=door_*", [](ConCmd& cmd)
+    {
+        auto results = Chisel.map.Index().Query(JoinArgs(cmd));
+        for (size_t i = 0; i < std::min<size_t>(results.size(), 64); i++)
+            Console.Log("  {} '{}'", results[i]->GetClassname().view(), results[i]->GetTargetname().view());
+        Console.Log("{} of {} entities match", results.size(), Chisel.map.Index().Count());
+    });
+
+    static ConCommand select_matching("select_matching", "Select the entities matching a query, see find_entities", [](ConCmd& cmd)
+    {
+        auto results = Chisel.map.Index().Query(JoinArgs(cmd));
+        std::vector<Selectable*> selectables(results.begin(), results.end());
+        Selection.Clear();
+        Selection.SelectMany(selectables);
+        Console.Log("Selected {} entities", selectables.size());
+    });
+
+    static ConCommand ent_io("ent_io", "Print what the selected entities' outputs fire at, and what fires at them", []()
+    {
+        for (Selectable* selectable : Selection)
+        {
+            Entity* ent = selectable->As<Entity>();
+            if (!ent)
+                continue;
+
+            Console.Log("{} '{}'", ent->GetClassname().view(), ent->GetTargetname().view());
+            for (Entity* target : Chisel.map.Index().OutputTargets(*ent))
+                Console.Log("  -> {} '{}'", target->GetClassname().view(), target->GetTargetname().view());
+            for (Entity* source : Chisel.map.Index().OutputSources(*ent))
+                Console.Log("  <- {} '{}'", source->GetClassname().view(), source->GetTargetname().view());
+        }
+    });
+}
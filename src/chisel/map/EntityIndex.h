@@ -0,0 +1,78 @@
+#pragma once
+
+#include "common/Intern.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chisel
+{
+    class Entity;
+
+    // Inverted index over entity classnames, targetnames, key/value pairs and output targets.
+    // Edits only mark an entity dirty, it is reindexed by the next query.
+    // Everything is matched case-insensitively, like the engine does.
+    class EntityIndex
+    {
+    public:
+        void Add(Entity& ent);
+        void Remove(Entity& ent);
+        void Invalidate(Entity& ent);
+        void Clear();
+
+        // Entities matching every space separated term of the query:
+        //   classname=prop_*          key=pattern, * and ? wildcards
+        //   rendermode=1,2            any of several patterns
+        //   -targetname=door_*        exclude matches
+        //   door_*                    no key matches classname or targetname
+        std::vector<Entity*> Query(std::string_view query);
+
+        // I/O graph. Entities ent's outputs fire at, and entities with outputs firing at ent.
+        std::vector<Entity*> OutputTargets(Entity& ent);
+        std::vector<Entity*> OutputSources(Entity& ent);
+
+        size_t Count() const { return m_records.size(); }
+
+    private:
+        using Posting = std::unordered_set<Entity*>;
+        using Postings = std::unordered_map<InternedString, Posting>; // By lowercase name
+        using ValuePostings = std::unordered_map<std::string, Posting>; // Values are too varied to intern
+
+        // What an entity was indexed under, so it can be taken out again
+        struct Record
+        {
+            InternedString classname;
+            InternedString targetname;
+            std::vector<std::pair<InternedString, std::string>> values;
+            std::vector<InternedString> outputTargets;
+            bool dirty = true;
+        };
+
+        // One term of a query, matching entities in any of its postings
+        struct Term
+        {
+            std::vector<const Posting*> postings;
+            bool exclude = false;
+
+            bool Contains(Entity* ent) const;
+            size_t Size() const;
+        };
+
+        void Refresh();
+        void Index(Entity& ent, Record& record);
+        void Unindex(Entity& ent, Record& record);
+
+        Term Match(std::string_view key, std::string_view patterns);
+
+        std::unordered_map<Entity*, Record> m_records;
+        std::vector<Entity*>                m_dirty;
+
+        Postings                                          m_classnames;
+        Postings                                          m_targetnames;
+        std::unordered_map<InternedString, ValuePostings> m_values;        // By lowercase key, then lowercase value
+        Postings                                          m_outputTargets; // Target names of outputs, may be wildcards
+    };
+}
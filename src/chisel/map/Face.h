@@ -62,15 +62,20 @@ namespace chisel
 
     struct Face : public Selectable
     {
-        Face(Solid* brush, uint sideIdx, Side* side, std::vector<vec3> pts)
-            : solid(brush)
+        // id belongs to the solid's side, so it survives the face being rebuilt
+        Face(Solid* brush, uint sideIdx, Side* side, SelectionID id, std::vector<vec3> pts)
+            : Selectable(id)
+            , solid(brush)
             , side(side)
             , points(std::move(pts))
             , sideIdx(sideIdx)
         {
+            SetKind(SelectableKind::Face);
             UpdateBounds();
         }
 
+        static bool IsKind(SelectableKind kind) { return kind == SelectableKind::Face; }
+
         Face(Face&& other) = default;
         Face(const Face& other) = default;
         Face& operator=(const Face& other) = default;
@@ -82,6 +87,7 @@ namespace chisel
         uint meshIdx = 0;
         uint startIndex = 0;
         uint sideIdx = 0;
+        bool meshSelected = false; // Marked selected in its mesh's BrushFace attributes
 
         uint GetVertexCount() const { return points.size(); }
         uint GetIndexCount() const { return (GetVertexCount() - 2) * 3; }
@@ -20,9 +20,12 @@ namespace chisel
     void Map::Clear()
     {
         m_solids.clear();
-        for (Entity* ent : m_entities)
-            delete ent;
+        m_index.Clear();
         m_entities.clear();
+        m_pointEntities.clear();
+        m_brushEntities.clear();
+        m_actions.Clear();
+        Touch();
     }
 
     bool Map::IsMap()
@@ -30,29 +33,45 @@ namespace chisel
         return true;
     }
 
-    PointEntity* Map::AddPointEntity(const char* classname)
+    PointEntity* Map::AddPointEntity(InternedString classname)
     {
-        PointEntity* ent = new PointEntity(this);
-        ent->classname = classname;
-        m_entities.push_back(ent);
-        return ent;
+        PointEntity& ent = m_pointEntities.emplace(this);
+        m_actions.Created(ent);
+        ent.SetClassname(classname);
+        ent.m_mapIndex = uint32_t(m_entities.size());
+        m_entities.push_back(&ent);
+        m_index.Add(ent);
+        Touch();
+        return &ent;
     }
 
-    void Map::AddEntity(Entity* entity)
+    BrushEntity* Map::AddBrushEntity(InternedString classname)
     {
-        // CHANGE ME
-        m_entities.push_back(entity);
+        BrushEntity& ent = m_brushEntities.emplace(this);
+        m_actions.Created(ent);
+        ent.SetClassname(classname);
+        ent.m_mapIndex = uint32_t(m_entities.size());
+        m_entities.push_back(&ent);
+        m_index.Add(ent);
+        Touch();
+        return &ent;
     }
 
     void Map::RemoveEntity(Entity& entity)
     {
-        // SUCKS
-        m_entities.erase(std::remove_if(m_entities.begin(),
-            m_entities.end(),
-            [&](Entity* a)-> bool
-            { return a == &entity; }),
-            m_entities.end());
+        assert(m_entities[entity.m_mapIndex] == &entity);
+        m_actions.Deleting(entity);
 
-        delete &entity;
+        Entity* last = m_entities.back();
+        m_entities[entity.m_mapIndex] = last;
+        last->m_mapIndex = entity.m_mapIndex;
+        m_entities.pop_back();
+        m_index.Remove(entity);
+
+        if (entity.IsBrushEntity())
+            m_brushEntities.erase(static_cast<BrushEntity&>(entity));
+        else
+            m_pointEntities.erase(static_cast<PointEntity&>(entity));
+        Touch();
     }
 }
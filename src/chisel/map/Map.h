@@ -1,9 +1,10 @@
 #pragma once
 
-#include <list>
-
 #include "Entity.h"
 #include "Action.h"
+#include "WorldChunks.h"
+#include "EntityIndex.h"
+#include "WorldOccluders.h"
 
 namespace chisel
 {
@@ -22,18 +23,41 @@ namespace chisel
 
         bool IsMap() final override;
 
-        PointEntity* AddPointEntity(const char* classname);
+        PointEntity* AddPointEntity(InternedString classname);
+        BrushEntity* AddBrushEntity(InternedString classname);
 
-        void AddEntity(Entity *entity);
+        // O(1), the last entity takes the removed one's place in iteration order
         void RemoveEntity(Entity& entity);
 
+        // Every entity, as Entity*
         auto Entities() { return IteratorPassthru(m_entities); }
+
+        // Just one kind, contiguous in its pool. Passes that care about one kind walk these.
+        auto PointEntities() { return IteratorPassthru(m_pointEntities); }
+        auto BrushEntities() { return IteratorPassthru(m_brushEntities); }
         ActionList& Actions() { return m_actions; }
+        EntityIndex& Index() { return m_index; }
+        WorldChunks& Chunks() { return m_chunks; }
+        WorldOccluders& Occluders() { return m_occluders; }
+
+        // Bumped by every edit that changes how the map looks
+        uint64_t Revision() const { return m_revision; }
+        void Touch()
+        {
+            m_revision++;
+            Selection.Touch();
+        }
 
     private:
-        // TODO: Polymorphic linked list
+        // Storage per kind, and every entity of any kind for iteration
+        Pool<PointEntity>    m_pointEntities;
+        Pool<BrushEntity>    m_brushEntities;
         std::vector<Entity*> m_entities;
+        EntityIndex          m_index;
 
         ActionList m_actions;
+        WorldChunks m_chunks;
+        WorldOccluders m_occluders;
+        uint64_t m_revision = 0;
     };
 }
\ No newline at end of file
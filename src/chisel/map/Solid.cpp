@@ -1,9 +1,11 @@
 #include "chisel/map/Solid.h"
 #include "chisel/Chisel.h"
 #include "common/Bit.h"
+#include "common/Parallel.h"
+#include "common/Profiler.h"
 #include "math/Winding.h"
 
-#include <unordered_set>
+#include <algorithm>
 
 namespace chisel
 {
@@ -18,15 +20,63 @@ namespace chisel
     ConVar<bool> r_displacements("r_displacements", true, "Render displacements", RebuildDisplacements);
     ConVar<bool> r_disp_mask_solid("r_disp_mask_solid", true, "Hide unused faces of displacement brushes", RebuildDisplacements);
 
+    static ConVar<int> brush_threads("brush_threads", 0, "Threads transforming and remeshing brushes in large edits. 0 uses every core, 1 runs on the main thread only");
+
+    // The parts of a transform that are the same for every side, worked out once for a batch
+    struct Solid::SideTransform
+    {
+        mat4x4 matrix;
+        mat3x3 normalMatrix;
+        mat3x3 linear;      // Without the translation
+        vec3   delta;
+        bool   moving;
+        bool   translation; // Moves without rotating or scaling
+        bool   locking;
+        bool   scaleLocking;
+
+        explicit SideTransform(const mat4x4& m)
+            : matrix(m)
+            , normalMatrix(Plane::NormalMatrix(m))
+            , linear(m)
+            , delta(vec3(m[3]))
+            , locking(trans_texture_lock)
+            , scaleLocking(trans_texture_scale_lock)
+        {
+            mat4x4 trans = m;
+            trans[3] = vec4(0.0f, 0.0f, 0.0f, m[3].w);
+
+            moving      = glm::length2(delta) > 0.00001f;
+            translation = trans == glm::identity<mat4x4>();
+        }
+    };
+
+    static Map& MapOf(BrushEntity* parent)
+    {
+        // Solids belong to the map or to one of its entities
+        return *static_cast<Map*>(parent->IsMap() ? parent : parent->GetParent());
+    }
+
+    // Merged cells and occluders follow the solid's geometry. Only the world's solids occlude.
+    static void GeometryChanged(Solid& solid, BrushEntity* parent)
+    {
+        Map& map = MapOf(parent);
+        map.Chunks().Invalidate(solid);
+        if (parent->IsMap())
+            map.Occluders().Invalidate(solid);
+    }
+
     Solid::Solid(BrushEntity* parent)
         : Atom(parent)
     {
+        SetKind(SelectableKind::Solid);
     }
 
     Solid::Solid(BrushEntity* parent, std::vector<Side> sides, bool initMesh)
         : Atom(parent)
         , m_sides(std::move(sides))
     {
+        SetKind(SelectableKind::Solid);
+
         // Check if this brush has displacements
         for (Side& side : m_sides)
         {
@@ -41,35 +91,194 @@ namespace chisel
             UpdateMesh();
     }
 
+    Solid::Solid(BrushEntity* parent, const Solid& source)
+        : Atom(parent)
+        , m_displacement(source.m_displacement)
+        , m_sides(source.m_sides)
+        , m_bounds(source.m_bounds)
+    {
+        PROFILE_ZONE("Solid::Clone");
+        SetKind(SelectableKind::Solid);
+        Chisel.map.Touch();
+
+        Selectable::ReserveIDs(uint32_t(m_sides.size()), m_sideIDs);
+
+        // Same windings and layout, under this solid's sides and IDs
+        m_faces.reserve(source.m_faces.size());
+        for (const Face& other : source.m_faces)
+        {
+            Face& face = m_faces.emplace_back(this, other.sideIdx, &m_sides[other.sideIdx], m_sideIDs[other.sideIdx], other.points);
+            face.meshIdx    = other.meshIdx;
+            face.startIndex = other.startIndex;
+        }
+
+        m_meshes.resize(source.m_meshes.size());
+        for (uint32_t i = 0; i < m_meshes.size(); i++)
+        {
+            const BrushMesh& other = source.m_meshes[i];
+            BrushMesh& mesh  = m_meshes[i];
+            mesh.vertexCount = other.vertexCount;
+            mesh.indexCount  = other.indexCount;
+            mesh.faceCount   = other.faceCount;
+            mesh.material    = other.material;
+            mesh.brush       = this;
+            mesh.dispPower   = other.dispPower;
+            mesh.bounds      = other.bounds;
+        }
+
+        // The GPU copy is write-only, so the vertices come from the copied faces.
+        // Their face attributes pick up the new IDs.
+        thread_local std::vector<BrushMeshData> scratch;
+        GenerateMeshData(scratch);
+
+        BrushGPUAllocator& a = *Chisel.brushAllocator;
+        a.open();
+        for (uint32_t i = 0; i < m_meshes.size(); i++)
+            UploadMesh(a, m_meshes[i], scratch[i]);
+        a.close();
+
+        GeometryChanged(*this, m_parent);
+    }
+
     Solid::Solid(Solid&& other)
         : Atom(other.m_parent)
     {
+        SetKind(SelectableKind::Solid);
         this->m_displacement = other.m_displacement;
         this->m_meshes = std::move(other.m_meshes);
         this->m_sides = std::move(other.m_sides);
         this->m_faces = std::move(other.m_faces);
+        this->m_sideIDs = std::move(other.m_sideIDs);
         this->m_bounds = other.m_bounds;
 
         for (auto& face : m_faces)
             face.solid = this;
+
+        GeometryChanged(*this, m_parent);
     }
         
     Solid::~Solid()
     {
+        Map& map = MapOf(m_parent);
+        map.Chunks().Remove(*this);
+        map.Occluders().Remove(*this);
+
+        for (SelectionID id : m_sideIDs)
+            Selectable::ReleaseID(id);
     }
 
     void Solid::Clip(Side side)
     {
+        Chisel.map.Actions().Modify(*this);
         m_sides.emplace_back(std::move(side));
     }
 
+    void Solid::ReplaceSides(uint32_t first, uint32_t count, std::span<const Side> sides)
+    {
+        auto at = m_sides.erase(m_sides.begin() + first, m_sides.begin() + first + count);
+        m_sides.insert(at, sides.begin(), sides.end());
+
+        m_displacement = std::any_of(m_sides.begin(), m_sides.end(), [](const Side& side) { return side.disp.has_value(); });
+    }
+
+    void Solid::UpdateMeshes(std::span<Solid* const> solids)
+    {
+        PROFILE_ZONE("Solid::UpdateMeshes");
+        Remesh(solids, nullptr);
+    }
+
+    void Solid::TransformMany(std::span<Solid* const> solids, const mat4x4& matrix)
+    {
+        PROFILE_ZONE("Solid::TransformMany");
+
+        // Undo records are taken here, before anything moves
+        ActionList& actions = Chisel.map.Actions();
+        for (Solid* solid : solids)
+            actions.Modify(*solid);
+
+        SideTransform transform(matrix);
+        Remesh(solids, &transform);
+    }
+
+    void Solid::UpdateSelectedFaces(std::span<const SelectionID> changes)
+    {
+        thread_local std::vector<Solid*> solids;
+        solids.clear();
+        for (SelectionID id : changes)
+        {
+            Selectable* object = Selection.Find(id);
+            Face* face = object ? object->As<Face>() : nullptr;
+            if (face && face->solid && face->IsSelected() != face->meshSelected)
+                solids.push_back(face->solid);
+        }
+
+        if (solids.empty())
+            return;
+
+        PROFILE_ZONE("Solid::UpdateSelectedFaces");
+
+        std::sort(solids.begin(), solids.end());
+        solids.erase(std::unique(solids.begin(), solids.end()), solids.end());
+        Remesh(solids, nullptr);
+    }
+
+    void Solid::Remesh(std::span<Solid* const> solids, const SideTransform* transform)
+    {
+        // Scratch for each solid of a batch, kept so drags don't reallocate every frame.
+        // Batches are capped to bound how much of it stays around.
+        struct Job
+        {
+            bit::bitvector             selectedSides;
+            std::vector<BrushMeshData> data;
+        };
+        static constexpr size_t BatchSize = 1024;
+        static std::vector<Job> jobs;
+
+        BrushGPUAllocator& a = *Chisel.brushAllocator;
+        a.open();
+        for (size_t first = 0; first < solids.size(); first += BatchSize)
+        {
+            std::span<Solid* const> batch = solids.subspan(first, std::min(BatchSize, solids.size() - first));
+            if (jobs.size() < batch.size())
+                jobs.resize(batch.size());
+
+            for (size_t i = 0; i < batch.size(); i++)
+                batch[i]->BeginRemesh(jobs[i].selectedSides);
+
+            Workers.ParallelFor(batch.size(), uint(std::max(int(brush_threads), 0)), [&](size_t i)
+            {
+                if (transform)
+                    batch[i]->TransformSides(*transform);
+                batch[i]->BuildMesh(jobs[i].data, jobs[i].selectedSides);
+            });
+
+            for (size_t i = 0; i < batch.size(); i++)
+                batch[i]->FinishRemesh(a, jobs[i].data, jobs[i].selectedSides);
+        }
+        a.close();
+    }
+
     void Solid::UpdateMesh()
     {
-        static bit::bitvector shouldUse;
-        static bit::bitvector sideSelected;
-        static std::unordered_set<AssetID> uniqueMaterials;
+        PROFILE_ZONE("Solid::UpdateMesh");
+
+        // Geometry goes to per-thread scratch, it is not kept after upload.
+        thread_local bit::bitvector selectedSides;
+        thread_local std::vector<BrushMeshData> scratch;
+
+        BeginRemesh(selectedSides);
+        BuildMesh(scratch, selectedSides);
 
         BrushGPUAllocator& a = *Chisel.brushAllocator;
+        a.open();
+        FinishRemesh(a, scratch, selectedSides);
+        a.close();
+    }
+
+    void Solid::BeginRemesh(bit::bitvector& selectedSides)
+    {
+        BrushGPUAllocator& a = *Chisel.brushAllocator;
+        Chisel.map.Touch();
 
         // TODO: Avoid clearing meshes out every time.
         for (auto& mesh : m_meshes)
@@ -81,38 +290,47 @@ namespace chisel
             }
         }
 
-        uniqueMaterials.clear();
-        uniqueMaterials.reserve(m_sides.size());
         m_meshes.clear();
-        m_meshes.reserve(m_sides.size());
-        shouldUse.clearAll();
-        shouldUse.ensureSize(m_sides.size());
 
-        bool displacement = r_displacements && HasDisplacement();
-
-        sideSelected.clearAll();
-        sideSelected.ensureSize(m_sides.size());
+        // Faces are rebuilt, remember which sides had theirs selected
+        selectedSides.clearAll();
+        selectedSides.ensureSize(m_sides.size());
         for (uint32_t i = 0; i < m_faces.size(); i++)
         {
             if (m_faces[i].IsSelected())
             {
-                sideSelected.set(m_faces[i].sideIdx, true);
+                selectedSides.set(m_faces[i].sideIdx, true);
             }
         }
         m_faces.clear();
         m_faces.reserve(m_sides.size());
 
+        // Faces keep their side's ID across remeshes, so picks in flight and the GPU ID buffers stay valid
+        while (m_sideIDs.size() > m_sides.size())
+        {
+            Selectable::ReleaseID(m_sideIDs.back());
+            m_sideIDs.pop_back();
+        }
+        if (m_sideIDs.size() < m_sides.size())
+            Selectable::ReserveIDs(uint32_t(m_sides.size() - m_sideIDs.size()), m_sideIDs);
+    }
+
+    void Solid::BuildMesh(std::vector<BrushMeshData>& data, const bit::bitvector& selectedSides)
+    {
+        PROFILE_ZONE("Solid::BuildMesh");
+
+        thread_local bit::bitvector shouldUse;
+        shouldUse.clearAll();
+        shouldUse.ensureSize(m_sides.size());
+
+        bool displacement = r_displacements && HasDisplacement();
+
         for (uint32_t i = 0; i < m_sides.size(); i++)
         {
             // Displacements: exclude unused sides
             if (displacement && r_disp_mask_solid && !m_sides[i].disp.has_value())
                 continue;
 
-            AssetID id = InvalidAssetID;
-            if (m_sides[i].material != nullptr)
-                id = m_sides[i].material->id;
-            uniqueMaterials.insert(id);
-
             glm::vec3 normal0 = m_sides[i].plane.normal;
             float dist0 = m_sides[i].plane.Dist();
             if (normal0 == glm::vec3(0.0f))
@@ -196,26 +414,161 @@ namespace chisel
                     }
 #endif
                     
-                    auto& face = m_faces.emplace_back(this, sideIdx, &side, std::vector<vec3>(currentWinding->points, currentWinding->points + currentWinding->count));
-                    if (sideSelected.get(sideIdx))
-                        Selection.Select(&face);
+                    Face& face = m_faces.emplace_back(this, sideIdx, &side, m_sideIDs[sideIdx], std::vector<vec3>(currentWinding->points, currentWinding->points + currentWinding->count));
+
+                    // Selected again by FinishRemesh, the mesh can mark it already
+                    face.meshSelected = selectedSides.get(sideIdx);
                 }
             }
         }
 
-        if (displacement)
-            m_meshes.resize(m_faces.size());
-        else
-            m_meshes.resize(uniqueMaterials.size());
+        // Lay out faces into meshes: one per displacement face, otherwise one per material,
+        // with another one started whenever a material runs out of 16-bit indices.
+        thread_local std::vector<AssetID> meshMaterials;
+        thread_local std::vector<uint32_t> meshIndexCounts;
+        thread_local std::vector<uint32_t> meshVertexCounts;
+        meshMaterials.clear();
+        meshIndexCounts.clear();
+        meshVertexCounts.clear();
+
+        for (uint32_t i = 0; i < m_faces.size(); i++)
+        {
+            Face& face = m_faces[i];
+            if (displacement)
+            {
+                face.meshIdx = i;
+                face.startIndex = 0;
+                meshIndexCounts.push_back(0);
+                continue;
+            }
 
+            AssetID id = InvalidAssetID;
+            if (face.side->material != nullptr)
+                id = face.side->material->id;
+
+            uint32_t numVertices = face.GetVertexCount() >= 3 ? face.GetVertexCount() : 0;
+
+            // The material's newest mesh, if its indices still reach this face's vertices
+            auto it = std::find(meshMaterials.rbegin(), meshMaterials.rend(), id);
+            face.meshIdx = uint(meshMaterials.rend() - it) - 1;
+            if (it == meshMaterials.rend() || meshVertexCounts[face.meshIdx] + numVertices > MaxBrushMeshVertices)
+            {
+                face.meshIdx = uint(meshMaterials.size());
+                meshMaterials.push_back(id);
+                meshIndexCounts.push_back(0);
+                meshVertexCounts.push_back(0);
+            }
+
+            face.startIndex = meshIndexCounts[face.meshIdx];
+            if (numVertices)
+            {
+                meshIndexCounts[face.meshIdx]  += face.GetIndexCount();
+                meshVertexCounts[face.meshIdx] += numVertices;
+            }
+        }
+
+        m_meshes.resize(meshIndexCounts.size());
         m_bounds = std::nullopt;
 
-        uint faceIdx = 0;
+        GenerateMeshData(data);
+
+        for (uint32_t i = 0; i < m_meshes.size(); i++)
+        {
+            const BrushMeshData& meshData = data[i];
+            BrushMesh& mesh = m_meshes[i];
+            mesh.vertexCount = uint32_t(meshData.vertices.size());
+            mesh.indexCount  = uint32_t(meshData.indices.size());
+            mesh.faceCount   = uint32_t(meshData.faces.size());
+            mesh.material    = meshData.material;
+            mesh.brush       = this;
+            mesh.dispPower   = meshData.dispPower;
+            mesh.bounds      = meshData.bounds;
+
+            if (!meshData.vertices.empty())
+            {
+                m_bounds = m_bounds
+                    ? AABB::Extend(*m_bounds, meshData.bounds)
+                    : meshData.bounds;
+            }
+        }
+    }
+
+    void Solid::FinishRemesh(BrushGPUAllocator& a, const std::vector<BrushMeshData>& data, const bit::bitvector& selectedSides)
+    {
+        // Upload all meshes after they're complete
+        for (uint32_t i = 0; i < m_meshes.size(); i++)
+            UploadMesh(a, m_meshes[i], data[i]);
+
+        for (Face& face : m_faces)
+        {
+            if (selectedSides.get(face.sideIdx))
+                Selection.Select(&face);
+        }
+
+        GeometryChanged(*this, m_parent);
+    }
+
+    void Solid::UploadMesh(BrushGPUAllocator& a, BrushMesh& mesh, const BrushMeshData& data)
+    {
+        uint32_t verticesSize = mesh.VerticesSize();
+        uint32_t indicesSize = mesh.IndicesSize();
+        uint32_t facesSize = mesh.FacesSize();
+        mesh.alloc = a.alloc(verticesSize + indicesSize + facesSize);
+
+        // Store vertices, then indices, then face attributes.
+        uint8_t* dst = a.data(*mesh.alloc);
+        memcpy(dst,                              data.vertices.data(), verticesSize);
+        memcpy(dst + verticesSize,               data.indices.data(),  sizeof(BrushIndex) * data.indices.size());
+        memcpy(dst + verticesSize + indicesSize, data.faces.data(),    facesSize);
+    }
+
+    uint32_t Solid::RelocateMeshes(uint32_t page)
+    {
+        bool any = false;
+        for (auto& mesh : m_meshes)
+            any |= mesh.alloc && mesh.alloc->page == page;
+
+        if (!any)
+            return 0;
+
+        // The GPU copy is write-only, so regenerate the geometry to move it.
+        thread_local std::vector<BrushMeshData> scratch;
+        GenerateMeshData(scratch);
+
+        BrushGPUAllocator& a = *Chisel.brushAllocator;
+        uint32_t moved = 0;
+
+        a.open();
+        for (uint32_t i = 0; i < m_meshes.size(); i++)
+        {
+            BrushMesh& mesh = m_meshes[i];
+            if (!mesh.alloc || mesh.alloc->page != page)
+                continue;
+
+            BrushGPUAllocator::Allocation old = *mesh.alloc;
+            UploadMesh(a, mesh, scratch[i]);
+            a.free(old);
+            moved++;
+        }
+        a.close();
+
+        return moved;
+    }
 
-        static DispInfo dispDefault = DispInfo(0);
+    void Solid::GenerateMeshData(std::vector<BrushMeshData>& meshes)
+    {
+        bool displacement = r_displacements && HasDisplacement();
+
+        // Reuse the caller's buffers where possible
+        if (meshes.size() < m_meshes.size())
+            meshes.resize(m_meshes.size());
+        for (uint i = 0; i < m_meshes.size(); i++)
+            meshes[i].Clear();
+
+        thread_local DispInfo dispDefault = DispInfo(0);
 
         // Create mesh from faces
-        for (auto& face : m_faces)
+        for (const Face& face : m_faces)
         {
             auto ComputeUV = [&](vec3 pos) {
                 float mappingWidth = 32.0f;
@@ -247,7 +600,6 @@ namespace chisel
                 uint numVertices = disp.verts.size();
                 int length = disp.length;
                 int numSlices = length - 1;
-                uint numIndices = disp.GetIndexCount();
 
                 disp.UpdatePointStartIndex(face.points);
 
@@ -255,11 +607,11 @@ namespace chisel
                 edgeInt[0] = (face.points[(1 + disp.pointStartIndex) % 4] - face.points[(0 + disp.pointStartIndex) % 4]) / float(length - 1);
                 edgeInt[1] = (face.points[(2 + disp.pointStartIndex) % 4] - face.points[(3 + disp.pointStartIndex) % 4]) / float(length - 1);
 
-                auto& mesh = m_meshes[faceIdx];
+                auto& mesh = meshes[face.meshIdx];
                 mesh.material = face.side->material.ptr();
-                mesh.brush = this;
+                mesh.dispPower = disp.power;
                 mesh.vertices.reserve(numVertices);
-                mesh.indices.reserve(numIndices);
+                mesh.faces.push_back(BrushFace { face.side->plane.normal, face.GetSelectionID() | (face.meshSelected ? BrushFaceSelected : 0u) });
 
                 for (uint y = 0; y < length; y++)
                 {
@@ -290,50 +642,20 @@ namespace chisel
                         pos += vert.normal * vert.dist;
 
                         // Extend bounds
-                        m_bounds = m_bounds
-                            ? AABB::Extend(*m_bounds, pos)
-                            : AABB { pos, pos };
+                        mesh.bounds = mesh.vertices.empty()
+                            ? AABB { pos, pos }
+                            : mesh.bounds.Extend(pos);
 
                         mesh.vertices.emplace_back(VertexSolid {
-                            pos,
-                            face.side->plane.normal,
-                            vec3(uv, vert.alpha / 255.f),
-                            face.GetSelectionID()
+                            .position = pos,
+                            .uv       = uv,
+                            .face     = 0,
+                            .alpha    = uint8_t(glm::clamp(vert.alpha, 0.0f, 255.0f) + 0.5f),
                         });
                     }
                 }
 
-                for (uint y = 0; y < numSlices; y++)
-                {
-                    for (uint x = 0; x < numSlices; x++)
-                    {
-                        bool even = (y * length + x) % 2 == 0;
-                        if (!even)
-                        {
-                            // 1, 2, 0 (clockwise from bottom left)
-                            mesh.indices.push_back(y * length + x);
-                            mesh.indices.push_back(y * length + x + 1);
-                            mesh.indices.push_back((y + 1) * length + x);
-
-                            // 3, 0, 2
-                            mesh.indices.push_back((y + 1) * length + x + 1);
-                            mesh.indices.push_back((y + 1) * length + x);
-                            mesh.indices.push_back(y * length + x + 1);
-                        }
-                        else
-                        {
-                            // 1, 0, 3
-                            mesh.indices.push_back((y + 1) * length + x + 1);
-                            mesh.indices.push_back((y + 1) * length + x);
-                            mesh.indices.push_back(y * length + x);
-
-                            // 3, 2, 1
-                            mesh.indices.push_back(y * length + x);
-                            mesh.indices.push_back(y * length + x + 1);
-                            mesh.indices.push_back((y + 1) * length + x + 1);
-                        }
-                    }
-                }
+                // Indices come from the shared per-power DispIndexBuffer.
             }
             else // regular brush
             {
@@ -342,35 +664,36 @@ namespace chisel
                     continue;
                 const uint32_t numIndices = face.GetIndexCount();
 
-                AssetID id = InvalidAssetID;
-                if (face.side->material != nullptr)
-                    id = face.side->material->id;
-
-                uint32_t meshIdx = std::distance(uniqueMaterials.begin(), uniqueMaterials.find(id));
-                auto& mesh = m_meshes[meshIdx];
+                auto& mesh = meshes[face.meshIdx];
                 mesh.material = face.side->material.ptr();
-                mesh.brush = this;
                 uint32_t startingVertex = mesh.vertices.size();
                 uint32_t startingIndex = mesh.indices.size();
                 mesh.vertices.reserve(startingVertex + numVertices);
                 mesh.indices.reserve(startingIndex + numIndices);
+                assert(face.startIndex == startingIndex);
+
+                // Meshes are laid out to fit, a face that doesn't can't be indexed
+                if (startingVertex + numVertices > MaxBrushMeshVertices)
+                {
+                    Console.Error("Solid::GenerateMeshData: face with {} vertices overflows 16-bit indices, skipped", numVertices);
+                    continue;
+                }
 
-                face.meshIdx = meshIdx;
-                face.startIndex = startingIndex;
+                uint16_t faceAttrib = uint16_t(mesh.faces.size());
+                mesh.faces.push_back(BrushFace { face.side->plane.normal, face.GetSelectionID() | (face.meshSelected ? BrushFaceSelected : 0u) });
 
                 for (uint32_t i = 0; i < numVertices; i++)
                 {
                     vec3 pos = face.points[i];
 
                     mesh.vertices.emplace_back(VertexSolid {
-                        pos,
-                        face.side->plane.normal,
-                        glm::vec3(ComputeUV(pos), 0.0f),
-                        face.GetSelectionID()
+                        .position = pos,
+                        .uv       = ComputeUV(pos),
+                        .face     = faceAttrib,
                     });
-                    m_bounds = m_bounds
-                        ? AABB::Extend(*m_bounds, pos)
-                        : AABB{ pos, pos };
+                    mesh.bounds = mesh.vertices.size() == 1
+                        ? AABB { pos, pos }
+                        : mesh.bounds.Extend(pos);
                 }
                 // Naiive fan-ing.
                 // Should move to delaugney potentially.
@@ -378,46 +701,33 @@ namespace chisel
                 const uint32_t numPolygons = numIndices / 3;
                 for (uint32_t i = 0; i < numPolygons; i++)
                 {
-                    mesh.indices.emplace_back(startingVertex + i + 2);
-                    mesh.indices.emplace_back(startingVertex + i + 1);
-                    mesh.indices.emplace_back(startingVertex);
+                    mesh.indices.emplace_back(BrushIndex(startingVertex + i + 2));
+                    mesh.indices.emplace_back(BrushIndex(startingVertex + i + 1));
+                    mesh.indices.emplace_back(BrushIndex(startingVertex));
                 }
             }
-            faceIdx++;
-        }
-
-        // Upload all meshes after they're complete
-        a.open();
-        for (auto& mesh : m_meshes)
-        {
-            uint32_t verticesSize = sizeof(VertexSolid) * mesh.vertices.size();
-            uint32_t indicesSize = sizeof(uint32_t) * mesh.indices.size();
-            mesh.alloc = a.alloc(verticesSize + indicesSize);
-            // Store vertices then indices.
-            memcpy(&a.data()[mesh.alloc->offset + 0],            mesh.vertices.data(), verticesSize);
-            memcpy(&a.data()[mesh.alloc->offset + verticesSize], mesh.indices.data(),  indicesSize);
         }
-        a.close();
     }
 
     void Solid::Transform(const mat4x4& _matrix)
     {
-        for (auto& side : m_sides)
-            side.plane = side.plane.Transformed(_matrix);
+        Chisel.map.Actions().Modify(*this);
+        TransformSides(SideTransform(_matrix));
+        UpdateMesh();
+    }
+
+    void Solid::TransformSides(const SideTransform& transform)
+    {
+        const bool locking      = transform.locking;
+        const bool scaleLocking = transform.scaleLocking;
+        const bool moving       = transform.moving;
+        const vec3 delta        = transform.delta;
 
         for (auto& side : m_sides)
         {
-            mat4x4 trans = _matrix;
+            side.plane = side.plane.Transformed(transform.matrix, transform.normalMatrix);
 
-            bool locking = trans_texture_lock;
-            bool scaleLocking = trans_texture_scale_lock;
-
-            vec3 delta = trans[3].xyz;
-            trans[3].xyz = glm::vec3(0.0f, 0.0f, 0.0f);
-                
-            bool moving = glm::length2(delta) > 0.00001f;
-
-            if (trans == glm::identity<glm::mat4x4>())
+            if (transform.translation)
             {
                 if (moving && locking)
                 {
@@ -436,8 +746,8 @@ namespace chisel
             if (scaleU <= 0.0f) scaleU = 1.0f;
             if (scaleV <= 0.0f) scaleV = 1.0f;
 
-            u = glm::mat3(trans) * u;
-            v = glm::mat3(trans) * v;
+            u = transform.linear * u;
+            v = transform.linear * v;
 
             scaleU = glm::length(u) / scaleU;
             scaleV = glm::length(v) / scaleV;
@@ -475,8 +785,6 @@ namespace chisel
                 side.textureAxes[1][3] -= glm::dot(delta, vec3(side.textureAxes[1].xyz)) / side.scale[1];
             }
         }
-
-        UpdateMesh();
     }
 
     void Solid::AlignToGrid(vec3 gridSize)
@@ -517,8 +825,7 @@ namespace chisel
 
     Selectable* Solid::Duplicate()
     {
-        Solid& solid = m_parent->AddBrush(m_sides);
-        return &solid;
+        return &m_parent->CloneBrush(*this);
     }
 
     std::vector<Side> CreateCubeBrush(Material* material, vec3 size, const mat4x4& transform)
@@ -12,21 +12,61 @@
 #include "Face.h"
 
 #include <memory>
+#include <span>
 #include <unordered_map>
 
 namespace chisel
 {
     class Solid;
     class BrushEntity;
+    struct WorldChunk;
 
-    struct BrushMesh
+    // CPU geometry for a BrushMesh.
+    // Only lives in transient scratch buffers while generating or uploading meshes.
+    struct BrushMeshData
     {
         std::vector<VertexSolid> vertices;
-        std::vector<uint32_t>    indices;
+        std::vector<BrushIndex>  indices;
+        std::vector<BrushFace>   faces;
+
+        Material *material = nullptr;
+        int dispPower = -1;
+        AABB bounds;
+
+        void Clear()
+        {
+            vertices.clear();
+            indices.clear();
+            faces.clear();
+            material = nullptr;
+            dispPower = -1;
+            bounds = AABB{};
+        }
+    };
+
+    struct BrushMesh
+    {
+        uint32_t vertexCount = 0;
+        uint32_t indexCount  = 0;
+        uint32_t faceCount   = 0;
 
         std::optional<BrushGPUAllocator::Allocation> alloc;
         Material *material = nullptr;
         Solid *brush = nullptr;
+
+        // Displacement meshes only upload vertices and draw from the shared DispIndexBuffer.
+        int dispPower = -1;
+        AABB bounds;
+
+        bool IsDisplacement() const { return dispPower >= 0; }
+
+        // GPU layout of an allocation: vertices, indices, then face attributes.
+        uint32_t VerticesSize() const { return uint32_t(sizeof(VertexSolid) * vertexCount); }
+        uint32_t IndicesSize()  const { return align(uint32_t(sizeof(BrushIndex) * indexCount), 4u); }
+        uint32_t FacesSize()    const { return uint32_t(sizeof(BrushFace) * faceCount); }
+
+        uint32_t IndexOffset() const { return alloc->offset + VerticesSize(); }
+        uint32_t FaceOffset()  const { return alloc->offset + VerticesSize() + IndicesSize(); }
     };
 
     class Solid : public Atom
@@ -34,14 +74,14 @@ namespace chisel
     public:
         Solid(BrushEntity* parent);
         Solid(BrushEntity* parent, std::vector<Side> sides, bool initMesh = true);
+
+        // Copy of source built from its faces and mesh layout, without clipping the sides again.
+        // Uploads on construction, so batch clones under one BrushGPUAllocator::open.
+        Solid(BrushEntity* parent, const Solid& source);
         Solid(Solid&& other);
         ~Solid();
 
-        // What the fuck, why do I need this?
-        bool operator == (const Solid& other) const
-        {
-            return this == &other;
-        }
+        static bool IsKind(SelectableKind kind) { return kind == SelectableKind::Solid; }
 
         bool HasDisplacement() const { return m_displacement; }
         std::vector<BrushMesh>& GetMeshes() { return m_meshes; }
@@ -50,8 +90,32 @@ namespace chisel
 
         void Clip(Side side); // Remember to UpdateMesh after this!
 
+        // Replace count sides from first with sides. Remember to UpdateMesh after this!
+        void ReplaceSides(uint32_t first, uint32_t count, std::span<const Side> sides);
+
         void UpdateMesh();
 
+        // UpdateMesh a batch of solids. Meshes build on worker threads, then upload under one map of the brush heap.
+        static void UpdateMeshes(std::span<Solid* const> solids);
+
+        // Transform a batch of solids by one matrix, sides and meshes are done in parallel like UpdateMeshes
+        static void TransformMany(std::span<Solid* const> solids, const mat4x4& matrix);
+
+        // Faces mark the selection mask through their BrushFace attributes.
+        // Remesh the solids of the faces in changes that were selected or unselected since.
+        static void UpdateSelectedFaces(std::span<const SelectionID> changes);
+
+        // Regenerate CPU geometry for each of GetMeshes(). Not kept resident after upload.
+        // Writes the displacement start corner of its own sides the first time round, so
+        // solids can be generated in parallel but one solid only from one thread at a time.
+        void GenerateMeshData(std::vector<BrushMeshData>& meshes);
+
+        // Move any meshes allocated in a brush heap page elsewhere. Returns the number moved.
+        uint32_t RelocateMeshes(uint32_t page);
+
+        // World cell this solid is merged into, null while it draws its own meshes
+        WorldChunk* GetChunk() const { return m_chunk; }
+
 
     // Selectable Interface //
 
@@ -69,6 +133,22 @@ namespace chisel
 
     private:
         friend struct Face;
+        friend class WorldChunks;
+
+        struct SideTransform;
+
+        // UpdateMesh in steps. Begin and Finish run on the main thread,
+        // BuildMesh and TransformSides on any thread as long as each solid is on one.
+        void BeginRemesh(bit::bitvector& selectedSides);
+        void BuildMesh(std::vector<BrushMeshData>& data, const bit::bitvector& selectedSides);
+        void FinishRemesh(BrushGPUAllocator& a, const std::vector<BrushMeshData>& data, const bit::bitvector& selectedSides);
+
+        void TransformSides(const SideTransform& transform);
+
+        // transform may be null to only remesh
+        static void Remesh(std::span<Solid* const> solids, const SideTransform* transform);
+
+        static void UploadMesh(BrushGPUAllocator& a, BrushMesh& mesh, const BrushMeshData& data);
 
         bool m_displacement = false;
 
@@ -77,6 +157,9 @@ namespace chisel
         std::optional<AABB> m_bounds;
 
         std::vector<Face> m_faces;
+        std::vector<SelectionID> m_sideIDs; // Reserved per side, reused by its face on every remesh
+
+        WorldChunk* m_chunk = nullptr;
     };
 
     std::vector<Side> CreateCubeBrush(Material* material, vec3 size = vec3(64.f), const mat4x4& transform = glm::identity<mat4x4>());
@@ -0,0 +1,302 @@
+#include "chisel/map/WorldChunks.h"
+#include "chisel/map/Map.h"
+#include "chisel/Chisel.h"
+#include "chisel/Engine.h"
+#include "common/Profiler.h"
+#include "console/ConCommand.h"
+#include "console/ConVar.h"
+
+#include <algorithm>
+
+namespace chisel
+{
+    static ConVar<float> r_chunk_size("r_chunk_size", 2048.0f, "Size of the world cells unselected brushes are merged into");
+    static ConVar<int>   r_chunk_settle_frames("r_chunk_settle_frames", 30, "Frames a brush must go unchanged before it is merged back into its cell");
+
+    // Merged meshes are still drawn with 16-bit indices
+    static constexpr size_t MaxChunkVertices = size_t(UINT16_MAX) + 1;
+
+    static uint64_t CellKey(int3 cell)
+    {
+        // 21 bits per axis is plenty for any cell size worth using
+        auto Bits = [](int v) { return uint64_t(uint32_t(v) & 0x1FFFFF); };
+        return Bits(cell.x) | (Bits(cell.y) << 21) | (Bits(cell.z) << 42);
+    }
+
+    bool WorldChunks::CanMerge(Solid& solid) const
+    {
+        if (solid.IsSelected() || !solid.GetBounds())
+            return false;
+
+        // Displacements pick a LOD per mesh
+        for (const BrushMesh& mesh : solid.GetMeshes())
+        {
+            if (mesh.IsDisplacement())
+                return false;
+        }
+        return true;
+    }
+
+    void WorldChunks::Invalidate(Solid& solid)
+    {
+        if (solid.m_chunk)
+            Detach(solid);
+
+        m_pending.insert_or_assign(&solid, m_frame);
+    }
+
+    void WorldChunks::Remove(Solid& solid)
+    {
+        if (solid.m_chunk)
+            Detach(solid);
+
+        m_pending.erase(&solid);
+    }
+
+    void WorldChunks::Refresh(Solid& solid)
+    {
+        bool merge = CanMerge(solid);
+        if (solid.m_chunk && !merge)
+            Detach(solid);
+        else if (!solid.m_chunk && merge)
+            m_pending.emplace(&solid, 0); // Only just unselected, no need to wait
+    }
+
+    void WorldChunks::Attach(Solid& solid)
+    {
+        vec3 center = solid.GetBounds()->Center();
+        int3 cell   = int3(glm::floor(center / m_cellSize));
+
+        WorldChunk*& chunk = m_cells[CellKey(cell)];
+        if (!chunk)
+        {
+            chunk = m_chunks.emplace_back(std::make_unique<WorldChunk>()).get();
+            chunk->cell = cell;
+        }
+
+        chunk->solids.push_back(&solid);
+        chunk->dirty  = true;
+        solid.m_chunk = chunk;
+    }
+
+    void WorldChunks::Detach(Solid& solid)
+    {
+        WorldChunk& chunk = *solid.m_chunk;
+        auto it = std::find(chunk.solids.begin(), chunk.solids.end(), &solid);
+        if (it != chunk.solids.end())
+        {
+            *it = chunk.solids.back();
+            chunk.solids.pop_back();
+        }
+
+        chunk.dirty   = true;
+        solid.m_chunk = nullptr;
+    }
+
+    void WorldChunks::Update(Map& map, BrushGPUAllocator& a, std::span<const SelectionID> selectionChanges)
+    {
+        PROFILE_ZONE("WorldChunks::Update");
+        m_frame++;
+
+        auto ForEachSolid = [&](auto func)
+        {
+            for (Solid& solid : map.Brushes())
+                func(solid);
+
+            for (BrushEntity& brush : map.BrushEntities())
+            {
+                for (Solid& solid : brush.Brushes())
+                    func(solid);
+            }
+        };
+
+        // Changing the cell size moves everything
+        float cellSize = std::max(float(r_chunk_size), 64.0f);
+        if (cellSize != m_cellSize)
+        {
+            m_cellSize = cellSize;
+            ForEachSolid([&](Solid& solid)
+            {
+                if (solid.m_chunk)
+                    Detach(solid);
+                m_pending.emplace(&solid, 0);
+            });
+        }
+
+        // Selected solids leave their cell to draw highlighted, unselected ones go back.
+        // Selecting a brush entity selects all of its solids.
+        for (SelectionID id : selectionChanges)
+        {
+            Selectable* object = Selection.Find(id);
+            if (!object)
+                continue;
+
+            if (Solid* solid = object->As<Solid>())
+                Refresh(*solid);
+            else if (BrushEntity* brush = object->As<BrushEntity>())
+            {
+                for (Solid& solid : brush->Brushes())
+                    Refresh(solid);
+            }
+        }
+
+        uint64_t settle = uint64_t(std::max(int(r_chunk_settle_frames), 0));
+        for (auto it = m_pending.begin(); it != m_pending.end();)
+        {
+            if (m_frame - it->second < settle)
+            {
+                ++it;
+                continue;
+            }
+
+            Solid& solid = *it->first;
+            if (!solid.m_chunk && CanMerge(solid))
+                Attach(solid);
+            it = m_pending.erase(it);
+        }
+
+        // Settling counts frames, so keep them coming while the editor would otherwise idle
+        if (!m_pending.empty())
+            Engine.Wake(1);
+
+        for (size_t i = 0; i < m_chunks.size();)
+        {
+            WorldChunk& chunk = *m_chunks[i];
+            if (chunk.dirty)
+                Rebuild(chunk, a);
+
+            if (chunk.solids.empty())
+            {
+                m_cells.erase(CellKey(chunk.cell));
+                m_chunks[i] = std::move(m_chunks.back());
+                m_chunks.pop_back();
+                continue;
+            }
+            i++;
+        }
+    }
+
+    void WorldChunks::Rebuild(WorldChunk& chunk, BrushGPUAllocator& a)
+    {
+        PROFILE_ZONE("WorldChunks::Rebuild");
+
+        for (BrushMesh& mesh : chunk.meshes)
+        {
+            if (mesh.alloc)
+                a.free(*mesh.alloc);
+        }
+        chunk.meshes.clear();
+        chunk.dirty = false;
+
+        if (chunk.solids.empty())
+            return;
+
+        // Regenerate every solid's geometry and append it to the open mesh of its material
+        thread_local std::vector<BrushMeshData> merged;
+        thread_local std::vector<BrushMeshData> scratch;
+        thread_local std::unordered_map<Material*, size_t> open;
+        size_t used = 0;
+        open.clear();
+
+        for (Solid* solid : chunk.solids)
+        {
+            solid->GenerateMeshData(scratch);
+            for (size_t i = 0; i < solid->GetMeshes().size(); i++)
+            {
+                const BrushMeshData& src = scratch[i];
+                if (src.vertices.empty())
+                    continue;
+
+                auto it = open.find(src.material);
+                if (it == open.end() || merged[it->second].vertices.size() + src.vertices.size() > MaxChunkVertices)
+                {
+                    if (used == merged.size())
+                        merged.emplace_back();
+                    merged[used].Clear();
+                    merged[used].material = src.material;
+                    it = open.insert_or_assign(src.material, used++).first;
+                }
+
+                BrushMeshData& dst = merged[it->second];
+                uint32_t vertexBase = uint32_t(dst.vertices.size());
+                uint16_t faceBase   = uint16_t(dst.faces.size());
+
+                dst.bounds = vertexBase == 0 ? src.bounds : dst.bounds.Extend(src.bounds);
+
+                dst.vertices.reserve(vertexBase + src.vertices.size());
+                for (VertexSolid vertex : src.vertices)
+                {
+                    vertex.face += faceBase;
+                    dst.vertices.push_back(vertex);
+                }
+
+                dst.indices.reserve(dst.indices.size() + src.indices.size());
+                for (BrushIndex index : src.indices)
+                    dst.indices.push_back(BrushIndex(index + vertexBase));
+
+                dst.faces.insert(dst.faces.end(), src.faces.begin(), src.faces.end());
+            }
+        }
+
+        chunk.meshes.resize(used);
+
+        a.open();
+        for (size_t i = 0; i < used; i++)
+        {
+            const BrushMeshData& data = merged[i];
+            BrushMesh& mesh  = chunk.meshes[i];
+            mesh.vertexCount = uint32_t(data.vertices.size());
+            mesh.indexCount  = uint32_t(data.indices.size());
+            mesh.faceCount   = uint32_t(data.faces.size());
+            mesh.material    = data.material;
+            mesh.bounds      = data.bounds;
+
+            chunk.bounds = i == 0 ? data.bounds : chunk.bounds.Extend(data.bounds);
+
+            Solid::UploadMesh(a, mesh, data);
+        }
+        a.close();
+    }
+
+    uint32_t WorldChunks::RelocateMeshes(BrushGPUAllocator& a, uint32_t page)
+    {
+        uint32_t moved = 0;
+        for (auto& chunk : m_chunks)
+        {
+            uint32_t count = 0;
+            for (const BrushMesh& mesh : chunk->meshes)
+                count += mesh.alloc && mesh.alloc->page == page;
+
+            // The GPU copy is write-only, rebuilding is the only way to move it
+            if (count)
+            {
+                Rebuild(*chunk, a);
+                moved += count;
+            }
+        }
+        return moved;
+    }
+
+    WorldChunks::Stats WorldChunks::GetStats() const
+    {
+        Stats stats;
+        stats.chunks  = uint32_t(m_chunks.size());
+        stats.pending = uint32_t(m_pending.size());
+        for (const auto& chunk : m_chunks)
+        {
+            stats.solids += uint32_t(chunk->solids.size());
+            stats.meshes += uint32_t(chunk->meshes.size());
+        }
+        return stats;
+    }
+}
+
+namespace chisel::commands
+{
+    static ConCommand r_chunk_stats("r_chunk_stats", "Print how much of the map is merged into world chunks", []()
+    {
+        auto stats = Chisel.map.Chunks().GetStats();
+        Console.Log("World chunks: {} cells, {} merged meshes", stats.chunks, stats.meshes);
+        Console.Log("  {} brushes merged, {} waiting to settle", stats.solids, stats.pending);
+    });
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Solid.h"
+
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace chisel
+{
+    class Map;
+
+    // Solids merged into one cell of the world grid.
+    // Holds one mesh per material (more past 16-bit indices) in place of each solid's own.
+    struct WorldChunk
+    {
+        int3                   cell;
+        std::vector<Solid*>    solids;
+        std::vector<BrushMesh> meshes; // BrushMesh::brush is null
+        AABB                   bounds;
+        bool                   dirty = false;
+    };
+
+    // Partitions unselected brush geometry into fixed size cells so the scene
+    // draws a few merged meshes per cell instead of every brush on its own.
+    // Solids that are selected, were edited in the last few frames or have displacements
+    // stay out of the cells and keep drawing through their own meshes.
+    // Solids keep their own meshes either way, the ID pass still draws those.
+    class WorldChunks
+    {
+    public:
+        struct Stats
+        {
+            uint32_t chunks  = 0;
+            uint32_t solids  = 0; // Merged into a chunk
+            uint32_t meshes  = 0;
+            uint32_t pending = 0; // Waiting to settle
+        };
+
+        // The solid's geometry changed. It draws on its own until it has been left alone for a bit.
+        // New solids, clones included, come in through here from their constructor, whatever their selection.
+        void Invalidate(Solid& solid);
+
+        // The solid is being destroyed
+        void Remove(Solid& solid);
+
+        // Follow the objects whose selection changed, merge settled solids and rebuild the cells that changed
+        void Update(Map& map, BrushGPUAllocator& a, std::span<const SelectionID> selectionChanges);
+
+        // Rebuild chunks with meshes in a brush heap page elsewhere. Returns the number of meshes moved.
+        uint32_t RelocateMeshes(BrushGPUAllocator& a, uint32_t page);
+
+        auto Chunks() { return IteratorPassthru(m_chunks); }
+
+        Stats GetStats() const;
+
+    private:
+        bool CanMerge(Solid& solid) const;
+        void Refresh(Solid& solid);
+        void Attach(Solid& solid);
+        void Detach(Solid& solid);
+        void Rebuild(WorldChunk& chunk, BrushGPUAllocator& a);
+
+        std::vector<std::unique_ptr<WorldChunk>>   m_chunks;
+        std::unordered_map<uint64_t, WorldChunk*>  m_cells;
+        std::unordered_map<Solid*, uint64_t>       m_pending; // Frame of the last change
+
+        float    m_cellSize = 0.0f;
+        uint64_t m_frame    = 0;
+    };
+}
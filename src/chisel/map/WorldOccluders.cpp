@@ -0,0 +1,106 @@
+#include "chisel/map/WorldOccluders.h"
+#include "chisel/map/Solid.h"
+#include "common/Profiler.h"
+
+#include <algorithm>
+
+namespace chisel
+{
+    void WorldOccluders::Invalidate(Solid& solid)
+    {
+        m_dirty.insert(&solid);
+        m_stale.insert(&solid);
+    }
+
+    void WorldOccluders::Remove(Solid& solid)
+    {
+        if (m_solids.erase(&solid))
+            m_stale.insert(&solid);
+        m_dirty.erase(&solid);
+    }
+
+    void WorldOccluders::Collect(Solid& solid, float minArea, std::vector<Candidate>& added)
+    {
+        std::vector<Occluder>& occluders = m_solids[&solid];
+        occluders.clear();
+
+        for (const Face& face : solid.GetFaces())
+        {
+            // Displacements don't follow their face, see-through materials don't hide anything
+            if (face.side->disp || face.points.size() < 3)
+                continue;
+            if (face.side->material && (face.side->material->translucent || face.side->material->alphatest))
+                continue;
+
+            vec3 cross = vec3(0.0f);
+            for (size_t i = 1; i + 1 < face.points.size(); i++)
+                cross += glm::cross(face.points[i] - face.points[0], face.points[i + 1] - face.points[0]);
+
+            float area = 0.5f * glm::length(cross);
+            if (area >= minArea)
+                occluders.push_back(Occluder { area, face.points });
+        }
+
+        // Pointers into the vector stay put until the solid is collected again
+        for (const Occluder& occluder : occluders)
+            added.push_back(Candidate { occluder.area, &solid, &occluder });
+    }
+
+    const std::vector<vec3>& WorldOccluders::Gather(float minArea, size_t maxTriangles)
+    {
+        bool changed = !m_stale.empty() || !m_dirty.empty() || minArea != m_minArea || maxTriangles != m_maxTriangles;
+        if (!changed)
+            return m_triangles;
+
+        PROFILE_ZONE("WorldOccluders::Gather");
+
+        // A new threshold changes every solid's candidates
+        if (minArea != m_minArea)
+        {
+            m_minArea = minArea;
+            m_sorted.clear();
+            m_stale.clear();
+            for (auto& [solid, occluders] : m_solids)
+                m_dirty.insert(solid);
+        }
+        m_maxTriangles = maxTriangles;
+
+        if (!m_stale.empty())
+        {
+            std::erase_if(m_sorted, [&](const Candidate& candidate) { return m_stale.contains(candidate.solid); });
+            m_stale.clear();
+        }
+
+        // Sort just what was collected and merge it in
+        auto Larger = [](const Candidate& a, const Candidate& b) { return a.area > b.area; };
+
+        thread_local std::vector<Candidate> added;
+        added.clear();
+        for (Solid* solid : m_dirty)
+            Collect(*solid, minArea, added);
+        m_dirty.clear();
+
+        std::sort(added.begin(), added.end(), Larger);
+        size_t middle = m_sorted.size();
+        m_sorted.insert(m_sorted.end(), added.begin(), added.end());
+        std::inplace_merge(m_sorted.begin(), m_sorted.begin() + middle, m_sorted.end(), Larger);
+
+        // Biggest faces hide the most
+        std::vector<vec3>& triangles = m_triangles;
+        triangles.clear();
+        for (const Candidate& candidate : m_sorted)
+        {
+            const auto& points = candidate.occluder->points;
+            if (triangles.size() / 3 + points.size() - 2 > maxTriangles)
+                break;
+
+            for (size_t i = 1; i + 1 < points.size(); i++)
+            {
+                triangles.push_back(points[0]);
+                triangles.push_back(points[i]);
+                triangles.push_back(points[i + 1]);
+            }
+        }
+        return triangles;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "math/Math.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chisel
+{
+    class Solid;
+
+    // Large opaque faces of world solids, the candidates for occlusion culling.
+    // Each solid's faces are kept and only collected again after it changes, and the candidates
+    // stay sorted by area, so an edit costs the faces of the solids it touched instead of the world's.
+    class WorldOccluders
+    {
+    public:
+        // The solid was remeshed or is going away. Main thread, while no Gather runs.
+        void Invalidate(Solid& solid);
+        void Remove(Solid& solid);
+
+        // Triangle list of the largest candidates, at most maxTriangles, largest first.
+        // Collects the solids that changed first, and reuses the last list if nothing did.
+        // Runs on a worker while the main thread leaves the map alone, one caller at a time.
+        const std::vector<vec3>& Gather(float minArea, size_t maxTriangles);
+
+    private:
+        struct Occluder
+        {
+            float             area;
+            std::vector<vec3> points;
+        };
+
+        struct Candidate
+        {
+            float           area;
+            Solid*          solid;
+            const Occluder* occluder;
+        };
+
+        void Collect(Solid& solid, float minArea, std::vector<Candidate>& added);
+
+        std::unordered_map<Solid*, std::vector<Occluder>> m_solids; // Every world solid seen, with its candidates
+        std::unordered_set<Solid*>                        m_dirty;  // To collect again
+        std::unordered_set<Solid*>                        m_stale;  // Candidates to drop from m_sorted
+        std::vector<Candidate>                            m_sorted; // Largest first
+        std::vector<vec3>                                 m_triangles;
+
+        float  m_minArea      = -1.0f; // Of the last Gather
+        size_t m_maxTriangles = 0;
+    };
+}
@@ -115,22 +115,14 @@ namespace chisel
         bool degenerate = math::CloseEnough(size.x, 0.0f) || math::CloseEnough(size.y, 0.0f) || math::CloseEnough(size.z, 0.0f);
         if (!degenerate)
         {
-            Chisel.map.Actions().PerformAction("Add Cube",
-                // Do
-                [this, solids = CreateCubeBrush(Chisel.activeMaterial.ptr(), size, mtx)](
-                    std::any& userdata)
-                {
-                    auto& cube = Chisel.map.AddBrush(solids);
-                    Selection.Clear();
-                    Selection.Select(&cube);
-                    userdata = &cube;
-                },
-                // Undo
-                [ this ] (std::any& userdata)
-                {
-                    Solid *cube = std::any_cast<Solid*>(userdata);
-                    cube->Delete();
-                });
+            ActionList& actions = Chisel.map.Actions();
+            actions.Begin("Add Cube");
+
+            auto& cube = Chisel.map.AddBrush(CreateCubeBrush(Chisel.activeMaterial.ptr(), size, mtx));
+            Selection.Clear();
+            Selection.Select(&cube);
+
+            actions.Commit();
         }
     }
 }
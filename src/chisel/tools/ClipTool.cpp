@@ -63,24 +63,34 @@ namespace chisel
     {
         Side sides[2] = {{ plane, Chisel.activeMaterial, 0.25f }, { plane.Inverse(), Chisel.activeMaterial, 0.25f }};
 
+        // Selecting the new halves grows the selection, so gather the solids up front
+        std::vector<Solid*> solids;
         for (Selectable* selectable : Selection)
         {
-            if (Solid* solid = dynamic_cast<Solid*>(selectable))
+            if (Solid* solid = selectable->As<Solid>())
+                solids.push_back(solid);
+        }
+
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin("Clip");
+
+        for (Solid* solid : solids)
+        {
+            if (tool_clip_type == ClipType::KeepBoth)
             {
-                if (tool_clip_type == ClipType::KeepBoth)
-                {
-                    BrushEntity *parent = solid->GetParent();
-                    assert(parent != nullptr);
-
-                    std::vector<Side> newSides = solid->GetSides();
-                    newSides.emplace_back(sides[1]);
-                    Solid& newSolid = parent->AddBrush(std::move(newSides));
-                    Selection.Select(&newSolid);
-                }
-
-                solid->Clip(tool_clip_type == ClipType::Back ? sides[1] : sides[0]);
-                solid->UpdateMesh();
+                BrushEntity *parent = solid->GetParent();
+                assert(parent != nullptr);
+
+                std::vector<Side> newSides = solid->GetSides();
+                newSides.emplace_back(sides[1]);
+                Solid& newSolid = parent->AddBrush(std::move(newSides));
+                Selection.Select(&newSolid);
             }
+
+            solid->Clip(tool_clip_type == ClipType::Back ? sides[1] : sides[0]);
+            solid->UpdateMesh();
         }
+
+        actions.Commit();
     }
 }
@@ -37,9 +37,14 @@ namespace chisel
     void EntityTool::OnClick(Viewport& viewport, vec3 point, vec3 normal)
     {
         // Place entity on click
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin("Add Entity");
+
         PointEntity* pt = Chisel.map.AddPointEntity(className.c_str());
         pt->origin = point;
         Selection.Clear();
         Selection.Select(pt);
+
+        actions.Commit();
     }
 }
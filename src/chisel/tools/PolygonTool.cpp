@@ -119,10 +119,15 @@ namespace chisel
             sides.emplace_back(Plane(m_points[0] + normal * view_grid_size.value, normal), material, 0.25f);
             sides.emplace_back(Plane(m_points[0], -normal), material, 0.25f);
 
+            ActionList& actions = Chisel.map.Actions();
+            actions.Begin("Add Polygon");
+
             auto& brush = Chisel.map.AddBrush(sides);
             Selection.Clear();
             Selection.Select(&brush);
 
+            actions.Commit();
+
             // TODO: Build final brush
             m_points.clear();
         }
@@ -1,34 +1,93 @@
 #include "SelectTool.h"
 #include "input/Keyboard.h"
+#include "input/Mouse.h"
 #include "gui/IconsMaterialCommunity.h"
 #include "gui/Viewport.h"
 
+#include <vector>
+
 namespace chisel
 {
     static SelectTool Instance = SelectTool("Select", ICON_MC_CURSOR_DEFAULT, 0);
 
     void SelectTool::OnClick(Viewport& viewport, uint2 mouse)
     {
-        Engine.PickObject(mouse, viewport.rt_ObjectID, [](void* data) {
-            uint id = ((uint*)data)[0];
-            
-            if (id == 0) {
-                Selection.Clear();
-            } else {
-                Selectable* selection = Selection.Find(id);
+        // Click or marquee is decided on release
+        marqueeViewport = &viewport;
+        marqueeStart    = mouse;
+    }
 
-                if (selection)
-                {
-                    if (Keyboard.ctrl)
-                    {
-                        Selection.Toggle(selection);
-                    }
-                    else
+    void SelectTool::DrawHandles(Viewport& viewport)
+    {
+        if (marqueeViewport != &viewport)
+            return;
+
+        ImVec2 cursor = ImGui::GetMousePos();
+        Rect   bounds = viewport.viewport;
+        vec2   end    = glm::clamp(vec2(cursor.x, cursor.y) - bounds.pos, vec2(0.0f), bounds.size);
+        vec2   min    = glm::min(vec2(marqueeStart), end);
+        vec2   max    = glm::max(vec2(marqueeStart), end);
+        bool   drag   = glm::any(glm::greaterThan(max - min, vec2(MarqueeThreshold)));
+
+        if (Mouse.GetButton(Mouse.Left))
+        {
+            if (drag)
+            {
+                ImDrawList* draw = ImGui::GetForegroundDrawList();
+                ImVec2 a = ImVec2(bounds.x + min.x, bounds.y + min.y);
+                ImVec2 b = ImVec2(bounds.x + max.x, bounds.y + max.y);
+                draw->AddRectFilled(a, b, ImGui::GetColorU32(ImGuiCol_DragDropTarget, 0.15f));
+                draw->AddRect(a, b, ImGui::GetColorU32(ImGuiCol_DragDropTarget));
+            }
+            return;
+        }
+
+        marqueeViewport = nullptr;
+        bool toggle = Keyboard.ctrl;
+
+        if (!drag)
+        {
+            viewport.PickObject(marqueeStart, [toggle](SelectionID id) {
+
+                if (id == 0) {
+                    Selection.Clear();
+                } else {
+                    Selectable* selection = Selection.Find(id);
+
+                    if (selection)
                     {
-                        Selection.Clear();
-                        Selection.Select(selection);
+                        if (toggle)
+                        {
+                            Selection.Toggle(selection);
+                        }
+                        else
+                        {
+                            Selection.Clear();
+                            Selection.Select(selection);
+                        }
                     }
                 }
+            });
+            return;
+        }
+
+        viewport.PickObjects(Rect(min, max - min), [toggle](std::span<const SelectionID> ids) {
+            std::vector<Selectable*> found;
+            found.reserve(ids.size());
+            for (SelectionID id : ids)
+            {
+                if (Selectable* selectable = Selection.Find(id))
+                    found.push_back(selectable);
+            }
+
+            if (toggle)
+            {
+                Selection.ToggleMany(found);
+            }
+            else
+            {
+                Selection.Clear();
+                Selection.SelectMany(found);
             }
         });
     }
@@ -9,5 +9,15 @@ namespace chisel
         using Tool::Tool;
 
         virtual void OnClick(Viewport& viewport, uint2 mouse);
+
+        // Draws the marquee while dragging and selects on release
+        virtual void DrawHandles(Viewport& viewport);
+
+    protected:
+        // Drags shorter than this are clicks
+        static constexpr float MarqueeThreshold = 4.0f;
+
+        Viewport* marqueeViewport = nullptr;
+        uint2     marqueeStart    = uint2(0);
     };
 }
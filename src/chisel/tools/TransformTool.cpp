@@ -19,6 +19,8 @@ namespace chisel
     template <TransformType Type>
     void TransformTool<Type>::DrawHandles(Viewport& viewport)
     {
+        SelectTool::DrawHandles(viewport);
+
         mat4x4 view = viewport.camera.ViewMatrix();
         mat4x4 proj = viewport.camera.ProjMatrix();
 
@@ -48,6 +50,9 @@ namespace chisel
 
         if (auto transform = Handles.Manipulate(bounds.value(), view, proj, Type, Chisel.transformSpace, snap, size))
         {
+            // However many frames the drag moves things for, it is one undo step
+            Chisel.Drag("Transform");
+
             if (Keyboard.shift && !s_duplicated)
             {
                 Selection.Duplicate();
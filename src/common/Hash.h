@@ -6,6 +6,7 @@
 #include <cstring>
 #include <ostream>
 #include <cctype>
+#include <type_traits>
 
 namespace chisel
 {
@@ -45,6 +46,22 @@ namespace chisel
         return HashStringLower(str.data(), str.size());
     }
 
+    // FNV 1a over raw bytes. Chain calls through seed to hash several values.
+    inline uint64 HashBytes(const void* data, size_t size, uint64 seed = FNV_1a<uint64>::offset)
+    {
+        const byte* bytes = static_cast<const byte*>(data);
+        for (size_t i = 0; i < size; i++)
+            seed = (seed ^ bytes[i]) * FNV_1a<uint64>::prime;
+        return seed;
+    }
+
+    template <typename T>
+    inline uint64 HashValue(const T& value, uint64 seed = FNV_1a<uint64>::offset)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return HashBytes(&value, sizeof(T), seed);
+    }
+
     struct HashedString
     {
         Hash hash;
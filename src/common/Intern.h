@@ -0,0 +1,162 @@
+#pragma once
+
+#include "common/Hash.h"
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace chisel
+{
+    /**
+     * String interned in a global table. Every distinct string has one entry that lives
+     * for the rest of the process, so copies are a pointer and equality is a pointer compare.
+     * Each entry also links to its lowercase form, which makes case-insensitive equality
+     * (KeyValues keys) a pointer compare as well. Safe to intern from any thread.
+     */
+    class InternedString
+    {
+    public:
+        struct Entry
+        {
+            std::string  text;
+            Hash         hash   = 0;       // Of text
+            const Entry* folded = nullptr; // Lowercase form, may be this entry
+        };
+
+        InternedString() : m_entry(&s_empty) {}
+        InternedString(std::string_view str) : m_entry(Intern(str)) {}
+        InternedString(const char* str) : InternedString(std::string_view(str)) {}
+        InternedString(const std::string& str) : InternedString(std::string_view(str)) {}
+
+        // The string if it was interned already. Never grows the table, so lookups by arbitrary text use this.
+        static std::optional<InternedString> Find(std::string_view str)
+        {
+            if (str.empty())
+                return InternedString();
+
+            Table& table = GetTable();
+            std::shared_lock lock(table.mutex);
+            auto it = table.entries.find(str);
+            if (it == table.entries.end())
+                return std::nullopt;
+            return InternedString(it->second);
+        }
+
+        // Lowercase form of str if any casing of it was interned
+        static std::optional<InternedString> FindFolded(std::string_view str)
+        {
+            std::string lower;
+            if (!Fold(str, lower))
+                return Find(str);
+            return Find(lower);
+        }
+
+        const std::string& str() const { return m_entry->text; }
+        const char* c_str() const { return m_entry->text.c_str(); }
+        std::string_view view() const { return m_entry->text; }
+        size_t size() const { return m_entry->text.size(); }
+        bool empty() const { return m_entry->text.empty(); }
+
+        operator std::string_view() const { return m_entry->text; }
+
+        Hash hash() const { return m_entry->hash; }
+        Hash FoldedHash() const { return m_entry->folded->hash; }
+        InternedString Folded() const { return InternedString(m_entry->folded); }
+
+        bool EqualsNoCase(const InternedString& other) const { return m_entry->folded == other.m_entry->folded; }
+
+        bool operator == (const InternedString& other) const { return m_entry == other.m_entry; }
+        bool operator == (std::string_view other) const { return view() == other; }
+        bool operator == (const std::string& other) const { return view() == other; }
+        bool operator == (const char* other) const { return view() == other; }
+
+    private:
+        struct Table
+        {
+            std::shared_mutex                                   mutex;
+            std::deque<Entry>                                   storage; // Never moves entries
+            std::unordered_map<std::string_view, const Entry*>  entries; // Keys point into storage
+        };
+
+        explicit InternedString(const Entry* entry) : m_entry(entry) {}
+
+        static Table& GetTable()
+        {
+            static Table table;
+            return table;
+        }
+
+        // Lowercase copy of str into out, false if str is lowercase already
+        static bool Fold(std::string_view str, std::string& out)
+        {
+            size_t i = 0;
+            while (i < str.size() && !(str[i] >= 'A' && str[i] <= 'Z'))
+                i++;
+            if (i == str.size())
+                return false;
+
+            out.assign(str);
+            for (; i < out.size(); i++)
+            {
+                if (out[i] >= 'A' && out[i] <= 'Z')
+                    out[i] += 'a' - 'A';
+            }
+            return true;
+        }
+
+        static const Entry* Intern(std::string_view str)
+        {
+            if (str.empty())
+                return &s_empty;
+
+            Table& table = GetTable();
+            {
+                std::shared_lock lock(table.mutex);
+                auto it = table.entries.find(str);
+                if (it != table.entries.end()) [[likely]]
+                    return it->second;
+            }
+
+            std::unique_lock lock(table.mutex);
+            return Insert(table, str);
+        }
+
+        // With the table locked for writing
+        static const Entry* Insert(Table& table, std::string_view str)
+        {
+            auto it = table.entries.find(str);
+            if (it != table.entries.end())
+                return it->second;
+
+            Entry& entry = table.storage.emplace_back();
+            entry.text = str;
+            entry.hash = HashString(str);
+            table.entries.emplace(entry.text, &entry);
+
+            std::string lower;
+            entry.folded = Fold(str, lower) ? Insert(table, lower) : &entry;
+            return &entry;
+        }
+
+        static const Entry s_empty;
+
+        const Entry* m_entry;
+    };
+
+    // Out of the class, it refers to itself and the class has to be complete for that
+    inline const InternedString::Entry InternedString::s_empty = { std::string(), HashString(std::string_view()), &InternedString::s_empty };
+}
+
+template<>
+struct std::hash<chisel::InternedString>
+{
+    std::size_t operator()(const chisel::InternedString& s) const noexcept
+    {
+        return s.hash();
+    }
+};
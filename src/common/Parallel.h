@@ -0,0 +1,123 @@
+#pragma once
+
+#include "common/Common.h"
+#include "common/Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chisel
+{
+    /**
+     * Threads that sleep until handed a loop to split between them.
+     * The calling thread takes items too, and returns once every item is done.
+     * Items are taken one at a time, so uneven ones even out.
+     * Only the main thread hands out loops, and items must not start loops of their own.
+     */
+    inline class Workers
+    {
+    public:
+        ~Workers()
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_quit = true;
+            }
+            m_cv.notify_all();
+
+            for (std::thread& thread : m_threads)
+                thread.join();
+        }
+
+        // fn(i) for every i in [0, count) on up to threads threads, 0 for one per core
+        template <typename Fn>
+        void ParallelFor(size_t count, uint threads, Fn&& fn)
+        {
+            if (threads == 0)
+                threads = std::max(std::thread::hardware_concurrency(), 1u);
+            threads = uint(std::min<size_t>(threads, count));
+
+            if (threads <= 1)
+            {
+                for (size_t i = 0; i < count; i++)
+                    fn(i);
+                return;
+            }
+
+            while (m_threads.size() + 1 < threads)
+                m_threads.emplace_back(&Workers::WorkerLoop, this, uint(m_threads.size()), m_batch);
+
+            m_task  = [&fn](size_t i) { fn(i); };
+            m_count = count;
+            m_next  = 0;
+            {
+                std::lock_guard lock(m_mutex);
+                m_active = threads - 1;
+                m_busy   = threads - 1;
+                m_batch++;
+            }
+            m_cv.notify_all();
+
+            RunItems();
+
+            {
+                std::unique_lock lock(m_mutex);
+                m_cv.wait(lock, [&] { return m_busy == 0; });
+            }
+            m_task = nullptr;
+        }
+
+    private:
+        void RunItems()
+        {
+            for (size_t i = m_next++; i < m_count; i = m_next++)
+                m_task(i);
+        }
+
+        void WorkerLoop(uint index, uint64 batch)
+        {
+#if CHISEL_PROFILE
+            Profiler::SetThreadName("Worker");
+#endif
+
+            for (;;)
+            {
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_cv.wait(lock, [&] { return m_quit || m_batch != batch; });
+                    if (m_quit)
+                        return;
+                    batch = m_batch;
+
+                    // Loops asking for fewer threads than were started leave the rest asleep
+                    if (index >= m_active)
+                        continue;
+                }
+
+                RunItems();
+
+                {
+                    std::lock_guard lock(m_mutex);
+                    if (--m_busy == 0)
+                        m_cv.notify_all();
+                }
+            }
+        }
+
+        std::vector<std::thread>    m_threads;
+        std::mutex                  m_mutex;
+        std::condition_variable     m_cv;
+        std::function<void(size_t)> m_task;
+        size_t                      m_count  = 0;
+        std::atomic<size_t>         m_next   = 0;
+        uint64                      m_batch  = 0; // Bumped to wake the workers
+        uint                        m_active = 0; // Workers taking part in the batch
+        uint                        m_busy   = 0; // Of those, still working on it
+        bool                        m_quit   = false;
+    } Workers;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "common/AlignedStorage.h"
+
+namespace chisel
+{
+    /**
+     * Object pool allocating in fixed size chunks.
+     * Objects are constructed in place and never move, so pointers to them stay valid
+     * until they are erased. Live objects are also listed densely for iteration;
+     * erasing swaps the last one into the hole, so it is O(1) but does not keep order.
+     * Handles carry a generation and resolve to null once their object is gone.
+     */
+    template <typename T, uint32_t ChunkSize = 256>
+    class Pool
+    {
+        struct Slot
+        {
+            AlignedStorage<sizeof(T), alignof(T)> storage; // Must stay first, T* casts to Slot*
+            uint32_t index;                                // Of this slot
+            uint32_t dense;                                // Into m_live, or Free
+            uint32_t generation;
+            uint32_t nextFree;
+
+            T* object() { return std::launder(reinterpret_cast<T*>(storage.data)); }
+        };
+
+        static constexpr uint32_t Free = ~0u;
+
+    public:
+        struct Handle
+        {
+            uint32_t index      = Free;
+            uint32_t generation = 0;
+
+            explicit operator bool() const { return index != Free; }
+            bool operator == (const Handle& other) const = default;
+        };
+
+        template <typename Ptr, typename Ref>
+        class Iterator
+        {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type        = T;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = T*;
+            using reference         = Ref;
+
+            Iterator() = default;
+            Iterator(Ptr ptr) : m_ptr(ptr) {}
+
+            Ref operator * () const { return **m_ptr; }
+            auto operator -> () const { return &**m_ptr; }
+
+            Iterator& operator ++ () { ++m_ptr; return *this; }
+            Iterator  operator ++ (int) { return Iterator(m_ptr++); }
+            Iterator& operator -- () { --m_ptr; return *this; }
+            Iterator  operator -- (int) { return Iterator(m_ptr--); }
+
+            Iterator& operator += (difference_type n) { m_ptr += n; return *this; }
+            Iterator  operator +  (difference_type n) const { return Iterator(m_ptr + n); }
+            Iterator  operator -  (difference_type n) const { return Iterator(m_ptr - n); }
+            difference_type operator - (const Iterator& other) const { return m_ptr - other.m_ptr; }
+            Ref operator [] (difference_type n) const { return *m_ptr[n]; }
+
+            auto operator <=> (const Iterator& other) const = default;
+
+        private:
+            Ptr m_ptr = nullptr;
+        };
+
+        using iterator       = Iterator<T* const*, T&>;
+        using const_iterator = Iterator<T* const*, const T&>;
+
+        Pool() = default;
+        Pool(const Pool&) = delete;
+        Pool& operator = (const Pool&) = delete;
+
+        ~Pool() { clear(); }
+
+        template <typename... Args>
+        T& emplace(Args&&... args)
+        {
+            Slot& slot = acquire();
+            T* object = new (slot.storage.data) T(std::forward<Args>(args)...);
+            slot.dense = uint32_t(m_live.size());
+            m_live.push_back(object);
+            return *object;
+        }
+
+        void erase(const T& object)
+        {
+            Slot& slot = slotOf(object);
+            assert(slot.dense != Free && m_live[slot.dense] == &object);
+
+            // Unlink before destroying, the destructor may look the pool up
+            T* last = m_live.back();
+            m_live[slot.dense] = last;
+            slotOf(*last).dense = slot.dense;
+            m_live.pop_back();
+
+            slot.dense = Free;
+            slot.object()->~T();
+            release(slot);
+        }
+
+        void erase(Handle handle)
+        {
+            if (T* object = get(handle))
+                erase(*object);
+        }
+
+        void clear()
+        {
+            // Objects may erase others from their destructors, so never hold on to positions
+            while (!m_live.empty())
+                erase(*m_live.back());
+
+            m_chunks.clear();
+            m_free = Free;
+            m_slotCount = 0;
+        }
+
+        T* get(Handle handle) const
+        {
+            if (handle.index >= m_slotCount)
+                return nullptr;
+
+            Slot& slot = m_chunks[handle.index / ChunkSize][handle.index % ChunkSize];
+            if (slot.dense == Free || slot.generation != handle.generation)
+                return nullptr;
+            return slot.object();
+        }
+
+        Handle handle(const T& object) const
+        {
+            Slot& slot = slotOf(object);
+            return Handle{ slot.index, slot.generation };
+        }
+
+        size_t size() const { return m_live.size(); }
+        bool empty() const { return m_live.empty(); }
+
+        iterator begin() { return iterator(m_live.data()); }
+        iterator end() { return iterator(m_live.data() + m_live.size()); }
+
+        const_iterator begin() const { return const_iterator(m_live.data()); }
+        const_iterator end() const { return const_iterator(m_live.data() + m_live.size()); }
+
+    private:
+        static Slot& slotOf(const T& object)
+        {
+            return *reinterpret_cast<Slot*>(const_cast<T*>(&object));
+        }
+
+        Slot& acquire()
+        {
+            if (m_free != Free)
+            {
+                Slot& slot = m_chunks[m_free / ChunkSize][m_free % ChunkSize];
+                m_free = slot.nextFree;
+                return slot;
+            }
+
+            if (m_slotCount % ChunkSize == 0)
+                m_chunks.push_back(std::make_unique<Slot[]>(ChunkSize));
+
+            uint32_t index = m_slotCount++;
+            Slot& slot = m_chunks[index / ChunkSize][index % ChunkSize];
+            slot.index      = index;
+            slot.generation = 0;
+            return slot;
+        }
+
+        void release(Slot& slot)
+        {
+            slot.generation++;
+            slot.nextFree = m_free;
+            m_free = slot.index;
+        }
+
+        std::vector<std::unique_ptr<Slot[]>> m_chunks;
+        std::vector<T*>                      m_live;
+        uint32_t                             m_free      = Free; // Head of the free slot list
+        uint32_t                             m_slotCount = 0;
+    };
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "common/Common.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string_view>
+#include <vector>
+
+/** Profiler.h: Scoped CPU and GPU timing zones.
+ *
+ * PROFILE_ZONE("Name") times the rest of the enclosing scope on the calling thread.
+ * PROFILE_GPU_ZONE("Name") does the same for the GPU work recorded in it (main thread only).
+ * Zone names must be string literals or otherwise outlive the profiler.
+ *
+ * Every macro compiles to nothing when CHISEL_PROFILE is 0 (meson -Dprofiler=false).
+ */
+
+#ifndef CHISEL_PROFILE
+#define CHISEL_PROFILE 1
+#endif
+
+namespace chisel
+{
+    struct ProfileEvent
+    {
+        const char* name;
+        uint64      start;  // Nanoseconds, Profiler::Now()
+        uint64      end;
+        uint32      thread; // Index of the recording thread, or Profiler::GPUThread
+        uint32      depth;  // Nesting level within the thread
+    };
+
+    struct ProfileFrame
+    {
+        uint64 index = 0;
+        uint64 start = 0;
+        uint64 end   = 0;
+
+        std::vector<ProfileEvent> cpu;
+        std::vector<ProfileEvent> gpu; // Filled in a few frames later, once the GPU has finished it
+
+        double Milliseconds() const { return double(end - start) / 1e6; }
+        double GPUMilliseconds() const;
+    };
+
+    // Finished zones of one thread. Only the owning thread pushes,
+    // only the main thread pops at the end of the frame, so no locks are needed.
+    struct ProfileThreadBuffer
+    {
+        static constexpr uint32 Capacity = 16 * 1024;
+
+        const char*         name  = "";
+        uint32              index = 0;
+        uint32              depth = 0; // Owner only
+
+        std::atomic<uint64> head    = 0; // Written by the owner
+        std::atomic<uint64> tail    = 0; // Written by the collector
+        std::atomic<uint32> dropped = 0;
+
+        ProfileEvent        events[Capacity];
+
+        void Push(const ProfileEvent& event)
+        {
+            uint64 h = head.load(std::memory_order_relaxed);
+            if (h - tail.load(std::memory_order_acquire) >= Capacity)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            events[h % Capacity] = event;
+            head.store(h + 1, std::memory_order_release);
+        }
+    };
+
+    inline struct Profiler
+    {
+        static constexpr uint32 GPUThread   = ~0u;
+        static constexpr size_t HistorySize = 256;      // Frames kept for the overlay
+
+        bool paused = false;                            // Stop adding frames to history
+
+        std::deque<ProfileFrame> history;               // Oldest first
+        std::vector<ProfileFrame> capture;              // Frames recorded by prof_capture
+
+        static uint64 Now()
+        {
+            using namespace std::chrono;
+            return uint64(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+        }
+
+        // Event buffer of the calling thread, created on first use.
+        // Buffers are kept after their thread exits so its last zones can still be collected.
+        static ProfileThreadBuffer& ThreadBuffer()
+        {
+            thread_local ProfileThreadBuffer* buffer = RegisterThread();
+            return *buffer;
+        }
+
+        static void        SetThreadName(const char* name) { ThreadBuffer().name = name; }
+        static const char* ThreadName(uint32 thread);
+
+        // Create the GPU timestamp queries
+        void Init();
+
+        // Brackets a frame. Collects every thread's zones at the end of it and resolves finished GPU frames.
+        void BeginFrame();
+        void EndFrame();
+
+        // Returns a handle for EndGPUZone. Zones outside a frame or while the query ring is full are skipped.
+        uint32 BeginGPUZone(const char* name);
+        void   EndGPUZone(uint32 zone);
+
+        // Record the next 'frames' frames for Dump, replacing the previous capture
+        void Capture(uint32 frames);
+        bool Capturing() const { return m_captureRemaining > 0; }
+
+        // Write the capture, or the history if nothing was captured, as Chrome trace JSON
+        bool Dump(std::string_view path) const;
+
+    private:
+        friend struct GPUProfiler;
+
+        static ProfileThreadBuffer* RegisterThread();
+
+        void AddGPUEvents(uint64 frame, std::vector<ProfileEvent>& events);
+
+        uint64 m_frameIndex = 0;
+        uint64 m_frameStart = 0;
+        uint32 m_captureRemaining = 0;
+    } Profiler;
+
+    struct ProfileZone
+    {
+        ProfileZone(const char* name)
+            : name(name), buffer(Profiler::ThreadBuffer()), depth(buffer.depth++), start(Profiler::Now())
+        {}
+
+        ~ProfileZone()
+        {
+            buffer.depth--;
+            buffer.Push(ProfileEvent { name, start, Profiler::Now(), buffer.index, depth });
+        }
+
+    private:
+        const char*          name;
+        ProfileThreadBuffer& buffer;
+        uint32               depth;
+        uint64               start;
+    };
+
+    struct GPUProfileZone
+    {
+        GPUProfileZone(const char* name) : zone(Profiler.BeginGPUZone(name)) {}
+        ~GPUProfileZone() { Profiler.EndGPUZone(zone); }
+
+    private:
+        uint32 zone;
+    };
+}
+
+#if CHISEL_PROFILE
+    #define PROFILE_CONCAT_(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+    #define PROFILE_ZONE(name)      ::chisel::ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+    #define PROFILE_FUNCTION()      PROFILE_ZONE(__func__)
+    #define PROFILE_GPU_ZONE(name)  ::chisel::GPUProfileZone PROFILE_CONCAT(gpuProfileZone_, __LINE__)(name)
+    #define PROFILE_INIT()          ::chisel::Profiler.Init()
+    #define PROFILE_BEGIN_FRAME()   ::chisel::Profiler.BeginFrame()
+    #define PROFILE_END_FRAME()     ::chisel::Profiler.EndFrame()
+#else
+    #define PROFILE_ZONE(name)
+    #define PROFILE_FUNCTION()
+    #define PROFILE_GPU_ZONE(name)
+    #define PROFILE_INIT()
+    #define PROFILE_BEGIN_FRAME()
+    #define PROFILE_END_FRAME()
+#endif
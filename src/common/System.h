@@ -7,6 +7,7 @@
 #include <typeindex>
 #include <type_traits>
 
+#include "common/Profiler.h"
 #include "common/Ranges.h"
 
 namespace chisel
@@ -146,6 +147,7 @@ namespace chisel
             for (auto& [sys, Func] : event) {
                 // TODO: Why is this necessary?
                 if (i++ > event.size()) return;
+                PROFILE_ZONE(typeid(*sys).name());
                 Func(sys);
             }
         }
@@ -98,6 +98,9 @@ namespace chisel
         }
 
     public:
+        // Bumped by every command run from the console, so cached
+        // views can tell that state they don't track may have changed.
+        static inline uint executions = 0;
 
         static void Execute(std::string_view string)
         {
@@ -124,6 +127,7 @@ namespace chisel
                 cmd = ConCmd(command);
             }
 
+            executions++;
             command->Invoke(cmd);
         }
 
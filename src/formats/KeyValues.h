@@ -1,5 +1,6 @@
 #pragma once
 
+#include "common/Intern.h"
 #include "common/Variant.h"
 #include "common/SmallVector.h"
 #include "common/Parse.h"
@@ -46,26 +47,15 @@ namespace chisel::kv
 	    s^= h(v) + 0x9e3779b9 + (s<< 6) + (s>> 2);
     }
 
-    struct KVStringHash
+    // Keys are interned and compare case-insensitively, through their lowercase entry
+    struct KVKeyHash
     {
-        size_t operator()(const std::string& key) const
-        {
-            size_t hash = 0;
-            for (char c : key)
-                hash_combine(hash, fast_tolower(c));
-            return hash;
-        }
+        size_t operator()(const InternedString& key) const { return key.FoldedHash(); }
     };
 
-    struct KVStringEqual
+    struct KVKeyEqual
     {
-        bool operator()(const std::string& a, const std::string& b) const
-        {
-            if (a.size() != b.size())
-                return false;
-
-            return std::equal(a.begin(), a.end(), b.begin(), [](char a, char b) { return fast_tolower(a) == fast_tolower(b); });
-        }
+        bool operator()(const InternedString& a, const InternedString& b) const { return a.EqualsNoCase(b); }
     };
 
     class KeyValuesVariant
@@ -248,10 +238,15 @@ namespace chisel::kv
 
         KeyValues(const KeyValues& other)
         {
-            for (const auto& [name, child] : m_children)
+            for (const auto& [name, child] : other.m_children)
                 m_children.emplace(name, KeyValuesVariant(child));
         }
 
+        KeyValues(KeyValues&& other) = default;
+
+        KeyValues& operator = (const KeyValues& other) = default;
+        KeyValues& operator = (KeyValues&& other) = default;
+
         static std::unique_ptr<KeyValues> ParseFromUTF8(StringView buffer)
         {
             const char *start = buffer.begin();
@@ -266,31 +261,34 @@ namespace chisel::kv
 
         KeyValuesVariant& operator [](std::string_view string)
         {
-            auto iter = m_children.find(std::string(string));
-            if (iter == m_children.end())
-            {
-                //std::cerr << "Returning KeyValuesVariant empty value: " << string << std::endl;
-                return KeyValuesVariant::GetEmptyValue();
-            }
-
-            return iter->second;
+            KeyValuesVariant* child = Find(string);
+            return child ? *child : KeyValuesVariant::GetEmptyValue();
         }
 
         const KeyValuesVariant& operator [] (std::string_view string) const
         {
-            auto iter = m_children.find(std::string(string));
-            if (iter == m_children.end())
-            {
-                //std::cerr << "Returning KeyValuesVariant empty value: " << string << std::endl;
-                return KeyValuesVariant::GetEmptyValue();
-            }
+            const KeyValuesVariant* child = const_cast<KeyValues*>(this)->Find(string);
+            return child ? *child : KeyValuesVariant::GetEmptyValue();
+        }
 
-            return iter->second;
+        // First child with this key, or null
+        KeyValuesVariant* Find(const InternedString& key)
+        {
+            auto iter = m_children.find(key);
+            return iter != m_children.end() ? &iter->second : nullptr;
+        }
+
+        // Text that was never interned can't be a key, so this doesn't grow the string table
+        KeyValuesVariant* Find(std::string_view string)
+        {
+            auto key = InternedString::FindFolded(string);
+            return key ? Find(*key) : nullptr;
         }
 
         auto FindAll(std::string_view string)
         {
-            return m_children.equal_range(std::string(string));
+            auto key = InternedString::FindFolded(string);
+            return key ? m_children.equal_range(*key) : std::make_pair(m_children.end(), m_children.end());
         }
 
         auto begin() { return m_children.begin(); }
@@ -302,26 +300,26 @@ namespace chisel::kv
 
         bool Contains(std::string_view name)
         {
-            return m_children.contains(std::string(name));
+            return Find(name) != nullptr;
         }
 
         template <typename... Args>
-        KeyValuesVariant& CreateChild(std::string_view name, Args... args)
+        KeyValuesVariant& CreateChild(InternedString name, Args... args)
         {
-            return m_children.emplace(std::string(name), KeyValuesVariant::Parse(std::forward<Args>(args)...))->second;
+            return m_children.emplace(name, KeyValuesVariant::Parse(std::forward<Args>(args)...))->second;
         }
 
         template <typename T>
-        KeyValuesVariant& CreateTypedChild(std::string_view name, const T& thing)
+        KeyValuesVariant& CreateTypedChild(InternedString name, const T& thing)
         {
-            return m_children.emplace(std::string(name), KeyValuesVariant(thing))->second;
+            return m_children.emplace(name, KeyValuesVariant(thing))->second;
         }
 
         bool empty() const { return m_children.empty(); }
 
         void RemoveAll(std::string_view name)
         {
-            auto range = m_children.equal_range(std::string(name));
+            auto range = FindAll(name);
             if (range.first == range.second)
                 return;
             m_children.erase(range.first, range.second);
@@ -329,12 +327,12 @@ namespace chisel::kv
 
         void RemoveAllWithType(std::string_view name, KeyValuesType type)
         {
-            auto range = m_children.equal_range(std::string(name));
+            auto range = FindAll(name);
             if (range.first == range.second)
                 return;
 
             for (auto it = range.first; it != range.second;) {
-                if (it->first == name && it->second.GetType() == type)
+                if (it->second.GetType() == type)
                 {
                     it = m_children.erase(it);
                 }
@@ -436,7 +434,7 @@ namespace chisel::kv
             return kv;
         }
 
-        std::unordered_multimap<std::string, KeyValuesVariant, KVStringHash, KVStringEqual> m_children;
+        std::unordered_multimap<InternedString, KeyValuesVariant, KVKeyHash, KVKeyEqual> m_children;
     };
     inline KeyValues KeyValues::s_Nothing;
 
@@ -12,6 +12,7 @@
 #include <misc/cpp/imgui_stdlib.h>
 #include <string>
 #include <unordered_set>
+#include <utility>
 
 namespace chisel
 {
@@ -32,6 +33,28 @@ namespace chisel
 
     const std::unordered_set<Hash> HoistedVariableSet = {HoistedVariables.begin(), HoistedVariables.end()};
 
+    // Widgets report a change every frame they are dragged or typed into. Those edits extend
+    // one undo step, keyed by what they edit, until the widget is let go.
+    static void EndEditOnRelease()
+    {
+        if (ImGui::IsItemDeactivated())
+            Chisel.map.Actions().Seal();
+    }
+
+    static void EditSide(Face* face, const char* name, auto&& edit)
+    {
+        // Remeshing rebuilds the solid's faces, face included
+        Solid* solid = face->solid;
+        Side*  side  = face->side;
+
+        ActionList& actions = Chisel.map.Actions();
+        actions.Begin(name, uint64_t(uintptr_t(side)));
+        actions.Modify(*solid);
+        edit(*side);
+        solid->UpdateMesh();
+        actions.Commit();
+    }
+
     Inspector::Inspector() : GUI::Window(ICON_MC_INFORMATION, "Inspector", 512, 512, true, ImGuiWindowFlags_MenuBar)
     {
         defaultIcons[0] = Assets.Load<Texture>("textures/ui/entity.png");
@@ -73,8 +96,8 @@ namespace chisel
                 return;
             
             // TODO: Better interface for this
-            Entity* target_ent = dynamic_cast<Entity*>(Selection[0]);
-            Face* target_face = dynamic_cast<Face*>(Selection[0]);
+            Entity* target_ent = Selection[0]->As<Entity>();
+            Face* target_face = Selection[0]->As<Face>();
             if (!target_ent && !target_face) {
                 locked = false;
                 return;
@@ -89,7 +112,10 @@ namespace chisel
 
     void Inspector::DrawEntityInspector(Entity* ent)
     {
-        const FGD::Class& cls = Chisel.fgd->classes[ent->classname];
+        // Unknown classes inspect as an empty one, without adding it to the FGD
+        static const FGD::Class UnknownClass = {};
+        const FGD::Class* resolved = ent->GetClass();
+        const FGD::Class& cls = resolved ? *resolved : UnknownClass;
 
         constexpr float iconSize = 64;
         constexpr float iconPadding = 8;
@@ -134,7 +160,14 @@ namespace chisel
         ImGui::SetCursorPos({cursorPos.x + iconSize + iconPadding, cursorPos.y});
 
         // Draw classname picker
-        ClassnamePicker(&ent->classname, cls.type == FGD::SolidClass);
+        std::string classname = ent->GetClassname().str();
+        if (ClassnamePicker(&classname, cls.type == FGD::SolidClass))
+        {
+            ActionList& actions = Chisel.map.Actions();
+            actions.Begin("Change Classname");
+            ent->SetClassname(classname);
+            actions.Commit();
+        }
 
         // Draw help icon
         ImGui::BeginDisabled(!hasHelp);
@@ -184,12 +217,11 @@ namespace chisel
         ImGui::SetNextItemWidth(-FLT_MIN);
         if (ImGui::InputText("Material", inputPath, 4096))
         {
-            auto previousMaterial = side->material;
-            side->material = Assets.Load<Material>(inputPath);
-
-            if (side->material != previousMaterial)
-                face->solid->UpdateMesh();
+            auto material = Assets.Load<Material>(inputPath);
+            if (material != side->material)
+                EditSide(face, "Change Material", [&](Side& edited) { edited.material = material; });
         }
+        EndEditOnRelease();
 
         ImGui::SetCursorPos({cursorPos.x, cursorPos.y + iconSize + iconPadding});
         ImGui::Separator();
@@ -201,15 +233,20 @@ namespace chisel
         ImGui::TableNextColumn();
         VarLabel("Texture scale", "Change texture scale");
         ImGui::SetNextItemWidth(-FLT_MIN);
-        if (ImGui::DragFloat2("Texture scale", side->scale.data(), 1.0f, 0.0f, 0.0f, "%g", ImGuiSliderFlags_NoRoundToFormat))
-            face->solid->UpdateMesh();
+        std::array<float, 2> scale = side->scale;
+        if (ImGui::DragFloat2("Texture scale", scale.data(), 1.0f, 0.0f, 0.0f, "%g", ImGuiSliderFlags_NoRoundToFormat))
+            EditSide(face, "Texture Scale", [&](Side& edited) { edited.scale = scale; });
+        EndEditOnRelease();
         ImGui::TableNextColumn();
 
         ImGui::TableNextRow();
         ImGui::TableNextColumn();
         VarLabel("Lightmap scale", "Change lightmap scale");
         ImGui::SetNextItemWidth(-FLT_MIN);
-        ImGui::DragFloat("Lightmap scale", &side->lightmapScale, 1.0f, 0.0f, 0.0f, "%g", ImGuiSliderFlags_NoRoundToFormat);
+        float lightmapScale = side->lightmapScale;
+        if (ImGui::DragFloat("Lightmap scale", &lightmapScale, 1.0f, 0.0f, 0.0f, "%g", ImGuiSliderFlags_NoRoundToFormat))
+            EditSide(face, "Lightmap Scale", [&](Side& edited) { edited.lightmapScale = lightmapScale; });
+        EndEditOnRelease();
         ImGui::TableNextColumn();
 
         ImGui::TableNextRow();
@@ -222,8 +259,9 @@ namespace chisel
         ImGui::EndTable();
     }
 
-    void Inspector::ClassnamePicker(std::string* classname, bool solids, const char* label)
+    bool Inspector::ClassnamePicker(std::string* classname, bool solids, const char* label)
     {
+        bool changed = false;
         ImGui::PushFont(GUI::FontMonospace);
         if (ImGui::BeginCombo("##classname", classname->c_str()))
         {
@@ -243,6 +281,8 @@ namespace chisel
                 bool selected = *classname == name;
                 if (ImGui::Selectable(name.c_str(), selected)) {
                     *classname = name;
+                    changed = true;
+                    Chisel.map.Touch();
                 }
                 if (selected)
                     ImGui::SetItemDefaultFocus();
@@ -255,6 +295,7 @@ namespace chisel
             ImGui::SameLine();
             ImGui::TextUnformatted(label);
         }
+        return changed;
     }
 
     inline bool Inspector::ValueInput(const char* name, const FGD::Var& var, kv::KeyValuesVariant& kv)
@@ -406,11 +447,11 @@ namespace chisel
     inline bool Inspector::GetKV(const FGD::Var& var, Entity* ent, kv::KeyValuesVariant*& kv)
     {
         bool defaultVal = false;
-        if (ent->kv.Contains(var.name))
-            kv = &ent->kv[var.name];
+        if (auto* child = ent->kv.Find(var.key))
+            kv = child;
         else
         {
-            kv = &ent->kv.CreateChild(var.name, var.defaultValue.c_str());
+            kv = &ent->kv.CreateChild(var.key, var.defaultValue.c_str());
             defaultVal = true;
         }
 
@@ -429,6 +470,7 @@ namespace chisel
     {
         kv::KeyValuesVariant *kv = nullptr;
         const bool defaultVal = GetKV(var, ent, kv);
+        const auto before = std::as_const(*kv);
 
         ImGui::PushID(var.name.c_str());
         ImGui::BeginDisabled(var.readOnly);
@@ -446,6 +488,8 @@ namespace chisel
         bool modified = raw
             ? RawInput(var, *kv)
             : ValueInput(var, *kv);
+        EndEditOnRelease();
+        bool reset = false;
 
         // Reset button
         if (!defaultVal)
@@ -458,14 +502,24 @@ namespace chisel
             {
                 *kv = std::move(kv::KeyValuesVariant::Parse(var.defaultValue));
                 modified = true;
+                reset = true;
             }
 
             ImGui::EndDisabled();
         }
 
         if (modified)
+        {
             kv->ValueChanged();
 
+            ActionList& actions = Chisel.map.Actions();
+            actions.Begin(reset ? "Reset Property" : "Edit Property", reset ? 0 : uint64_t(uintptr_t(kv)));
+            actions.ModifyKey(*ent, var.key, &before);
+            actions.Commit();
+
+            ent->KeyValuesChanged();
+        }
+
         ImGui::EndDisabled();
         ImGui::PopID();
 
@@ -564,12 +618,22 @@ namespace chisel
                 }
                 else if (hash == "origin"_hash && cls->type != FGD::SolidClass)
                 {
-                    if (PointEntity* point = dynamic_cast<PointEntity*>(ent))
+                    if (PointEntity* point = ent->As<PointEntity>())
                     {
                         ImGui::TableNextRow(); ImGui::TableNextColumn();
                         VarLabel("Position", "The absolute position of this entity.", "origin");
                         ImGui::SetNextItemWidth(-FLT_MIN);
-                        ImGui::DragFloat3("##position", &point->origin.x, 1.f, 0.f, 0.f, "%g", ImGuiSliderFlags_NoRoundToFormat);
+                        vec3 origin = point->origin;
+                        if (ImGui::DragFloat3("##position", &origin.x, 1.f, 0.f, 0.f, "%g", ImGuiSliderFlags_NoRoundToFormat))
+                        {
+                            ActionList& actions = Chisel.map.Actions();
+                            actions.Begin("Move Entity", uint64_t(uintptr_t(point)));
+                            actions.Modify(*point);
+                            point->origin = origin;
+                            actions.Commit();
+                            Chisel.map.Touch();
+                        }
+                        EndEditOnRelease();
                     }
                 }
                 else if (var && hash == "spawnflags"_hash)
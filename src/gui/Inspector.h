@@ -22,7 +22,8 @@ namespace chisel
         void DrawEntityInspector(Entity* ent);
         void DrawFaceInspector(Face *side);
 
-        static void ClassnamePicker(std::string* classname, bool solids = false, const char* label = nullptr);
+        // True if the classname was changed
+        static bool ClassnamePicker(std::string* classname, bool solids = false, const char* label = nullptr);
 
         Rc<Texture> defaultIcons[4];
         uint32_t defaultIconIndex = 1;
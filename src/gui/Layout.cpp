@@ -260,7 +260,7 @@ namespace chisel
         ImGui::PushStyleColor(ImGuiCol_Button, ImGui::GetStyleColorVec4(col));
 
         if (ImGui::Button(icon)) {
-            Chisel.tool = tool;
+            Chisel.SetTool(tool);
         }
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip(name);
@@ -338,6 +338,8 @@ namespace chisel
             if (BeginMenu("Window"))
             {
                 MenuItem(Chisel.console->name.c_str(), "`", &Chisel.console->open);
+                if (Chisel.profiler)
+                    MenuItem(Chisel.profiler->name.c_str(), "", &Chisel.profiler->open);
 
                 if (MenuItem(ICON_MC_IMAGE_PLUS " Add Viewport"))
                 {
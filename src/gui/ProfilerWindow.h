@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Window.h"
+#include <imgui.h>
+
+#include "common/Hash.h"
+#include "common/Profiler.h"
+#include "console/Console.h"
+
+#include "gui/IconsMaterialCommunity.h"
+
+#include <algorithm>
+
+namespace chisel::GUI
+{
+    struct ProfilerWindow : public Window
+    {
+        ProfilerWindow() : Window(ICON_MC_CHART_GANTT, "Profiler", 768, 384, false) {}
+
+        static constexpr float MaxFrameMs = 33.3f; // Top of the frame time graph
+
+        uint64 selectedFrame = 0;
+        bool   selected      = false; // Otherwise follow the latest frame
+
+        void Draw() final override
+        {
+            if (Profiler.history.empty())
+            {
+                ImGui::TextUnformatted("No frames recorded yet.");
+                return;
+            }
+
+            ImGui::Checkbox("Pause", &Profiler.paused);
+            ImGui::SameLine();
+            if (ImGui::Button("Capture 120 frames"))
+                Console.Execute("prof_capture 120");
+            ImGui::SameLine();
+            if (selected && ImGui::Button("Follow latest"))
+                selected = false;
+
+            DrawFrameGraph();
+
+            const ProfileFrame* frame = &Profiler.history.back();
+            if (selected)
+            {
+                auto it = std::find_if(Profiler.history.begin(), Profiler.history.end(), [&](const ProfileFrame& f) {
+                    return f.index == selectedFrame;
+                });
+                if (it != Profiler.history.end())
+                    frame = &*it;
+                else
+                    selected = false;
+            }
+
+            ImGui::Text("Frame %llu: CPU %.2f ms, GPU %.2f ms", (unsigned long long)frame->index, frame->Milliseconds(), frame->GPUMilliseconds());
+            ImGui::Separator();
+
+            ImGui::BeginChild("FlameGraph", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+            DrawFlameGraph(*frame);
+            ImGui::EndChild();
+        }
+
+    private:
+        // Frame times of the history, click one to inspect it
+        void DrawFrameGraph()
+        {
+            auto getter = [](void* data, int i) -> float {
+                auto& history = *(std::deque<ProfileFrame>*)data;
+                return float(history[i].Milliseconds());
+            };
+
+            ImVec2 size = ImVec2(ImGui::GetContentRegionAvail().x, 48.0f);
+            ImGui::PlotHistogram("##FrameTimes", getter, &Profiler.history, int(Profiler.history.size()), 0, nullptr, 0.0f, MaxFrameMs, size);
+
+            if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+            {
+                float t = (ImGui::GetMousePos().x - ImGui::GetItemRectMin().x) / ImGui::GetItemRectSize().x;
+                size_t i = std::min(size_t(std::max(t, 0.0f) * Profiler.history.size()), Profiler.history.size() - 1);
+                selectedFrame = Profiler.history[i].index;
+                selected      = true;
+                Profiler.paused = true;
+            }
+        }
+
+        // One lane per thread, one row per nesting level
+        void DrawFlameGraph(const ProfileFrame& frame)
+        {
+            const float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+            const float width     = std::max(ImGui::GetContentRegionAvail().x, 64.0f);
+            const double scale    = width / double(std::max<uint64>(frame.end - frame.start, 1));
+
+            ImDrawList* draw = ImGui::GetWindowDrawList();
+
+            auto DrawLane = [&](const char* name, const std::vector<ProfileEvent>& events, uint32 thread)
+            {
+                uint32 rows = 0;
+                for (const ProfileEvent& event : events)
+                {
+                    if (event.thread == thread)
+                        rows = std::max(rows, event.depth + 1);
+                }
+                if (rows == 0)
+                    return;
+
+                ImGui::TextUnformatted(name);
+                ImVec2 origin = ImGui::GetCursorScreenPos();
+                ImGui::PushID(int(thread));
+                ImGui::InvisibleButton("##Lane", ImVec2(width, rows * rowHeight));
+                ImGui::PopID();
+                bool hovered = ImGui::IsItemHovered();
+
+                for (const ProfileEvent& event : events)
+                {
+                    if (event.thread != thread)
+                        continue;
+
+                    float x0 = origin.x + float(double(event.start - std::min(event.start, frame.start)) * scale);
+                    float x1 = std::max(origin.x + float(double(event.end - std::min(event.end, frame.start)) * scale), x0 + 1.0f);
+                    float y0 = origin.y + event.depth * rowHeight;
+                    ImVec2 min = ImVec2(x0, y0);
+                    ImVec2 max = ImVec2(x1, y0 + rowHeight - 1.0f);
+
+                    // Stable color per zone name
+                    float hue = float(HashString(event.name) % 360) / 360.0f;
+                    draw->AddRectFilled(min, max, ImColor::HSV(hue, 0.45f, 0.7f));
+
+                    if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.0f)
+                        draw->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32_BLACK, event.name);
+
+                    if (hovered && ImGui::IsMouseHoveringRect(min, max))
+                        ImGui::SetTooltip("%s\n%.3f ms", event.name, double(event.end - event.start) / 1e6);
+                }
+            };
+
+            // Threads in the order they first recorded
+            std::vector<uint32> threads;
+            for (const ProfileEvent& event : frame.cpu)
+            {
+                if (std::find(threads.begin(), threads.end(), event.thread) == threads.end())
+                    threads.push_back(event.thread);
+            }
+            std::sort(threads.begin(), threads.end());
+
+            for (uint32 thread : threads)
+                DrawLane(Profiler::ThreadName(thread), frame.cpu, thread);
+
+            if (!frame.gpu.empty())
+                DrawLane(Profiler::ThreadName(Profiler::GPUThread), frame.gpu, Profiler::GPUThread);
+        }
+    };
+}
@@ -3,6 +3,7 @@
 #include "chisel/Selection.h"
 #include "chisel/Chisel.h"
 #include "chisel/Handles.h"
+#include "chisel/Gizmos.h"
 #include "input/Input.h"
 #include "input/Keyboard.h"
 #include "platform/Cursor.h"
@@ -19,6 +20,7 @@
 #include "gui/IconsMaterialCommunity.h"
 #include "gui/Common.h"
 #include "render/Render.h"
+#include "common/Hash.h"
 
 namespace chisel
 {
@@ -30,6 +32,8 @@ namespace chisel
     inline ConVar<float> m_pitch      ("m_pitch",       0.022f, "Mouse pitch factor.");
     inline ConVar<float> m_yaw        ("m_yaw",         0.022f, "Mouse yaw factor.");
 
+    static ConVar<bool>  r_ondemand   ("r_ondemand",    true,   "Only re-render views when something they show has changed.");
+
     Camera& View3D::GetCamera() { return camera; }
 
     void View3D::Start()
@@ -101,9 +105,23 @@ namespace chisel
 
         DrawHandles(view, proj);
 
-        // Draw grid
-        if (view_grid_show)
-            Handles.DrawGrid(camera, view_grid_size);
+        // Reuse last frame's image if nothing in it changed
+        uint64 signature = GetRenderSignature(camera.ViewMatrix(), camera.ProjMatrix());
+        if (!r_ondemand || signature != m_signature)
+        {
+            m_signature = signature;
+
+            // Actually render the viewport, along with the gizmos and grid.
+            // May only be queued here and drawn once every view has updated.
+            Render();
+
+            // Keep the loop running while the view is changing
+            Engine.Wake();
+        }
+        else
+        {
+            Gizmos.Discard();
+        }
 
         OnPostDraw();
     }
@@ -131,9 +149,6 @@ namespace chisel
             ImVec2(0, 0), ImVec2(1, 1)
         );
 
-        // Actually render the viewport
-        Render();
-
         // If mouse is over viewport,
         if (mouseOver = ImGui::IsWindowHovered(ImGuiHoveredFlags_None) && IsMouseOver(viewport))
         {
@@ -224,6 +239,17 @@ namespace chisel
         camera.angles = math::radians(angles);
     }
 
+    uint64 View3D::GetRenderSignature(const mat4x4& view, const mat4x4& proj)
+    {
+        uint64 hash = HashValue(view);
+        hash = HashValue(proj, hash);
+        hash = HashValue(uint2(width, height), hash);
+        hash = HashValue(view_grid_show.value, hash);
+        hash = HashValue(view_grid_size.value, hash);
+        hash = HashValue(ConCommand::executions, hash);
+        return Gizmos::Hash(hash);
+    }
+
     // Returns true if window is not collapsed
     bool View3D::CheckResize()
     {
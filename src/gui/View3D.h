@@ -36,6 +36,13 @@ namespace chisel
         virtual void  Render() = 0;
         virtual void* GetMainTexture() = 0;
 
+        // Hash of everything that shows up in the rendered image.
+        // The view is only re-rendered when this changes.
+        virtual uint64 GetRenderSignature(const mat4x4& view, const mat4x4& proj);
+
+        // Re-render next frame even if nothing seems to have changed
+        void Invalidate() { m_signature = 0; }
+
     // Virtual Methods //
 
         virtual void Start() override;
@@ -67,5 +74,8 @@ namespace chisel
 
         // Returns true if window is not collapsed
         bool CheckResize();
+
+    private:
+        uint64 m_signature = 0;
     };
 }
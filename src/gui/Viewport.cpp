@@ -4,6 +4,7 @@
 #include "chisel/Handles.h"
 #include "chisel/MapRender.h"
 #include "chisel/tools/Tool.h"
+#include "common/Hash.h"
 
 #include "math/Plane.h"
 #include "math/Ray.h"
@@ -13,6 +14,7 @@
 namespace chisel
 {
     Viewport::Viewport() : View3D(ICON_MC_IMAGE_SIZE_SELECT_ACTUAL, "Viewport", 512, 512, true) {}
+    Viewport::~Viewport() {}
 
     void Viewport::Start()
     {
@@ -25,12 +27,22 @@ namespace chisel
         rt_SceneView = Engine.rctx.CreateRenderTarget(width, height);
         ds_SceneView = Engine.rctx.CreateDepthStencil(width, height);
         rt_ObjectID  = Engine.rctx.CreateRenderTarget(width, height, DXGI_FORMAT_R32_UINT);
+        rt_Selection = Engine.rctx.CreateRenderTarget(width, height, DXGI_FORMAT_R8_UNORM);
         camera.renderTarget = rt_SceneView;
     }
 
     void Viewport::Render()
     {
-        Chisel.Renderer->DrawViewport(*this);
+        Chisel.Renderer->QueueViewport(*this);
+    }
+
+    uint64 Viewport::GetRenderSignature(const mat4x4& view, const mat4x4& proj)
+    {
+        uint64 hash = View3D::GetRenderSignature(view, proj);
+        hash = HashValue(map.Revision(), hash);
+        hash = HashValue(Selection.Generation(), hash);
+        hash = HashValue(drawMode, hash);
+        return hash;
     }
 
     void* Viewport::GetMainTexture()
@@ -45,9 +57,6 @@ namespace chisel
 
     void Viewport::DrawHandles(mat4x4& view, mat4x4& proj)
     {
-        // Draw general handles
-        Chisel.Renderer->DrawHandles(view, proj);
-
         // Draw transform handles
         Chisel.tool->DrawHandles(*this);
         
@@ -75,10 +84,22 @@ namespace chisel
     void Viewport::OnPostDraw()
     {
         if (!open) {
+            Chisel.Renderer->ForgetViewport(*this);
             Engine.systems.RemoveSystem(this);
             return;
         }
 
+        // Shares the depth buffer with the scene, which is queued and clears it again.
+        // The target is redrawn by the next pass, so only draw it when the picks go out this frame.
+        if (m_idQuery && Engine.picking.CanDispatch())
+        {
+            Chisel.Renderer->DrawObjectID(*this, *m_idQuery);
+            for (auto& pick : m_picks)
+                pick();
+            m_picks.clear();
+            m_idQuery = std::nullopt;
+        }
+
         Chisel.tool->DrawPropertiesWindow(viewport, instance);
 
         if (IsMouseOver(viewport))
@@ -112,6 +133,35 @@ namespace chisel
         }
     }
 
+// Object ID //
+
+    void Viewport::QueryObjectID(Rect region)
+    {
+        if (m_idQuery)
+        {
+            vec2 min = glm::min(m_idQuery->pos, region.pos);
+            vec2 max = glm::max(m_idQuery->Max(), region.Max());
+            region = Rect(min, max - min);
+        }
+        m_idQuery = region;
+    }
+
+    void Viewport::PickObject(uint2 mouse, Picking::PointCallback callback)
+    {
+        QueryObjectID(Rect(mouse.x, mouse.y, 1, 1));
+        m_picks.push_back([this, mouse, callback = std::move(callback)]() mutable {
+            Engine.picking.QueryPoint(rt_ObjectID, mouse, std::move(callback));
+        });
+    }
+
+    void Viewport::PickObjects(Rect region, Picking::UniqueCallback callback)
+    {
+        QueryObjectID(region);
+        m_picks.push_back([this, region, callback = std::move(callback)]() mutable {
+            Engine.picking.QueryUnique(rt_ObjectID, uint2(region.pos), uint2(glm::ceil(region.size)), std::move(callback));
+        });
+    }
+
 // Draw Modes //
 
     void Viewport::OnDrawMenu()
@@ -3,14 +3,22 @@
 
 #include "chisel/Chisel.h"
 
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
 namespace chisel
 {
+    struct ViewRender;
+
     /**
      * The main level editor 3D view.
      */
     struct Viewport : public View3D
     {
         Viewport();
+        ~Viewport();
 
         // TODO: One map per viewport
         Map& map = Chisel.map;
@@ -22,10 +30,15 @@ namespace chisel
         Rc<render::RenderTarget> rt_SceneView;
         Rc<render::DepthStencil> ds_SceneView;
         Rc<render::RenderTarget> rt_ObjectID;
+        Rc<render::RenderTarget> rt_Selection; // Mask of visible selected brushes, for the outline pass
+
+        // Captured view state and per-view resources, owned by MapRender
+        std::unique_ptr<ViewRender> renderView;
 
     // Rendering //
         void  Render() override;
         void* GetMainTexture() override;
+        uint64 GetRenderSignature(const mat4x4& view, const mat4x4& proj) override;
 
         void Start() override;
         void OnClick(uint2 mouse) override;
@@ -34,6 +47,18 @@ namespace chisel
         void OnDrawMenu() override;
         void OnPostDraw() override;
 
+    // Object ID //
+
+        // Render rt_ObjectID over region (in view pixels) at the end of the next frame picks can go out on.
+        // The ID pass only runs on frames that query it.
+        void QueryObjectID(Rect region);
+
+        // Read the object ID under mouse. Answered a frame or two later.
+        void PickObject(uint2 mouse, Picking::PointCallback callback);
+
+        // Read every distinct object ID in region (in view pixels)
+        void PickObjects(Rect region, Picking::UniqueCallback callback);
+
     // Draw Modes //
 
         enum class DrawMode {
@@ -45,5 +70,11 @@ namespace chisel
         DrawMode drawMode = DrawMode::Shaded;
 
         Texture* GetTexture(DrawMode mode);
+
+    private:
+        // ID pass region and the picks reading it. Both wait while Picking has no free slot,
+        // so the pass is drawn the same frame its picks are dispatched.
+        std::optional<Rect>                m_idQuery;
+        std::vector<std::function<void()>> m_picks;
     };
 }
@@ -32,13 +32,25 @@ namespace chisel
         }
 
         Plane Transformed(const mat4x4& matrix) const
+        {
+            return Transformed(matrix, NormalMatrix(matrix));
+        }
+
+        // With the normal matrix worked out once, for many planes moved by the same matrix
+        Plane Transformed(const mat4x4& matrix, const mat3x3& normalMatrix) const
         {
             const vec3 transformedOrigin = vec3{ matrix * vec4{ ProjectPoint(vec3(0.0, 0.0, 0.0)), 1.0 } };
-            const vec3 transformedNormal = glm::normalize(vec3{ glm::transpose(glm::inverse(matrix)) * vec4{ normal, 0.0 } });
+            const vec3 transformedNormal = glm::normalize(normalMatrix * normal);
 
             return Plane{ transformedOrigin, transformedNormal };
         }
 
+        // Inverse-transpose of matrix, which normals transform by
+        static mat3x3 NormalMatrix(const mat4x4& matrix)
+        {
+            return mat3x3(glm::transpose(glm::inverse(matrix)));
+        }
+
         static vec3 NormalFromPoints(const vec3& a, const vec3& b, const vec3& c)
         {
             const vec3 v1 = a - b;
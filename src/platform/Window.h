@@ -47,6 +47,9 @@ namespace chisel
         // Read input and events. Begin frames.
         // Should call Mouse.SetButton, Keyboard.SetKey, etc.
         virtual void PreUpdate() = 0;
+        // Block until an event is pending or timeoutMs passes.
+        // Returns true if there is an event to process.
+        virtual bool WaitEvents(uint timeoutMs) { return true; }
         // Present if necessary.
         virtual void Update() { }
 
@@ -186,6 +186,12 @@ namespace chisel
         }
 
 
+        bool WaitEvents(uint timeoutMs)
+        {
+            // Doesn't remove the event, PreUpdate will handle it
+            return SDL_WaitEventTimeout(NULL, int(timeoutMs)) != 0;
+        }
+
         uint2 GetSize()
         {
             int width, height;
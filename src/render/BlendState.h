@@ -49,6 +49,7 @@ namespace chisel::render
         RGBAMask writeMask = 0b1111;
 
         constexpr BlendFunc(BlendMode src, BlendMode dst, RGBAMask writeMask = 0b1111) : src(src), dst(dst), srcAlpha(src), dstAlpha(dst), writeMask(writeMask) {}
+        constexpr BlendFunc(BlendMode src, BlendMode dst, BlendMode srcAlpha, BlendMode dstAlpha, RGBAMask writeMask = 0b1111) : src(src), dst(dst), srcAlpha(srcAlpha), dstAlpha(dstAlpha), writeMask(writeMask) {}
         constexpr BlendFunc() : BlendFunc(BlendMode::Default, BlendMode::Default) {}
 
         constexpr bool Enabled() const { return src != BlendMode::Default; }
@@ -79,5 +80,6 @@ namespace chisel::render
         static inline BlendState Add              = BlendFunc(One, One);
         static inline BlendState Alpha            = BlendFunc(SrcAlpha, OneMinusSrcAlpha);
         static inline BlendState AlphaNoSelection = BlendState(BlendFunc(SrcAlpha, OneMinusSrcAlpha), BlendFunc(Zero, Zero, 0b0000));
+        static inline BlendState AddMultiply      = BlendFunc(One, Src1Color, One, Src1Alpha); // Dual source: src0 + dst * src1
     };
 }
\ No newline at end of file
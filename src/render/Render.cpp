@@ -97,11 +97,14 @@ namespace chisel::render
         cbuffers.camera = CreateCBuffer<cbuffers::CameraState>();
         cbuffers.object = CreateCBuffer<cbuffers::ObjectState>();
         cbuffers.brush  = CreateCBuffer<cbuffers::BrushState>();
+        cbuffers.selection = CreateCBuffer<cbuffers::SelectionState>();
 
         // Global blend states
         CreateBlendState(BlendFuncs::Normal);
         CreateBlendState(BlendFuncs::Add);
         CreateBlendState(BlendFuncs::Alpha);
+        CreateBlendState(BlendFuncs::AlphaNoSelection); // Created up front so deferred contexts never have to
+        CreateBlendState(BlendFuncs::AddMultiply);
 
         // Global depth stencil states
         D3D11_DEPTH_STENCIL_DESC dssDefault = { // Same as you'd get with nullptr
@@ -185,6 +188,15 @@ namespace chisel::render
         desc.AntialiasedLineEnable = TRUE;
         device->CreateRasterizerState(&desc, &Raster.SmoothLines);
 
+        // Clipped to the scissor rect, for partial passes like object ID queries
+        desc.AntialiasedLineEnable = FALSE;
+        desc.ScissorEnable = TRUE;
+        device->CreateRasterizerState(&desc, &Raster.Scissor);
+
+        desc.FillMode = D3D11_FILL_WIREFRAME;
+        desc.DepthBias = -16;
+        device->CreateRasterizerState(&desc, &Raster.WireframeScissor);
+
         window->OnAttach();
     }
 
@@ -200,6 +212,49 @@ namespace chisel::render
         device = nullptr;
     }
 
+    bool RenderContext::InitDeferred(RenderContext& immediate)
+    {
+        device    = immediate.device;
+        swapchain = immediate.swapchain;
+        Depth     = immediate.Depth;
+        Sample    = immediate.Sample;
+        Raster    = immediate.Raster;
+        deferred  = true;
+
+        HRESULT hr = device->CreateDeferredContext1(0, &ctx);
+        if (FAILED(hr))
+        {
+            Console.Error("[D3D11] Failed to create deferred context.");
+            return false;
+        }
+
+        // Mapped with DISCARD on every draw, so each context needs its own
+        cbuffers.camera = CreateCBuffer<cbuffers::CameraState>();
+        cbuffers.object = CreateCBuffer<cbuffers::ObjectState>();
+        cbuffers.brush  = CreateCBuffer<cbuffers::BrushState>();
+        cbuffers.selection = CreateCBuffer<cbuffers::SelectionState>();
+        return true;
+    }
+
+    void RenderContext::SetDefaultState()
+    {
+        ctx->PSSetSamplers(0, 1, &Sample.Default);
+        ctx->RSSetState(Raster.Default.ptr());
+        ctx->OMSetDepthStencilState(Depth.Default.ptr(), 0);
+        ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        SetBlendState(BlendFuncs::Normal);
+    }
+
+    Com<ID3D11CommandList> RenderContext::FinishCommandList()
+    {
+        assert(deferred);
+
+        Com<ID3D11CommandList> list;
+        if (FAILED(ctx->FinishCommandList(FALSE, &list)))
+            Console.Error("[D3D11] Failed to finish command list.");
+        return list;
+    }
+
     void RenderContext::BeginFrame()
     {
         // Bind the backbuffer
@@ -602,6 +657,10 @@ namespace chisel::render
             return;
         }
 
+        // Full screen passes generate their vertices from SV_VertexID
+        if (ia.IsEmpty())
+            return;
+
         hr = device->CreateInputLayout(ia.data, ia.size, vsFile->data(), vsFile->size(), &inputLayout);
         if (FAILED(hr)) {
             Console.Error("[D3D11] Failed to create input layout for shader '{}'", name);
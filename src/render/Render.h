@@ -101,6 +101,7 @@ namespace chisel::render
         Com<ID3D11Buffer> camera;
         Com<ID3D11Buffer> object;
         Com<ID3D11Buffer> brush;
+        Com<ID3D11Buffer> selection;
     };
 
     struct RenderContext
@@ -108,6 +109,17 @@ namespace chisel::render
         void Init(Window* window);
         void Shutdown();
 
+        // Set up a deferred context on immediate's device, for recording from another thread.
+        // Shares the device and state objects, but has its own dynamic buffers.
+        bool InitDeferred(RenderContext& immediate);
+
+        // Reset the state every pass expects on entry: default sampler, rasterizer,
+        // depth and blend states and triangle lists. Deferred contexts start with none of it.
+        void SetDefaultState();
+
+        // Deferred only. Close what was recorded so far into a command list.
+        Com<ID3D11CommandList> FinishCommandList();
+
         void BeginFrame();
         void EndFrame();
 
@@ -156,6 +168,7 @@ namespace chisel::render
 
         Com<ID3D11Device1> device;
         Com<ID3D11DeviceContext1> ctx;
+        bool deferred = false;
         Com<IDXGISwapChain> swapchain;
 
         RenderTarget backbuffer;
@@ -182,6 +195,8 @@ namespace chisel::render
             Com<ID3D11RasterizerState> DepthBiased;
             Com<ID3D11RasterizerState> Wireframe;
             Com<ID3D11RasterizerState> SmoothLines;
+            Com<ID3D11RasterizerState> Scissor;
+            Com<ID3D11RasterizerState> WireframeScissor;
         } Raster;
     };
 }
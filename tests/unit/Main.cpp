@@ -0,0 +1,25 @@
+#include "Test.h"
+
+#include <cstring>
+
+// chisel_tests [filter]: runs every test, or those whose name starts with filter
+int main(int argc, char* argv[])
+{
+    using namespace chisel::test;
+
+    const char* filter = argc > 1 ? argv[1] : "";
+    int run = 0;
+    for (const Case& c : Cases())
+    {
+        if (strncmp(c.name, filter, strlen(filter)) != 0)
+            continue;
+
+        int before = failures;
+        c.run();
+        std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", c.name);
+        run++;
+    }
+
+    std::printf("%d tests, %d failed checks\n", run, failures);
+    return failures == 0 ? 0 : 1;
+}
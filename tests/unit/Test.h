@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+namespace chisel::test
+{
+    struct Case
+    {
+        const char* name;
+        void      (*run)();
+    };
+
+    inline std::vector<Case>& Cases()
+    {
+        static std::vector<Case> cases;
+        return cases;
+    }
+
+    inline int failures = 0;
+
+    struct Register
+    {
+        Register(const char* name, void (*run)()) { Cases().push_back({ name, run }); }
+    };
+}
+
+// Defines a test case, run by the chisel_tests executable
+#define TEST(name) \
+    static void name(); \
+    static chisel::test::Register name##_register(#name, name); \
+    static void name()
+
+// Logs and counts a failure, the test carries on
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+            chisel::test::failures++; \
+        } \
+    } while (0)
@@ -0,0 +1,181 @@
+#include "Test.h"
+
+#include "chisel/Chisel.h"
+#include "chisel/map/Map.h"
+#include "console/Console.h"
+
+#include <string>
+
+using namespace chisel;
+
+namespace
+{
+    // Undo history refers back to Chisel.map, so the tests edit that one and clear it after
+    struct Fixture
+    {
+        Map&         map     = Chisel.map;
+        ActionList&  actions = Chisel.map.Actions();
+        PointEntity* ent;
+
+        Fixture()
+        {
+            map.Clear();
+            ent = map.AddPointEntity("info_target");
+            ent->SetTargetname("start");
+        }
+
+        ~Fixture()
+        {
+            map.Clear();
+            Console.Execute("undo_budget_mb 256");
+        }
+
+        void Rename(const char* name, const char* targetname, uint64_t coalesce = 0)
+        {
+            actions.Begin(name, coalesce);
+            ent->SetTargetname(targetname);
+            actions.Commit();
+        }
+
+        // One step setting a key to a string of size bytes
+        void SetBlob(size_t size)
+        {
+            InternedString key = "test_actions_blob";
+            actions.Begin("Blob");
+            actions.ModifyKey(*ent, key);
+            ent->kv.RemoveAll(key.view());
+            ent->kv.CreateTypedChild(key, std::string(size, 'x'));
+            actions.Commit();
+        }
+
+        int UndoAll()
+        {
+            int steps = 0;
+            while (actions.CanUndo())
+            {
+                actions.Undo();
+                steps++;
+            }
+            return steps;
+        }
+    };
+}
+
+TEST(ActionsUndoRedo)
+{
+    Fixture f;
+    CHECK(!f.actions.CanUndo());
+
+    f.Rename("Rename", "a");
+    CHECK(f.actions.CanUndo());
+    CHECK(!f.actions.CanRedo());
+
+    f.actions.Undo();
+    CHECK(f.ent->GetTargetname() == "start");
+    CHECK(f.actions.CanRedo());
+
+    f.actions.Redo();
+    CHECK(f.ent->GetTargetname() == "a");
+
+    // A new step drops what could be redone
+    f.actions.Undo();
+    f.Rename("Rename", "b");
+    CHECK(!f.actions.CanRedo());
+    CHECK(f.UndoAll() == 1);
+    CHECK(f.ent->GetTargetname() == "start");
+}
+
+TEST(ActionsNothingChangedNoStep)
+{
+    Fixture f;
+    f.Rename("Rename", "start");
+    CHECK(!f.actions.CanUndo());
+
+    f.actions.Begin("Empty");
+    f.actions.Commit();
+    CHECK(!f.actions.CanUndo());
+}
+
+TEST(ActionsNest)
+{
+    Fixture f;
+    f.actions.Begin("Outer");
+    f.ent->SetTargetname("outer");
+
+    f.actions.Begin("Inner");
+    f.ent->SetTargetname("inner");
+    f.actions.Commit();
+    CHECK(f.actions.Recording());
+    CHECK(!f.actions.CanUndo());
+
+    f.actions.Commit();
+    CHECK(!f.actions.Recording());
+
+    // Only the outermost commit made a step
+    CHECK(f.UndoAll() == 1);
+    CHECK(f.ent->GetTargetname() == "start");
+}
+
+TEST(ActionsCoalesce)
+{
+    Fixture f;
+
+    // Same name and key extend the newest step, it undoes to before the first
+    f.Rename("Edit", "a", 42);
+    f.Rename("Edit", "ab", 42);
+    f.Rename("Edit", "abc", 42);
+    f.actions.Undo();
+    CHECK(f.ent->GetTargetname() == "start");
+    CHECK(!f.actions.CanUndo());
+    f.actions.Redo();
+    CHECK(f.ent->GetTargetname() == "abc");
+
+    // Anything else starts a new one
+    f.actions.Seal();
+    f.Rename("Edit", "sealed", 42);
+    f.Rename("Edit", "other key", 43);
+    f.Rename("Other", "other name", 43);
+    f.Rename("Edit", "no key");
+    f.Rename("Edit", "no key again");
+    CHECK(f.UndoAll() == 6);
+    CHECK(f.ent->GetTargetname() == "start");
+}
+
+TEST(ActionsCreateAndDelete)
+{
+    Fixture f;
+    f.actions.Begin("Create");
+    PointEntity* target = f.map.AddPointEntity("info_target");
+    target->SetTargetname("created");
+    f.actions.Commit();
+    CHECK(f.map.Index().Count() == 2);
+
+    f.actions.Undo();
+    CHECK(f.map.Index().Count() == 1);
+
+    // Brought back as a new object, with what it had
+    f.actions.Redo();
+    CHECK(f.map.Index().Count() == 2);
+    CHECK(f.map.Index().Query("targetname=created").size() == 1);
+}
+
+TEST(ActionsTrimToBudget)
+{
+    Fixture f;
+    Console.Execute("undo_budget_mb 1");
+
+    // Oldest steps go first to stay in budget
+    for (int i = 0; i < 8; i++)
+        f.SetBlob(100 * 1024 + i);
+    CHECK(f.actions.MemoryUsage() <= 1024 * 1024);
+    CHECK(f.actions.MemoryUsage() > 0);
+
+    int steps = f.UndoAll();
+    CHECK(steps > 0 && steps < 8);
+
+    // A step over budget by itself can't be kept at all
+    f.SetBlob(2 * 1024 * 1024);
+    CHECK(!f.actions.CanUndo());
+    CHECK(!f.actions.CanRedo());
+    CHECK(f.actions.MemoryUsage() == 0);
+}
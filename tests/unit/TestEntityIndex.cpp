@@ -0,0 +1,111 @@
+#include "Test.h"
+
+#include "chisel/map/Entity.h"
+#include "chisel/map/EntityIndex.h"
+
+#include <set>
+
+using namespace chisel;
+
+namespace
+{
+    // Point entities outside any map, indexed by hand
+    struct Fixture
+    {
+        EntityIndex index;
+        PointEntity physics { nullptr };
+        PointEntity statics { nullptr };
+        PointEntity door    { nullptr };
+        PointEntity light   { nullptr };
+
+        Fixture()
+        {
+            Setup(physics, "prop_physics", "crate_1", "1");
+            Setup(statics, "prop_static",  "",        "2");
+            Setup(door,    "func_door",    "door_1",  "0");
+            Setup(light,   "light",        "Door_Light", "");
+        }
+
+        void Setup(PointEntity& ent, const char* classname, const char* targetname, const char* rendermode)
+        {
+            ent.SetClassname(classname);
+            ent.SetTargetname(targetname);
+            if (*rendermode)
+                ent.kv.CreateTypedChild(InternedString("rendermode"), std::string(rendermode));
+            index.Add(ent);
+        }
+
+        std::set<Entity*> Query(std::string_view query)
+        {
+            auto results = index.Query(query);
+            std::set<Entity*> set(results.begin(), results.end());
+            CHECK(set.size() == results.size()); // No repeats
+            return set;
+        }
+    };
+
+    using Set = std::set<Entity*>;
+}
+
+TEST(EntityIndexKeyPatterns)
+{
+    Fixture f;
+    CHECK(f.index.Count() == 4);
+    CHECK((f.Query("classname=prop_*") == Set{ &f.physics, &f.statics }));
+    CHECK((f.Query("classname=prop_physics") == Set{ &f.physics }));
+    CHECK((f.Query("classname=prop_?tatic") == Set{ &f.statics }));
+    CHECK((f.Query("targetname=*_1") == Set{ &f.physics, &f.door }));
+    CHECK((f.Query("rendermode=1,2") == Set{ &f.physics, &f.statics }));
+    CHECK((f.Query("rendermode=*") == Set{ &f.physics, &f.statics, &f.door }));
+    CHECK(f.Query("classname=npc_*").empty());
+    CHECK(f.Query("test_entityindex_nokey=1").empty());
+}
+
+TEST(EntityIndexBareTerms)
+{
+    Fixture f;
+
+    // No key matches either the classname or the targetname
+    CHECK((f.Query("door_*") == Set{ &f.door, &f.light }));
+    CHECK((f.Query("light") == Set{ &f.light }));
+    CHECK((f.Query("*door*") == Set{ &f.door, &f.light }));
+}
+
+TEST(EntityIndexIgnoresCase)
+{
+    Fixture f;
+    CHECK((f.Query("CLASSNAME=Prop_Physics") == Set{ &f.physics }));
+    CHECK((f.Query("targetname=door_light") == Set{ &f.light }));
+    CHECK((f.Query("RenderMode=2") == Set{ &f.statics }));
+}
+
+TEST(EntityIndexCombinesTerms)
+{
+    Fixture f;
+
+    // Every term has to match, excluded ones must not
+    CHECK((f.Query("classname=prop_* rendermode=2") == Set{ &f.statics }));
+    CHECK((f.Query("  classname=prop_*   rendermode=2  ") == Set{ &f.statics }));
+    CHECK((f.Query("door_* -classname=light") == Set{ &f.door }));
+    CHECK((f.Query("-targetname=door_*") == Set{ &f.physics, &f.statics }));
+    CHECK(f.Query("classname=prop_* classname=func_*").empty());
+
+    // Nothing to narrow down by matches everything
+    CHECK(f.Query("").size() == 4);
+}
+
+TEST(EntityIndexFollowsEdits)
+{
+    Fixture f;
+    CHECK((f.Query("targetname=crate_*") == Set{ &f.physics }));
+
+    f.physics.SetTargetname("barrel_1");
+    f.statics.SetTargetname("crate_2");
+    f.index.Invalidate(f.physics);
+    f.index.Invalidate(f.statics);
+    CHECK((f.Query("targetname=crate_*") == Set{ &f.statics }));
+
+    f.index.Remove(f.statics);
+    CHECK(f.Query("targetname=crate_*").empty());
+    CHECK(f.index.Count() == 3);
+}
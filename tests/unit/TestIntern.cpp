@@ -0,0 +1,57 @@
+#include "Test.h"
+
+#include "common/Intern.h"
+
+#include <string>
+
+using namespace chisel;
+
+TEST(InternSameTextSameEntry)
+{
+    InternedString a = "test_intern_same";
+    InternedString b = std::string("test_intern_same");
+    CHECK(a == b);
+    CHECK(a.c_str() == b.c_str());
+    CHECK(a.hash() == b.hash());
+    CHECK(a == "test_intern_same");
+    CHECK(!(a == InternedString("test_intern_other")));
+
+    CHECK(InternedString().empty());
+    CHECK(InternedString("") == InternedString());
+}
+
+TEST(InternFoldsCase)
+{
+    InternedString mixed = "Test_Intern_Fold";
+    InternedString upper = "TEST_INTERN_FOLD";
+    InternedString lower = "test_intern_fold";
+
+    // Each casing is its own string, all sharing the lowercase form
+    CHECK(!(mixed == upper));
+    CHECK(mixed.Folded() == lower);
+    CHECK(upper.Folded() == lower);
+    CHECK(lower.Folded() == lower);
+    CHECK(mixed.EqualsNoCase(upper));
+    CHECK(mixed.EqualsNoCase(lower));
+    CHECK(!mixed.EqualsNoCase(InternedString("test_intern_fold2")));
+    CHECK(mixed.FoldedHash() == lower.hash());
+
+    // Only ASCII letters fold
+    InternedString symbols = "Test_[Intern]_9";
+    CHECK(symbols.Folded() == "test_[intern]_9");
+}
+
+TEST(InternFindDoesntGrow)
+{
+    CHECK(!InternedString::Find("test_intern_never_seen"));
+    CHECK(!InternedString::FindFolded("Test_Intern_Never_Seen"));
+    CHECK(!InternedString::Find("test_intern_never_seen"));
+
+    // Interning any casing makes the lowercase form findable
+    InternedString upper = "TEST_INTERN_FIND";
+    CHECK(InternedString::Find("TEST_INTERN_FIND") == upper);
+    CHECK(InternedString::FindFolded("Test_Intern_Find") == InternedString("test_intern_find"));
+    CHECK(!InternedString::Find("Test_Intern_Find"));
+
+    CHECK(InternedString::Find("") == InternedString());
+}
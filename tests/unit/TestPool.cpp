@@ -0,0 +1,104 @@
+#include "Test.h"
+
+#include "common/Pool.h"
+
+#include <algorithm>
+
+using namespace chisel;
+
+namespace
+{
+    struct Item
+    {
+        int  value;
+        int* destroyed;
+
+        Item(int value, int* destroyed) : value(value), destroyed(destroyed) {}
+        ~Item() { (*destroyed)++; }
+    };
+
+    template <typename P>
+    std::vector<int> Values(P& pool)
+    {
+        std::vector<int> values;
+        for (Item& item : pool)
+            values.push_back(item.value);
+        return values;
+    }
+}
+
+TEST(PoolEraseSwapsInLast)
+{
+    int destroyed = 0;
+    Pool<Item, 4> pool;
+    Item* items[6];
+    for (int i = 0; i < 6; i++)
+        items[i] = &pool.emplace(i, &destroyed);
+
+    // The last one takes the hole, nothing else moves
+    pool.erase(*items[1]);
+    CHECK(destroyed == 1);
+    CHECK(pool.size() == 5);
+    CHECK((Values(pool) == std::vector<int>{ 0, 5, 2, 3, 4 }));
+    CHECK(items[5]->value == 5);
+
+    // Erasing the last one leaves the rest in place
+    pool.erase(*items[4]);
+    CHECK((Values(pool) == std::vector<int>{ 0, 5, 2, 3 }));
+
+    pool.clear();
+    CHECK(destroyed == 6);
+    CHECK(pool.empty());
+}
+
+TEST(PoolHandles)
+{
+    int destroyed = 0;
+    Pool<Item, 4> pool;
+    Item& a = pool.emplace(1, &destroyed);
+    Item& b = pool.emplace(2, &destroyed);
+    Item& c = pool.emplace(3, &destroyed);
+
+    // Handles find their object from its address, across the swap an erase does
+    auto ha = pool.handle(a);
+    auto hc = pool.handle(c);
+    CHECK(pool.get(ha) == &a);
+    CHECK(pool.get(hc) == &c);
+
+    pool.erase(b);
+    CHECK(pool.get(hc) == &c);
+    CHECK(pool.handle(c) == hc);
+
+    // The reused slot gets a new generation, the old handle resolves to nothing
+    pool.erase(a);
+    CHECK(!pool.get(ha));
+    Item& d = pool.emplace(4, &destroyed);
+    CHECK(&d == &a);
+    CHECK(!pool.get(ha));
+    CHECK(pool.get(pool.handle(d)) == &d);
+    CHECK(!(pool.handle(d) == ha));
+
+    CHECK(!pool.get(decltype(pool)::Handle{}));
+}
+
+TEST(PoolChunksDontMove)
+{
+    int destroyed = 0;
+    Pool<Item, 4> pool;
+    std::vector<Item*> items;
+    for (int i = 0; i < 64; i++)
+        items.push_back(&pool.emplace(i, &destroyed));
+
+    for (int i = 0; i < 64; i++)
+        CHECK(items[i]->value == i);
+
+    // Every other one, so the dense list gets shuffled a lot
+    for (int i = 0; i < 64; i += 2)
+        pool.erase(*items[i]);
+    CHECK(pool.size() == 32);
+
+    std::vector<int> values = Values(pool);
+    std::sort(values.begin(), values.end());
+    for (int i = 0; i < 32; i++)
+        CHECK(values[i] == i * 2 + 1);
+}
@@ -0,0 +1,94 @@
+#include "Test.h"
+
+#include "chisel/Selection.h"
+
+using namespace chisel;
+
+namespace
+{
+    struct TestSelectable final : Selectable
+    {
+        using Selectable::Selectable;
+
+        std::optional<AABB> GetBounds() const override { return std::nullopt; }
+        void Transform(const mat4x4& matrix) override {}
+        void Delete() override {}
+        void AlignToGrid(vec3 gridSize) override {}
+        Selectable* Duplicate() override { return nullptr; }
+    };
+
+    constexpr uint32_t IDBits = Selectable::IndexMask | (Selectable::GenerationMask << Selectable::IndexBits);
+}
+
+TEST(SelectionIDsResolveUntilGone)
+{
+    SelectionID id;
+    {
+        TestSelectable object;
+        id = object.GetSelectionID();
+        CHECK(id != 0);
+        CHECK(Selection.Find(id) == &object);
+    }
+    CHECK(Selection.Find(id) == nullptr);
+    CHECK(Selection.Find(0) == nullptr);
+}
+
+TEST(SelectionReserveIDs)
+{
+    std::vector<SelectionID> ids = { 0 };
+    Selectable::ReserveIDs(3, ids);
+    CHECK(ids.size() == 4);
+    CHECK(ids[0] == 0);
+    CHECK(ids[1] != 0 && ids[2] != 0 && ids[3] != 0);
+    CHECK(ids[1] != ids[2] && ids[2] != ids[3] && ids[1] != ids[3]);
+
+    // Reserved IDs resolve to nothing until an object takes them
+    CHECK(Selection.Find(ids[1]) == nullptr);
+    {
+        TestSelectable object(ids[1]);
+        CHECK(object.GetSelectionID() == ids[1]);
+        CHECK(Selection.Find(ids[1]) == &object);
+    }
+
+    // Still reserved with the object gone, so nothing new gets it
+    CHECK(Selection.Find(ids[1]) == nullptr);
+    TestSelectable other;
+    CHECK(other.GetSelectionID() != ids[1]);
+
+    for (size_t i = 1; i < ids.size(); i++)
+        Selectable::ReleaseID(ids[i]);
+}
+
+TEST(SelectionGenerationWraps)
+{
+    std::vector<SelectionID> ids;
+    Selectable::ReserveIDs(1, ids);
+    const SelectionID first = ids[0];
+    const uint32_t index = first & Selectable::IndexMask;
+
+    // Releasing bumps the generation and the slot is reused first, so every cycle gets the same index
+    SelectionID id = first;
+    for (uint32_t i = 0; i < Selectable::GenerationMask; i++)
+    {
+        Selectable::ReleaseID(id);
+        ids.clear();
+        Selectable::ReserveIDs(1, ids);
+
+        CHECK((ids[0] & Selectable::IndexMask) == index);
+        CHECK(ids[0] != id);
+        CHECK((ids[0] & ~IDBits) == 0); // Top bit stays free for flags
+
+        // The stale ID doesn't find whatever took its slot
+        TestSelectable object(ids[0]);
+        CHECK(Selection.Find(ids[0]) == &object);
+        CHECK(Selection.Find(id) == nullptr);
+        id = ids[0];
+    }
+
+    // One more and the generation is back where it started
+    Selectable::ReleaseID(id);
+    ids.clear();
+    Selectable::ReserveIDs(1, ids);
+    CHECK(ids[0] == first);
+    Selectable::ReleaseID(ids[0]);
+}